@@ -21,8 +21,22 @@
 
 #include "config.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <libtracker-miners-common/tracker-file-utils.h>
+
 #include "tracker-extract-info.h"
 
+/* Headers and trailers of most formats fall within these,
+ * the kernel is asked to read them ahead when mapping.
+ */
+#define CONTENTS_HEAD_SIZE (128 * 1024)
+#define CONTENTS_TAIL_SIZE (64 * 1024)
+
 /**
  * SECTION:tracker-extract-info
  * @title: TrackerExtractInfo
@@ -44,9 +58,21 @@ struct _TrackerExtractInfo
 	GFile *file;
 	gchar *mimetype;
 
+	/* Mapped lazily, shared by every module
+	 * and parser looking into the file.
+	 */
+	GMutex contents_lock;
+	GBytes *contents;
+
 	gint ref_count;
 };
 
+typedef struct {
+	gpointer data;
+	gsize size;
+	gint fd;
+} MappedContents;
+
 G_DEFINE_BOXED_TYPE (TrackerExtractInfo, tracker_extract_info,
                      tracker_extract_info_ref, tracker_extract_info_unref)
 
@@ -76,6 +102,8 @@ tracker_extract_info_new (GFile       *file,
 
 	info->resource = NULL;
 
+	g_mutex_init (&info->contents_lock);
+
 	info->ref_count = 1;
 
 	return info;
@@ -122,6 +150,11 @@ tracker_extract_info_unref (TrackerExtractInfo *info)
 		if (info->resource)
 			g_object_unref (info->resource);
 
+		if (info->contents)
+			g_bytes_unref (info->contents);
+
+		g_mutex_clear (&info->contents_lock);
+
 		g_slice_free (TrackerExtractInfo, info);
 	}
 }
@@ -166,6 +199,146 @@ tracker_extract_info_get_mimetype (TrackerExtractInfo *info)
 }
 
 
+static void
+mapped_contents_free (MappedContents *contents)
+{
+	if (contents->data)
+		munmap (contents->data, contents->size);
+
+#ifdef HAVE_POSIX_FADVISE
+	/* Extraction is done with the file, don't
+	 * keep its pages around in the cache.
+	 */
+	posix_fadvise (contents->fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif /* HAVE_POSIX_FADVISE */
+
+	close (contents->fd);
+	g_slice_free (MappedContents, contents);
+}
+
+static GBytes *
+map_contents (GFile   *file,
+              GError **error)
+{
+	MappedContents *contents;
+	gchar *path;
+	struct stat st;
+	gint fd;
+
+	path = g_file_get_path (file);
+
+	if (!path) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+		                     "File has no local path");
+		return NULL;
+	}
+
+	fd = tracker_file_open_fd (path);
+	g_free (path);
+
+	if (fd == -1) {
+		g_set_error_literal (error, G_IO_ERROR,
+		                     g_io_error_from_errno (errno),
+		                     g_strerror (errno));
+		return NULL;
+	}
+
+	if (fstat (fd, &st) == -1) {
+		g_set_error_literal (error, G_IO_ERROR,
+		                     g_io_error_from_errno (errno),
+		                     g_strerror (errno));
+		close (fd);
+		return NULL;
+	}
+
+	if (!S_ISREG (st.st_mode)) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_REGULAR_FILE,
+		                     "Not a regular file");
+		close (fd);
+		return NULL;
+	}
+
+	contents = g_slice_new0 (MappedContents);
+	contents->fd = fd;
+	contents->size = st.st_size;
+
+	if (contents->size > 0) {
+		contents->data = mmap (NULL, contents->size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (contents->data == MAP_FAILED) {
+			g_set_error_literal (error, G_IO_ERROR,
+			                     g_io_error_from_errno (errno),
+			                     g_strerror (errno));
+			contents->data = NULL;
+			mapped_contents_free (contents);
+			return NULL;
+		}
+
+		madvise (contents->data,
+		         MIN (contents->size, CONTENTS_HEAD_SIZE),
+		         MADV_WILLNEED);
+
+		if (contents->size > CONTENTS_HEAD_SIZE) {
+			gsize tail_offset;
+
+			/* Rounded down to the page holding the tail start */
+			tail_offset = contents->size - CONTENTS_TAIL_SIZE;
+			tail_offset &= ~((gsize) sysconf (_SC_PAGESIZE) - 1);
+			madvise ((guint8 *) contents->data + tail_offset,
+			         contents->size - tail_offset,
+			         MADV_WILLNEED);
+		}
+	}
+
+	return g_bytes_new_with_free_func (contents->data,
+	                                   contents->size,
+	                                   (GDestroyNotify) mapped_contents_free,
+	                                   contents);
+}
+
+/**
+ * tracker_extract_info_get_contents:
+ * @info: a #TrackerExtractInfo
+ * @error: return location for a #GError, or %NULL
+ *
+ * Returns a read-only view of the contents of the file being
+ * extracted. The file is mapped in memory the first time this
+ * is called, and shared by all further callers on @info, so
+ * extractor modules falling back on each other, or parsers
+ * for embedded metadata, don't need to open and read the file
+ * again.
+ *
+ * Pages are only read in as they are accessed, except for the
+ * beginning and end of the file, which are read ahead.
+ *
+ * Returns: (transfer full): a #GBytes with the file contents,
+ *          or %NULL if the file could not be mapped. Free with
+ *          g_bytes_unref().
+ *
+ * Since: 2.0
+ **/
+GBytes *
+tracker_extract_info_get_contents (TrackerExtractInfo  *info,
+                                   GError             **error)
+{
+	GBytes *contents = NULL;
+
+	g_return_val_if_fail (info != NULL, NULL);
+	g_return_val_if_fail (!error || !*error, NULL);
+
+	g_mutex_lock (&info->contents_lock);
+
+	if (!info->contents)
+		info->contents = map_contents (info->file, error);
+
+	if (info->contents)
+		contents = g_bytes_ref (info->contents);
+
+	g_mutex_unlock (&info->contents_lock);
+
+	return contents;
+}
+
 /**
  * tracker_extract_info_get_resource:
  * @info: a #TrackerExtractInfo
@@ -187,10 +360,11 @@ tracker_extract_info_get_resource (TrackerExtractInfo *info)
 /**
  * tracker_extract_info_set_resource:
  * @info: a #TrackerExtractInfo
- * @resource: a #TrackerResource
+ * @resource: (nullable): a #TrackerResource, or %NULL
  *
  * Adds the #TrackerResource with results from the extraction to this
- * #TrackerExtractInfo.
+ * #TrackerExtractInfo, replacing any previously set one. Passing %NULL
+ * clears it.
  *
  * Information about the file itself should be represented by properties of
  * @resource itself. It's expected this resource will have nfo:FileDataObject
@@ -217,6 +391,14 @@ void
 tracker_extract_info_set_resource (TrackerExtractInfo *info,
                                    TrackerResource    *resource)
 {
-	g_object_ref (resource);
+	g_return_if_fail (info != NULL);
+	g_return_if_fail (!resource || TRACKER_IS_RESOURCE (resource));
+
+	if (resource)
+		g_object_ref (resource);
+
+	if (info->resource)
+		g_object_unref (info->resource);
+
 	info->resource = resource;
 }
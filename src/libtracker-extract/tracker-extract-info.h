@@ -41,6 +41,8 @@ TrackerExtractInfo *  tracker_extract_info_ref                    (TrackerExtrac
 void                  tracker_extract_info_unref                  (TrackerExtractInfo *info);
 GFile *               tracker_extract_info_get_file               (TrackerExtractInfo *info);
 const gchar *         tracker_extract_info_get_mimetype           (TrackerExtractInfo *info);
+GBytes *              tracker_extract_info_get_contents           (TrackerExtractInfo  *info,
+                                                                   GError             **error);
 
 TrackerResource *     tracker_extract_info_get_resource           (TrackerExtractInfo *info);
 void                  tracker_extract_info_set_resource           (TrackerExtractInfo *info,
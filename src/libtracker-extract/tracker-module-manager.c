@@ -21,18 +21,31 @@
 
 #include <string.h>
 
+#include <glib/gstdio.h>
+
 #include "tracker-module-manager.h"
 
 #define EXTRACTOR_FUNCTION "tracker_extract_get_metadata"
 #define INIT_FUNCTION      "tracker_extract_module_init"
 #define SHUTDOWN_FUNCTION  "tracker_extract_module_shutdown"
 
+#define RULES_CACHE_VERSION 1
+#define RULES_CACHE_TYPE    "(ussa(sx)a(sasasi))"
+
 typedef struct {
 	const gchar *module_path; /* intern string */
-	GList *patterns;
+	GStrv mimetypes;
 	GStrv fallback_rdf_types;
+	const gchar **rdf_types; /* interned, without duplicates */
+	gint threads;
+	guint max_threads;
 } RuleInfo;
 
+typedef struct {
+	GPatternSpec *pattern;
+	guint rule_index;
+} GlobPattern;
+
 typedef struct {
 	GModule *module;
 	TrackerExtractMetadataFunc extract_func;
@@ -47,10 +60,19 @@ static ModuleInfo dummy_module = {
 };
 
 static GHashTable *modules = NULL;
+static GMutex modules_mutex;
 static GHashTable *mimetype_map = NULL;
+static GHashTable *fallback_rdf_types_map = NULL;
 static gboolean initialized = FALSE;
 static GArray *rules = NULL;
 
+/* Compiled mimetype patterns, all values are
+ * GArrays of rule indexes, in rule order.
+ */
+static GHashTable *literal_patterns = NULL;    /* "image/png" */
+static GHashTable *media_type_patterns = NULL; /* "image/" + any, keyed by "image" */
+static GArray *glob_patterns = NULL;           /* anything else */
+
 struct _TrackerMimetypeInfo {
 	const GList *rules;
 	const GList *cur;
@@ -64,14 +86,85 @@ dummy_extract_func (TrackerExtractInfo *info)
 	return TRUE;
 }
 
+static const gchar *
+get_extractors_dir (void)
+{
+	const gchar *extractors_dir;
+
+	extractors_dir = g_getenv ("TRACKER_EXTRACTORS_DIR");
+	if (G_LIKELY (extractors_dir == NULL)) {
+		extractors_dir = TRACKER_EXTRACTORS_DIR;
+	}
+
+	return extractors_dir;
+}
+
+static const gchar **
+intern_rdf_types (GStrv types)
+{
+	GPtrArray *interned;
+	guint i, j;
+
+	interned = g_ptr_array_new ();
+
+	for (i = 0; types[i]; i++) {
+		const gchar *type = g_intern_string (types[i]);
+
+		for (j = 0; j < interned->len; j++) {
+			if (g_ptr_array_index (interned, j) == type)
+				break;
+		}
+
+		if (j == interned->len) {
+			g_ptr_array_add (interned, (gpointer) type);
+		}
+	}
+
+	g_ptr_array_add (interned, NULL);
+
+	return (const gchar **) g_ptr_array_free (interned, FALSE);
+}
+
+/* Takes ownership of the string arrays */
+static void
+add_rule (const gchar *module_path,
+          GStrv        mimetypes,
+          GStrv        fallback_rdf_types,
+          gint         threads)
+{
+	RuleInfo rule = { 0 };
+
+	rule.module_path = g_intern_string (module_path);
+	rule.mimetypes = mimetypes;
+	rule.fallback_rdf_types = fallback_rdf_types;
+	rule.threads = threads;
+
+	if (fallback_rdf_types) {
+		rule.rdf_types = intern_rdf_types (fallback_rdf_types);
+	}
+
+	/* 0 means as many threads as processors */
+	if (threads <= 0) {
+		rule.max_threads = g_get_num_processors ();
+	} else {
+		rule.max_threads = MIN (threads, g_get_num_processors ());
+	}
+
+	if (G_UNLIKELY (!rules)) {
+		rules = g_array_new (FALSE, TRUE, sizeof (RuleInfo));
+	}
+
+	g_array_append_val (rules, rule);
+}
+
 static gboolean
 load_extractor_rule (GKeyFile  *key_file,
                      GError   **error)
 {
 	GError *local_error = NULL;
 	gchar *module_path, **mimetypes;
-	gsize n_mimetypes, i;
-	RuleInfo rule = { 0 };
+	GStrv fallback_rdf_types;
+	gint threads;
 
 	module_path = g_key_file_get_string (key_file, "ExtractorRule", "ModulePath", &local_error);
 
@@ -88,21 +181,13 @@ load_extractor_rule (GKeyFile  *key_file,
 	if (module_path &&
 	    !G_IS_DIR_SEPARATOR (module_path[0])) {
 		gchar *tmp;
-		const gchar *extractors_dir;
-
-		extractors_dir = g_getenv ("TRACKER_EXTRACTORS_DIR");
-		if (G_LIKELY (extractors_dir == NULL)) {
-			extractors_dir = TRACKER_EXTRACTORS_DIR;
-		} else {
-			g_message ("Extractor rules directory is '%s' (set in env)", extractors_dir);
-		}
 
-		tmp = g_build_filename (extractors_dir, module_path, NULL);
+		tmp = g_build_filename (get_extractors_dir (), module_path, NULL);
 		g_free (module_path);
 		module_path = tmp;
 	}
 
-	mimetypes = g_key_file_get_string_list (key_file, "ExtractorRule", "MimeTypes", &n_mimetypes, &local_error);
+	mimetypes = g_key_file_get_string_list (key_file, "ExtractorRule", "MimeTypes", NULL, &local_error);
 
 	if (!mimetypes) {
 		g_free (module_path);
@@ -114,66 +199,315 @@ load_extractor_rule (GKeyFile  *key_file,
 		return FALSE;
 	}
 
-	rule.fallback_rdf_types = g_key_file_get_string_list (key_file, "ExtractorRule", "FallbackRdfTypes", NULL, NULL);
+	fallback_rdf_types = g_key_file_get_string_list (key_file, "ExtractorRule", "FallbackRdfTypes", NULL, NULL);
 
-	/* Construct the rule */
-	rule.module_path = g_intern_string (module_path);
-
-	for (i = 0; i < n_mimetypes; i++) {
-		GPatternSpec *pattern;
+	/* Modules are assumed not to be reentrant unless the rule
+	 * says otherwise.
+	 */
+	threads = 1;
 
-		pattern = g_pattern_spec_new (mimetypes[i]);
-		rule.patterns = g_list_prepend (rule.patterns, pattern);
-	}
+	if (g_key_file_has_key (key_file, "ExtractorRule", "Threads", NULL)) {
+		threads = g_key_file_get_integer (key_file, "ExtractorRule", "Threads", &local_error);
 
-	if (G_UNLIKELY (!rules)) {
-		rules = g_array_new (FALSE, TRUE, sizeof (RuleInfo));
+		if (local_error) {
+			g_free (module_path);
+			g_strfreev (mimetypes);
+			g_strfreev (fallback_rdf_types);
+			g_propagate_error (error, local_error);
+			return FALSE;
+		}
 	}
 
-	g_array_append_val (rules, rule);
-	g_strfreev (mimetypes);
+	add_rule (module_path, mimetypes, fallback_rdf_types, threads);
 	g_free (module_path);
 
 	return TRUE;
 }
 
-gboolean
-tracker_extract_module_manager_init (void)
+static void
+pattern_table_add (GHashTable  *table,
+                   const gchar *key,
+                   guint        rule_index)
 {
-	const gchar *extractors_dir, *name;
-	GList *files = NULL, *l;
-	GError *error = NULL;
-	GDir *dir;
+	GArray *indexes;
 
-	if (initialized) {
-		return TRUE;
+	indexes = g_hash_table_lookup (table, key);
+
+	if (!indexes) {
+		indexes = g_array_new (FALSE, FALSE, sizeof (guint));
+		g_hash_table_insert (table, g_strdup (key), indexes);
 	}
 
-	if (!g_module_supported ()) {
-		g_error ("Modules are not supported for this platform");
+	/* Several patterns in a rule may end up in the same entry */
+	if (indexes->len == 0 ||
+	    g_array_index (indexes, guint, indexes->len - 1) != rule_index) {
+		g_array_append_val (indexes, rule_index);
+	}
+}
+
+/* Sorts all rule patterns so most lookups are resolved through hash
+ * tables. Literal mimetypes and patterns matching a whole media type
+ * (e.g. all of "audio/") make up most of the rules, only the remaining
+ * patterns need to be matched one by one.
+ */
+static void
+compile_rules (void)
+{
+	guint i, j;
+
+	literal_patterns = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+	                                          (GDestroyNotify) g_array_unref);
+	media_type_patterns = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+	                                             (GDestroyNotify) g_array_unref);
+	glob_patterns = g_array_new (FALSE, FALSE, sizeof (GlobPattern));
+
+	for (i = 0; rules && i < rules->len; i++) {
+		RuleInfo *rule = &g_array_index (rules, RuleInfo, i);
+
+		for (j = 0; rule->mimetypes[j]; j++) {
+			const gchar *mimetype = rule->mimetypes[j];
+			const gchar *wildcard;
+
+			wildcard = strpbrk (mimetype, "*?");
+
+			if (!wildcard) {
+				pattern_table_add (literal_patterns, mimetype, i);
+			} else if (wildcard[1] == '\0' && wildcard[0] == '*' &&
+			           wildcard > mimetype && wildcard[-1] == '/' &&
+			           memchr (mimetype, '/', wildcard - mimetype - 1) == NULL) {
+				gchar *media_type;
+
+				media_type = g_strndup (mimetype, wildcard - mimetype - 1);
+				pattern_table_add (media_type_patterns, media_type, i);
+				g_free (media_type);
+			} else {
+				GlobPattern glob;
+
+				glob.pattern = g_pattern_spec_new (mimetype);
+				glob.rule_index = i;
+				g_array_append_val (glob_patterns, glob);
+			}
+		}
+	}
+}
+
+static void
+mark_rules (GArray *indexes,
+            guint8 *matched)
+{
+	guint i;
+
+	if (!indexes) {
+		return;
+	}
+
+	for (i = 0; i < indexes->len; i++) {
+		matched[g_array_index (indexes, guint, i)] = TRUE;
+	}
+}
+
+static gchar *
+get_rules_cache_path (void)
+{
+	return g_build_filename (g_get_user_cache_dir (),
+	                         "tracker",
+	                         "extractor-rules.cache",
+	                         NULL);
+}
+
+/* Returns a variant identifying the current state of the rule
+ * files, so a cache built from them can be validated without
+ * parsing them.
+ */
+static GVariant *
+get_rules_stamp (const gchar *rules_dir,
+                 GList       *files)
+{
+	GVariantBuilder builder;
+	GList *l;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sx)"));
+
+	for (l = files; l; l = l->next) {
+		GStatBuf st;
+		gchar *path;
+
+		if (!g_str_has_suffix (l->data, ".rule")) {
+			continue;
+		}
+
+		path = g_build_filename (rules_dir, l->data, NULL);
+
+		if (g_stat (path, &st) == 0) {
+			g_variant_builder_add (&builder, "(sx)", l->data, (gint64) st.st_mtime);
+		}
+
+		g_free (path);
+	}
+
+	return g_variant_builder_end (&builder);
+}
+
+static gboolean
+load_rules_cache (const gchar *cache_path,
+                  const gchar *rules_dir,
+                  GVariant    *stamp)
+{
+	GVariant *cache, *cached_stamp, *cached_rules;
+	const gchar *cached_rules_dir, *cached_extractors_dir;
+	gchar *module_path, **mimetypes, **fallback_rdf_types;
+	gboolean valid = FALSE;
+	GVariantIter iter;
+	GBytes *bytes;
+	gchar *contents;
+	guint32 version;
+	gsize len;
+	gint threads;
+
+	if (!g_file_get_contents (cache_path, &contents, &len, NULL)) {
 		return FALSE;
 	}
 
-	extractors_dir = g_getenv ("TRACKER_EXTRACTOR_RULES_DIR");
-	if (G_LIKELY (extractors_dir == NULL)) {
-		extractors_dir = TRACKER_EXTRACTOR_RULES_DIR;
-	} else {
-		g_message ("Extractor rules directory is '%s' (set in env)", extractors_dir);
+	bytes = g_bytes_new_take (contents, len);
+	cache = g_variant_new_from_bytes (G_VARIANT_TYPE (RULES_CACHE_TYPE), bytes, FALSE);
+	g_bytes_unref (bytes);
+	g_variant_ref_sink (cache);
+
+	if (!g_variant_is_normal_form (cache)) {
+		g_variant_unref (cache);
+		return FALSE;
 	}
 
-	dir = g_dir_open (extractors_dir, 0, &error);
+	g_variant_get (cache, "(u&s&s@a(sx)@a(sasasi))",
+	               &version, &cached_rules_dir, &cached_extractors_dir,
+	               &cached_stamp, &cached_rules);
+
+	if (version == RULES_CACHE_VERSION &&
+	    g_strcmp0 (cached_rules_dir, rules_dir) == 0 &&
+	    g_strcmp0 (cached_extractors_dir, get_extractors_dir ()) == 0 &&
+	    g_variant_equal (cached_stamp, stamp)) {
+		g_variant_iter_init (&iter, cached_rules);
+
+		while (g_variant_iter_next (&iter, "(s^as^asi)",
+		                            &module_path, &mimetypes,
+		                            &fallback_rdf_types, &threads)) {
+			if (!fallback_rdf_types[0]) {
+				g_clear_pointer (&fallback_rdf_types, g_strfreev);
+			}
 
-	if (!dir) {
-		g_error ("Error opening extractor rules directory: %s", error->message);
+			add_rule (*module_path ? module_path : NULL,
+			          mimetypes, fallback_rdf_types, threads);
+			g_free (module_path);
+		}
+
+		valid = TRUE;
+	}
+
+	g_variant_unref (cached_stamp);
+	g_variant_unref (cached_rules);
+	g_variant_unref (cache);
+
+	return valid;
+}
+
+static void
+save_rules_cache (const gchar *cache_path,
+                  const gchar *rules_dir,
+                  GVariant    *stamp)
+{
+	GVariantBuilder builder;
+	GError *error = NULL;
+	GVariant *cache;
+	gchar *dir;
+	guint i;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sasasi)"));
+
+	for (i = 0; rules && i < rules->len; i++) {
+		RuleInfo *rule = &g_array_index (rules, RuleInfo, i);
+		const gchar * const no_types[] = { NULL };
+
+		g_variant_builder_add (&builder, "(s^as^asi)",
+		                       rule->module_path ? rule->module_path : "",
+		                       rule->mimetypes,
+		                       rule->fallback_rdf_types ?
+		                       (const gchar * const *) rule->fallback_rdf_types : no_types,
+		                       rule->threads);
+	}
+
+	cache = g_variant_new ("(uss@a(sx)a(sasasi))",
+	                       RULES_CACHE_VERSION, rules_dir,
+	                       get_extractors_dir (), stamp, &builder);
+	g_variant_ref_sink (cache);
+
+	dir = g_path_get_dirname (cache_path);
+	g_mkdir_with_parents (dir, 0700);
+	g_free (dir);
+
+	if (!g_file_set_contents (cache_path,
+	                          g_variant_get_data (cache),
+	                          g_variant_get_size (cache),
+	                          &error)) {
+		g_debug ("Could not save extractor rules cache: %s", error->message);
 		g_error_free (error);
-		return FALSE;
 	}
 
-	while ((name = g_dir_read_name (dir)) != NULL) {
-		files = g_list_insert_sorted (files, (gpointer) name, (GCompareFunc) g_strcmp0);
+	g_variant_unref (cache);
+}
+
+/* Several rules may point to the same module, the module
+ * is only as thread-safe as its most restrictive rule says.
+ */
+static void
+harmonize_max_threads (void)
+{
+	GHashTable *max_threads;
+	RuleInfo *rule;
+	guint i;
+
+	/* Keys are intern strings */
+	max_threads = g_hash_table_new (NULL, NULL);
+
+	for (i = 0; i < rules->len; i++) {
+		gpointer value;
+
+		rule = &g_array_index (rules, RuleInfo, i);
+
+		if (!rule->module_path) {
+			continue;
+		}
+
+		value = g_hash_table_lookup (max_threads, rule->module_path);
+
+		if (!value || rule->max_threads < GPOINTER_TO_UINT (value)) {
+			g_hash_table_insert (max_threads,
+			                     (gpointer) rule->module_path,
+			                     GUINT_TO_POINTER (rule->max_threads));
+		}
 	}
 
-	g_message ("Loading extractor rules... (%s)", extractors_dir);
+	for (i = 0; i < rules->len; i++) {
+		rule = &g_array_index (rules, RuleInfo, i);
+
+		if (!rule->module_path) {
+			continue;
+		}
+
+		rule->max_threads = GPOINTER_TO_UINT (g_hash_table_lookup (max_threads,
+		                                                           rule->module_path));
+	}
+
+	g_hash_table_unref (max_threads);
+}
+
+static void
+load_rule_files (const gchar *rules_dir,
+                 GList       *files)
+{
+	GError *error = NULL;
+	GList *l;
+
+	g_message ("Loading extractor rules... (%s)", rules_dir);
 
 	for (l = files; l; l = l->next) {
 		GKeyFile *key_file;
@@ -187,7 +521,7 @@ tracker_extract_module_manager_init (void)
 			continue;
 		}
 
-		path = g_build_filename (extractors_dir, name, NULL);
+		path = g_build_filename (rules_dir, name, NULL);
 		key_file = g_key_file_new ();
 
 		if (!g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, &error) ||
@@ -201,16 +535,87 @@ tracker_extract_module_manager_init (void)
 		g_key_file_free (key_file);
 		g_free (path);
 	}
+}
+
+gboolean
+tracker_extract_module_manager_init (void)
+{
+	const gchar *extractors_dir, *name;
+	gchar *cache_path = NULL;
+	GVariant *stamp = NULL;
+	GList *files = NULL;
+	GError *error = NULL;
+	GDir *dir;
+
+	if (initialized) {
+		return TRUE;
+	}
+
+	if (!g_module_supported ()) {
+		g_error ("Modules are not supported for this platform");
+		return FALSE;
+	}
+
+	extractors_dir = g_getenv ("TRACKER_EXTRACTOR_RULES_DIR");
+	if (G_LIKELY (extractors_dir == NULL)) {
+		extractors_dir = TRACKER_EXTRACTOR_RULES_DIR;
+	} else {
+		g_message ("Extractor rules directory is '%s' (set in env)", extractors_dir);
+	}
+
+	dir = g_dir_open (extractors_dir, 0, &error);
+
+	if (!dir) {
+		g_error ("Error opening extractor rules directory: %s", error->message);
+		g_error_free (error);
+		return FALSE;
+	}
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		files = g_list_insert_sorted (files, (gpointer) name, (GCompareFunc) g_strcmp0);
+	}
+
+	if (g_getenv ("TRACKER_EXTRACTOR_RULES_CACHE")) {
+		cache_path = get_rules_cache_path ();
+		stamp = g_variant_ref_sink (get_rules_stamp (extractors_dir, files));
+	}
+
+	if (cache_path && load_rules_cache (cache_path, extractors_dir, stamp)) {
+		g_message ("Loaded extractor rules from cache (%s)", cache_path);
+	} else {
+		load_rule_files (extractors_dir, files);
+
+		if (cache_path) {
+			save_rules_cache (cache_path, extractors_dir, stamp);
+		}
+	}
 
 	g_message ("Extractor rules loaded");
 	g_list_free (files);
 	g_dir_close (dir);
+	g_free (cache_path);
+
+	if (stamp) {
+		g_variant_unref (stamp);
+	}
 
-	/* Initialize miscellaneous data */
+	if (rules) {
+		harmonize_max_threads ();
+	}
+
+	compile_rules ();
+
+	/* Initialize miscellaneous data, lookups with no
+	 * matching rules are cached too, with a NULL list.
+	 */
 	mimetype_map = g_hash_table_new_full (g_str_hash,
 	                                      g_str_equal,
 	                                      (GDestroyNotify) g_free,
 	                                      NULL);
+	fallback_rdf_types_map = g_hash_table_new_full (g_str_hash,
+	                                                g_str_equal,
+	                                                (GDestroyNotify) g_free,
+	                                                NULL);
 	initialized = TRUE;
 
 	return TRUE;
@@ -220,102 +625,124 @@ static GList *
 lookup_rules (const gchar *mimetype)
 {
 	GList *mimetype_rules = NULL;
-	RuleInfo *info;
-	gchar *reversed;
-	gint len, i;
+	gpointer cached;
+	const gchar *slash;
+	guint8 *matched;
+	gint i;
 
 	if (!rules) {
 		return NULL;
 	}
 
-	if (mimetype_map) {
-		mimetype_rules = g_hash_table_lookup (mimetype_map, mimetype);
+	if (g_hash_table_lookup_extended (mimetype_map, mimetype, NULL, &cached)) {
+		return cached;
+	}
+
+	matched = g_alloca (rules->len);
+	memset (matched, 0, rules->len);
 
-		if (mimetype_rules) {
-			return mimetype_rules;
-		}
+	mark_rules (g_hash_table_lookup (literal_patterns, mimetype), matched);
+
+	slash = strchr (mimetype, '/');
+
+	if (slash) {
+		gchar *media_type;
+
+		media_type = g_strndup (mimetype, slash - mimetype);
+		mark_rules (g_hash_table_lookup (media_type_patterns, media_type), matched);
+		g_free (media_type);
 	}
 
-	reversed = g_strdup (mimetype);
-	g_strreverse (reversed);
-	len = strlen (mimetype);
+	if (glob_patterns->len > 0) {
+		gchar *reversed;
+		gint len;
 
-	/* Apply the rules! */
-	for (i = 0; i < rules->len; i++) {
-		GList *l;
+		reversed = g_strdup (mimetype);
+		g_strreverse (reversed);
+		len = strlen (mimetype);
 
-		info = &g_array_index (rules, RuleInfo, i);
+		for (i = 0; i < glob_patterns->len; i++) {
+			GlobPattern *glob = &g_array_index (glob_patterns, GlobPattern, i);
 
-		for (l = info->patterns; l; l = l->next) {
-			if (g_pattern_match (l->data, len, mimetype, reversed)) {
-				/* Match, store for future queries and return */
-				mimetype_rules = g_list_prepend (mimetype_rules, info);
+			if (!matched[glob->rule_index] &&
+			    g_pattern_match (glob->pattern, len, mimetype, reversed)) {
+				matched[glob->rule_index] = TRUE;
 			}
 		}
+
+		g_free (reversed);
 	}
 
-	if (mimetype_rules) {
-		mimetype_rules = g_list_reverse (mimetype_rules);
-		g_hash_table_insert (mimetype_map, g_strdup (mimetype), mimetype_rules);
+	/* Apply the rules! */
+	for (i = rules->len - 1; i >= 0; i--) {
+		if (matched[i]) {
+			mimetype_rules = g_list_prepend (mimetype_rules,
+			                                 &g_array_index (rules, RuleInfo, i));
+		}
 	}
 
-	g_free (reversed);
+	/* Store for future queries, even if there was no match */
+	g_hash_table_insert (mimetype_map, g_strdup (mimetype), mimetype_rules);
 
 	return mimetype_rules;
 }
 
-GStrv
-tracker_extract_module_manager_get_fallback_rdf_types (const gchar *mimetype)
+/* The returned array and its strings are owned by the
+ * module manager and valid for the process lifetime.
+ */
+const gchar * const *
+tracker_extract_module_manager_peek_fallback_rdf_types (const gchar *mimetype)
 {
-	GList *l, *list;
-	GHashTable *rdf_types;
-	gchar **types, *type;
-	GHashTableIter iter;
-	gint i;
+	static const gchar *no_types[] = { NULL };
+	const gchar **types;
+	GList *l;
 
 	if (!initialized &&
 	    !tracker_extract_module_manager_init ()) {
 		return NULL;
 	}
 
-	list = lookup_rules (mimetype);
-	rdf_types = g_hash_table_new (g_str_hash, g_str_equal);
+	types = g_hash_table_lookup (fallback_rdf_types_map, mimetype);
 
-	for (l = list; l; l = l->next) {
-		RuleInfo *r_info = l->data;
+	if (types) {
+		return types;
+	}
 
-		if (r_info->fallback_rdf_types == NULL)
-			continue;
+	types = no_types;
 
-		for (i = 0; r_info->fallback_rdf_types[i]; i++) {
-                        g_debug ("Adding RDF type: %s, for module: %s",
-                                 r_info->fallback_rdf_types[i],
-                                 r_info->module_path);
-			g_hash_table_insert (rdf_types,
-					     r_info->fallback_rdf_types[i],
-					     r_info->fallback_rdf_types[i]);
-		}
+	for (l = lookup_rules (mimetype); l; l = l->next) {
+		RuleInfo *r_info = l->data;
 
-                /* We only want the first RDF types matching */
-                break;
+		/* We only want the first RDF types matching */
+		if (r_info->rdf_types) {
+			g_debug ("Using RDF types from module: %s, for mimetype: %s",
+			         r_info->module_path, mimetype);
+			types = r_info->rdf_types;
+			break;
+		}
 	}
 
-	g_hash_table_iter_init (&iter, rdf_types);
-	types = g_new0 (gchar*, g_hash_table_size (rdf_types) + 1);
-	i = 0;
+	g_hash_table_insert (fallback_rdf_types_map, g_strdup (mimetype), types);
 
-	while (g_hash_table_iter_next (&iter, (gpointer*) &type, NULL)) {
-		types[i] = g_strdup (type);
-		i++;
-	}
+	return types;
+}
 
-	g_hash_table_unref (rdf_types);
+GStrv
+tracker_extract_module_manager_get_fallback_rdf_types (const gchar *mimetype)
+{
+	const gchar * const *types;
 
-	return types;
+	types = tracker_extract_module_manager_peek_fallback_rdf_types (mimetype);
+
+	if (!types) {
+		return NULL;
+	}
+
+	return g_strdupv ((gchar **) types);
 }
 
 static ModuleInfo *
-load_module (RuleInfo *info)
+load_module_unlocked (RuleInfo *info)
 {
 	ModuleInfo *module_info = NULL;
 
@@ -381,6 +808,21 @@ load_module (RuleInfo *info)
 	return module_info;
 }
 
+/* Modules may be iterated from extractor threads when
+ * falling back to the next module for a mimetype.
+ */
+static ModuleInfo *
+load_module (RuleInfo *info)
+{
+	ModuleInfo *module_info;
+
+	g_mutex_lock (&modules_mutex);
+	module_info = load_module_unlocked (info);
+	g_mutex_unlock (&modules_mutex);
+
+	return module_info;
+}
+
 static gboolean
 initialize_first_module (TrackerMimetypeInfo *info)
 {
@@ -473,6 +915,35 @@ tracker_mimetype_info_get_module (TrackerMimetypeInfo          *info,
 	return info->cur_module_info->module;
 }
 
+/**
+ * tracker_mimetype_info_get_max_threads:
+ * @info: a #TrackerMimetypeInfo
+ *
+ * Returns the maximum number of threads that may run the module
+ * @info is currently pointing to concurrently, as declared through
+ * the Threads key of its extractor rule. Modules that don't declare
+ * it are considered non-reentrant and get 1.
+ *
+ * Returns: The maximum number of concurrent threads for the module.
+ *
+ * Since: 2.0
+ **/
+guint
+tracker_mimetype_info_get_max_threads (TrackerMimetypeInfo *info)
+{
+	RuleInfo *rule;
+
+	g_return_val_if_fail (info != NULL, 1);
+
+	if (!info->cur) {
+		return 1;
+	}
+
+	rule = info->cur->data;
+
+	return MAX (rule->max_threads, 1);
+}
+
 /**
  * tracker_mimetype_info_iter_next:
  * @info: a #TrackerMimetypeInfo
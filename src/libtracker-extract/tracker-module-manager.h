@@ -44,9 +44,11 @@ gboolean  tracker_extract_module_manager_init                (void) G_GNUC_CONST
 
 TrackerMimetypeInfo * tracker_extract_module_manager_get_mimetype_handlers  (const gchar *mimetype);
 GStrv                 tracker_extract_module_manager_get_fallback_rdf_types (const gchar *mimetype);
+const gchar * const * tracker_extract_module_manager_peek_fallback_rdf_types (const gchar *mimetype);
 
 GModule * tracker_mimetype_info_get_module (TrackerMimetypeInfo          *info,
                                             TrackerExtractMetadataFunc   *extract_func);
+guint     tracker_mimetype_info_get_max_threads (TrackerMimetypeInfo     *info);
 gboolean  tracker_mimetype_info_iter_next  (TrackerMimetypeInfo          *info);
 void      tracker_mimetype_info_free       (TrackerMimetypeInfo          *info);
 
@@ -360,6 +360,63 @@ tracker_text_normalize (const gchar *text,
 
 // LCOV_EXCL_STOP
 
+/* All-ones and all-high-bits masks for a native machine word */
+#define WORD_LOW_BITS  ((gsize) -1 / 0xFF)
+#define WORD_HIGH_BITS (WORD_LOW_BITS * 0x80)
+
+/* Returns a pointer to the first byte in @text that does not start a
+ * valid UTF-8 character, following the same rules as g_utf8_validate().
+ * Plain text and source code are mostly ASCII, so runs of ASCII bytes
+ * are checked a machine word at a time, and only the remaining
+ * multi-byte characters go through g_utf8_validate().
+ */
+static const gchar *
+utf8_find_invalid (const gchar *text,
+                   gsize        len)
+{
+	const gchar *p = text;
+	const gchar *end = text + len;
+
+	while (p < end) {
+		gsize skip;
+
+		/* Skip words holding only non-NUL ASCII bytes */
+		while ((gsize) (end - p) >= sizeof (gsize)) {
+			gsize word;
+
+			memcpy (&word, p, sizeof (gsize));
+
+			if ((word & WORD_HIGH_BITS) != 0 ||
+			    ((word - WORD_LOW_BITS) & ~word & WORD_HIGH_BITS) != 0)
+				break;
+
+			p += sizeof (gsize);
+		}
+
+		if (p == end)
+			break;
+
+		if ((guchar) *p < 0x80) {
+			/* Embedded NULs are not valid, as in g_utf8_validate() */
+			if (*p == '\0')
+				break;
+
+			p++;
+			continue;
+		}
+
+		skip = g_utf8_skip[(guchar) *p];
+
+		if (skip > (gsize) (end - p) ||
+		    !g_utf8_validate (p, skip, NULL))
+			break;
+
+		p += skip;
+	}
+
+	return p;
+}
+
 /**
  * tracker_text_validate_utf8:
  * @text: the text to validate
@@ -393,7 +450,7 @@ tracker_text_validate_utf8 (const gchar  *text,
 
 		/* Validate string, getting the pointer to first non-valid character
 		 *  (if any) or to the end of the string. */
-		g_utf8_validate (text, len_to_validate, &end);
+		end = utf8_find_invalid (text, len_to_validate);
 		if (end > text) {
 			/* If str output required... */
 			if (str) {
@@ -415,6 +472,334 @@ tracker_text_validate_utf8 (const gchar  *text,
 	return FALSE;
 }
 
+struct _TrackerTextNormalizer {
+	gchar *buffer;
+	gsize len;
+	gsize allocated;
+	gsize max_bytes;
+	guint max_words;
+	guint n_words;
+
+	/* Leading bytes of a character cut at the end of the last chunk */
+	gchar partial[4];
+	gsize partial_len;
+
+	guint in_break : 1;
+	guint full : 1;
+};
+
+static void
+normalizer_ensure (TrackerTextNormalizer *normalizer,
+                   gsize                  extra)
+{
+	gsize needed, size;
+
+	needed = normalizer->len + extra + 1;
+
+	if (needed <= normalizer->allocated)
+		return;
+
+	/* Grow geometrically, but never past the byte budget */
+	size = MAX (MAX (normalizer->allocated * 2, needed), 256);
+	size = MIN (size, normalizer->max_bytes + 1);
+
+	normalizer->buffer = g_realloc (normalizer->buffer, size);
+	normalizer->allocated = size;
+}
+
+static void
+normalizer_append (TrackerTextNormalizer *normalizer,
+                   const gchar           *bytes,
+                   gsize                  len)
+{
+	gsize separator = 0, available;
+
+	if (normalizer->full || len == 0)
+		return;
+
+	if (normalizer->in_break) {
+		if (normalizer->max_words > 0 &&
+		    normalizer->n_words == normalizer->max_words) {
+			normalizer->full = TRUE;
+			return;
+		}
+
+		separator = normalizer->len > 0 ? 1 : 0;
+	}
+
+	available = normalizer->max_bytes - normalizer->len;
+
+	if (separator + len > available) {
+		normalizer->full = TRUE;
+
+		if (available <= separator)
+			return;
+
+		/* Cut the word, but not in the middle of a character */
+		len = available - separator;
+		while (len > 0 && ((guchar) bytes[len] & 0xC0) == 0x80)
+			len--;
+
+		if (len == 0)
+			return;
+	}
+
+	if (normalizer->in_break) {
+		normalizer->n_words++;
+		normalizer->in_break = FALSE;
+	}
+
+	normalizer_ensure (normalizer, separator + len);
+
+	if (separator)
+		normalizer->buffer[normalizer->len++] = ' ';
+
+	memcpy (&normalizer->buffer[normalizer->len], bytes, len);
+	normalizer->len += len;
+	normalizer->buffer[normalizer->len] = '\0';
+}
+
+static void
+normalizer_append_char (TrackerTextNormalizer *normalizer,
+                        const gchar           *bytes,
+                        gsize                  len)
+{
+	gunichar ch;
+
+	ch = g_utf8_get_char_validated (bytes, len);
+
+	if (ch == (gunichar) -1 || ch == (gunichar) -2 ||
+	    g_unichar_isspace (ch) || g_unichar_iscntrl (ch)) {
+		normalizer->in_break = TRUE;
+	} else {
+		normalizer_append (normalizer, bytes, len);
+	}
+}
+
+/* Returns TRUE if @len bytes at @bytes may start a valid UTF-8
+ * character that continues in the next chunk */
+static gboolean
+is_partial_char (const gchar *bytes,
+                 gsize        len)
+{
+	gsize i;
+
+	if ((guchar) bytes[0] < 0xC2 || (guchar) bytes[0] > 0xF4)
+		return FALSE;
+
+	for (i = 1; i < len; i++) {
+		if (((guchar) bytes[i] & 0xC0) != 0x80)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * tracker_text_normalizer_new:
+ * @max_bytes: maximum number of bytes of normalized text to keep
+ * @max_words: maximum number of words to keep, or 0 for no limit
+ *
+ * Creates a #TrackerTextNormalizer, which collects text fed to it in
+ * chunks with tracker_text_normalizer_feed(). Words are kept as they
+ * come, while runs of whitespace, control characters and invalid
+ * UTF-8 are collapsed into single spaces.
+ *
+ * The normalized text never grows past @max_bytes, so extractors can
+ * feed documents piece by piece as they parse them, without building
+ * a full-size intermediate copy first.
+ *
+ * Returns: (transfer full): a new #TrackerTextNormalizer. Free with
+ * tracker_text_normalizer_finish() or tracker_text_normalizer_free().
+ *
+ * Since: 2.0
+ **/
+TrackerTextNormalizer *
+tracker_text_normalizer_new (gsize max_bytes,
+                             guint max_words)
+{
+	TrackerTextNormalizer *normalizer;
+
+	g_return_val_if_fail (max_bytes > 0, NULL);
+
+	normalizer = g_new0 (TrackerTextNormalizer, 1);
+	normalizer->max_bytes = max_bytes;
+	normalizer->max_words = max_words;
+	normalizer->in_break = TRUE;
+
+	return normalizer;
+}
+
+/**
+ * tracker_text_normalizer_feed:
+ * @normalizer: a #TrackerTextNormalizer
+ * @text: the next chunk of text, in UTF-8
+ * @text_len: length of @text, or -1 if NUL-terminated
+ *
+ * Appends @text to the normalized text. Chunks don't need to end on
+ * word or character boundaries: words and UTF-8 characters split
+ * across chunks are joined back together. To separate the words at
+ * both sides of a chunk boundary, feed a space.
+ *
+ * Returns: %FALSE once the byte or word budget has been reached, in
+ * which case feeding more text has no effect, %TRUE otherwise.
+ *
+ * Since: 2.0
+ **/
+gboolean
+tracker_text_normalizer_feed (TrackerTextNormalizer *normalizer,
+                              const gchar           *text,
+                              gssize                 text_len)
+{
+	const gchar *p, *end, *run;
+
+	g_return_val_if_fail (normalizer != NULL, FALSE);
+	g_return_val_if_fail (text != NULL || text_len == 0, FALSE);
+
+	if (normalizer->full)
+		return FALSE;
+
+	if (text_len < 0)
+		text_len = strlen (text);
+
+	p = text;
+	end = text + text_len;
+
+	/* Finish off the character cut at the end of the last chunk */
+	if (normalizer->partial_len > 0) {
+		gsize char_len;
+
+		char_len = g_utf8_skip[(guchar) normalizer->partial[0]];
+
+		while (p < end &&
+		       normalizer->partial_len < char_len &&
+		       ((guchar) *p & 0xC0) == 0x80) {
+			normalizer->partial[normalizer->partial_len++] = *p++;
+		}
+
+		if (normalizer->partial_len < char_len && p == end)
+			return TRUE;
+
+		normalizer_append_char (normalizer,
+		                        normalizer->partial,
+		                        normalizer->partial_len);
+		normalizer->partial_len = 0;
+
+		if (normalizer->full)
+			return FALSE;
+	}
+
+	/* Words are appended as whole runs of bytes, only breaks
+	 * between words need looking at character by character. */
+	run = p;
+
+	while (p < end) {
+		guchar c = *p;
+		gsize char_len;
+		gunichar ch;
+
+		if (c < 0x80) {
+			if (c > 0x20 && c != 0x7F) {
+				p++;
+				continue;
+			}
+
+			normalizer_append (normalizer, run, p - run);
+			normalizer->in_break = TRUE;
+			run = ++p;
+
+			if (normalizer->full)
+				return FALSE;
+
+			continue;
+		}
+
+		char_len = g_utf8_skip[c];
+
+		if (char_len > (gsize) (end - p) &&
+		    is_partial_char (p, end - p)) {
+			normalizer_append (normalizer, run, p - run);
+			memcpy (normalizer->partial, p, end - p);
+			normalizer->partial_len = end - p;
+			return !normalizer->full;
+		}
+
+		ch = g_utf8_get_char_validated (p, MIN (char_len, (gsize) (end - p)));
+
+		if (ch == (gunichar) -1 || ch == (gunichar) -2) {
+			/* Skip invalid bytes one at a time */
+			normalizer_append (normalizer, run, p - run);
+			normalizer->in_break = TRUE;
+			run = ++p;
+		} else if (g_unichar_isspace (ch) || g_unichar_iscntrl (ch)) {
+			normalizer_append (normalizer, run, p - run);
+			normalizer->in_break = TRUE;
+			p += char_len;
+			run = p;
+		} else {
+			p += char_len;
+		}
+
+		if (normalizer->full)
+			return FALSE;
+	}
+
+	normalizer_append (normalizer, run, p - run);
+
+	return !normalizer->full;
+}
+
+/**
+ * tracker_text_normalizer_finish:
+ * @normalizer: a #TrackerTextNormalizer
+ * @len: (out) (optional): return location for the length of the
+ *  normalized text, or %NULL
+ *
+ * Frees @normalizer, giving back the text collected so far.
+ *
+ * Returns: (transfer full) (nullable): the normalized text, or %NULL
+ * if no words were found. Free with g_free().
+ *
+ * Since: 2.0
+ **/
+gchar *
+tracker_text_normalizer_finish (TrackerTextNormalizer *normalizer,
+                                gsize                 *len)
+{
+	gchar *text = NULL;
+
+	g_return_val_if_fail (normalizer != NULL, NULL);
+
+	if (len)
+		*len = normalizer->len;
+
+	if (normalizer->len > 0)
+		text = normalizer->buffer;
+	else
+		g_free (normalizer->buffer);
+
+	g_free (normalizer);
+
+	return text;
+}
+
+/**
+ * tracker_text_normalizer_free:
+ * @normalizer: a #TrackerTextNormalizer
+ *
+ * Frees @normalizer and the text collected so far.
+ *
+ * Since: 2.0
+ **/
+void
+tracker_text_normalizer_free (TrackerTextNormalizer *normalizer)
+{
+	g_return_if_fail (normalizer != NULL);
+
+	g_free (normalizer->buffer);
+	g_free (normalizer);
+}
+
 /**
  * tracker_date_format_to_iso8601:
  * @date_string: the date in a string pointer
@@ -28,6 +28,14 @@
 
 G_BEGIN_DECLS
 
+/**
+ * TrackerTextNormalizer:
+ *
+ * An opaque structure collecting normalized text incrementally, see
+ * tracker_text_normalizer_new().
+ **/
+typedef struct _TrackerTextNormalizer TrackerTextNormalizer;
+
 #ifndef TRACKER_DISABLE_DEPRECATED
 gchar*       tracker_coalesce               (gint         n_values,
                                                           ...) G_GNUC_DEPRECATED;
@@ -43,6 +51,17 @@ gboolean     tracker_text_validate_utf8     (const gchar  *text,
                                              gssize        text_len,
                                              GString     **str,
                                              gsize        *valid_len);
+
+TrackerTextNormalizer *
+             tracker_text_normalizer_new    (gsize                  max_bytes,
+                                             guint                  max_words);
+gboolean     tracker_text_normalizer_feed   (TrackerTextNormalizer *normalizer,
+                                             const gchar           *text,
+                                             gssize                 text_len);
+gchar*       tracker_text_normalizer_finish (TrackerTextNormalizer *normalizer,
+                                             gsize                 *len);
+void         tracker_text_normalizer_free   (TrackerTextNormalizer *normalizer);
+
 gchar*       tracker_date_guess             (const gchar *date_string);
 gchar*       tracker_date_format_to_iso8601 (const gchar *date_string,
                                              const gchar *format);
@@ -649,6 +649,12 @@ register_namespace (const gchar *ns_uri,
         }
 }
 
+/* Exempi initialization is reference counted, but not thread-safe,
+ * neither is its namespace registry, modules may parse XMP from
+ * several threads at once.
+ */
+static GMutex xmp_init_mutex;
+
 #endif /* HAVE_EXEMPI */
 
 static gboolean
@@ -665,11 +671,12 @@ parse_xmp (const gchar    *buffer,
 
 #ifdef HAVE_EXEMPI
 
+	g_mutex_lock (&xmp_init_mutex);
 	xmp_init ();
-
-        register_namespace (NS_XMP_REGIONS, "mwg-rs");
-        register_namespace (NS_ST_DIM, "stDim");
-        register_namespace (NS_ST_AREA, "stArea");
+	register_namespace (NS_XMP_REGIONS, "mwg-rs");
+	register_namespace (NS_ST_DIM, "stDim");
+	register_namespace (NS_ST_AREA, "stArea");
+	g_mutex_unlock (&xmp_init_mutex);
 
 	xmp = xmp_new_empty ();
 	xmp_parse (xmp, buffer, len);
@@ -683,7 +690,9 @@ parse_xmp (const gchar    *buffer,
 		xmp_free (xmp);
 	}
 
+	g_mutex_lock (&xmp_init_mutex);
 	xmp_terminate ();
+	g_mutex_unlock (&xmp_init_mutex);
 #endif /* HAVE_EXEMPI */
 
 	return TRUE;
@@ -759,6 +759,42 @@ tracker_file_is_hidden (GFile *file)
 	return is_hidden;
 }
 
+/**
+ * tracker_file_is_hidden_with_info:
+ * @file: a #GFile
+ * @info: (allow-none): a #GFileInfo for @file
+ *
+ * Like tracker_file_is_hidden(), but without any I/O. The hidden
+ * attribute of @info is used if it was requested when @info was
+ * created, e.g. while enumerating the parent directory. Otherwise
+ * only the basename is checked.
+ *
+ * Returns: %TRUE if @file is hidden.
+ **/
+gboolean
+tracker_file_is_hidden_with_info (GFile     *file,
+                                  GFileInfo *info)
+{
+	gchar *basename;
+	gboolean is_hidden;
+
+	if (info) {
+		if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN)) {
+			return g_file_info_get_is_hidden (info);
+		}
+
+		if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_NAME)) {
+			return g_file_info_get_name (info)[0] == '.';
+		}
+	}
+
+	basename = g_file_get_basename (file);
+	is_hidden = basename && basename[0] == '.';
+	g_free (basename);
+
+	return is_hidden;
+}
+
 gint
 tracker_file_cmp (GFile *file_a,
                   GFile *file_b)
@@ -840,3 +876,252 @@ tracker_filename_casecmp_without_extension (const gchar *a,
 
 	return g_ascii_strncasecmp (a, b, len_a) == 0;
 }
+
+/* Prefixes up to this length are looked up without allocating */
+#define MATCHER_PREFIX_BUFFER_SIZE 256
+
+struct _TrackerFileMatcher {
+	/* Patterns starting with G_DIR_SEPARATOR, compared against full paths */
+	GHashTable *paths;
+
+	/* Patterns compared against basenames, split by shape so that most
+	 * of them are resolved with a hash lookup: "name", "prefix*" and
+	 * "*suffix". Anything else goes through GPatternSpec.
+	 */
+	GHashTable *names;
+	GHashTable *prefixes;
+	GHashTable *suffixes;
+	GArray *prefix_lengths;
+	GArray *suffix_lengths;
+	GPtrArray *globs;
+};
+
+static gboolean
+has_wildcards (const gchar *str,
+               gsize        len)
+{
+	gsize i;
+
+	for (i = 0; i < len; i++) {
+		if (str[i] == '*' || str[i] == '?') {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void
+matcher_add_affix (GHashTable  *affixes,
+                   GArray      *lengths,
+                   const gchar *affix,
+                   gsize        len)
+{
+	guint i, length = len;
+
+	g_hash_table_add (affixes, g_strndup (affix, len));
+
+	for (i = 0; i < lengths->len; i++) {
+		if (g_array_index (lengths, guint, i) == length) {
+			return;
+		}
+	}
+
+	g_array_append_val (lengths, length);
+}
+
+/**
+ * tracker_file_matcher_new:
+ * @patterns: (element-type utf8): list of paths and glob patterns
+ *
+ * Compiles @patterns into a #TrackerFileMatcher. Patterns starting
+ * with G_DIR_SEPARATOR match full paths, any other is a glob pattern
+ * as understood by #GPatternSpec, matched against the basename.
+ *
+ * Returns: a new #TrackerFileMatcher, free with tracker_file_matcher_free().
+ **/
+TrackerFileMatcher *
+tracker_file_matcher_new (GSList *patterns)
+{
+	TrackerFileMatcher *matcher;
+	GSList *l;
+
+	matcher = g_slice_new0 (TrackerFileMatcher);
+	matcher->paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	matcher->names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	matcher->prefixes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	matcher->suffixes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	matcher->prefix_lengths = g_array_new (FALSE, FALSE, sizeof (guint));
+	matcher->suffix_lengths = g_array_new (FALSE, FALSE, sizeof (guint));
+	matcher->globs = g_ptr_array_new_with_free_func ((GDestroyNotify) g_pattern_spec_free);
+
+	for (l = patterns; l; l = l->next) {
+		const gchar *str = l->data;
+		gsize len;
+
+		if (!str || !*str) {
+			continue;
+		}
+
+		len = strlen (str);
+
+		if (*str == G_DIR_SEPARATOR) {
+			g_hash_table_add (matcher->paths, g_strdup (str));
+		} else if (!has_wildcards (str, len)) {
+			g_hash_table_add (matcher->names, g_strdup (str));
+		} else if (len > 1 && str[0] == '*' &&
+		           !has_wildcards (str + 1, len - 1)) {
+			matcher_add_affix (matcher->suffixes, matcher->suffix_lengths,
+			                   str + 1, len - 1);
+		} else if (len > 1 && str[len - 1] == '*' &&
+		           !has_wildcards (str, len - 1)) {
+			matcher_add_affix (matcher->prefixes, matcher->prefix_lengths,
+			                   str, len - 1);
+		} else {
+			g_ptr_array_add (matcher->globs, g_pattern_spec_new (str));
+		}
+	}
+
+	return matcher;
+}
+
+/**
+ * tracker_file_matcher_free:
+ * @matcher: a #TrackerFileMatcher
+ *
+ * Frees @matcher.
+ **/
+void
+tracker_file_matcher_free (TrackerFileMatcher *matcher)
+{
+	if (!matcher) {
+		return;
+	}
+
+	g_hash_table_unref (matcher->paths);
+	g_hash_table_unref (matcher->names);
+	g_hash_table_unref (matcher->prefixes);
+	g_hash_table_unref (matcher->suffixes);
+	g_array_unref (matcher->prefix_lengths);
+	g_array_unref (matcher->suffix_lengths);
+	g_ptr_array_unref (matcher->globs);
+	g_slice_free (TrackerFileMatcher, matcher);
+}
+
+static gboolean
+matcher_match_prefix (TrackerFileMatcher *matcher,
+                      const gchar        *basename,
+                      gsize               len)
+{
+	gchar buffer[MATCHER_PREFIX_BUFFER_SIZE];
+	guint i;
+
+	for (i = 0; i < matcher->prefix_lengths->len; i++) {
+		guint length = g_array_index (matcher->prefix_lengths, guint, i);
+		gboolean found;
+
+		if (length > len) {
+			continue;
+		}
+
+		if (length < sizeof (buffer)) {
+			memcpy (buffer, basename, length);
+			buffer[length] = '\0';
+			found = g_hash_table_contains (matcher->prefixes, buffer);
+		} else {
+			gchar *prefix;
+
+			prefix = g_strndup (basename, length);
+			found = g_hash_table_contains (matcher->prefixes, prefix);
+			g_free (prefix);
+		}
+
+		if (found) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static gboolean
+matcher_match_suffix (TrackerFileMatcher *matcher,
+                      const gchar        *basename,
+                      gsize               len)
+{
+	guint i;
+
+	for (i = 0; i < matcher->suffix_lengths->len; i++) {
+		guint length = g_array_index (matcher->suffix_lengths, guint, i);
+
+		if (length <= len &&
+		    g_hash_table_contains (matcher->suffixes, basename + len - length)) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static gboolean
+matcher_match_globs (TrackerFileMatcher *matcher,
+                     const gchar        *basename,
+                     gsize               len)
+{
+	gboolean found = FALSE;
+	gchar *reversed;
+	guint i;
+
+	/* Reversed once for all patterns, instead of once per
+	 * pattern as g_pattern_match_string() would do.
+	 */
+	reversed = g_utf8_strreverse (basename, len);
+
+	for (i = 0; i < matcher->globs->len && !found; i++) {
+		found = g_pattern_match (g_ptr_array_index (matcher->globs, i),
+		                         len, basename, reversed);
+	}
+
+	g_free (reversed);
+
+	return found;
+}
+
+/**
+ * tracker_file_matcher_match:
+ * @matcher: a #TrackerFileMatcher
+ * @path: an absolute path
+ *
+ * Checks whether @path, or its basename, matches any of the
+ * patterns @matcher was created with.
+ *
+ * Returns: %TRUE if @path matches.
+ **/
+gboolean
+tracker_file_matcher_match (TrackerFileMatcher *matcher,
+                            const gchar        *path)
+{
+	const gchar *basename;
+	gsize len;
+
+	g_return_val_if_fail (matcher != NULL, FALSE);
+	g_return_val_if_fail (path != NULL, FALSE);
+
+	if (g_hash_table_size (matcher->paths) > 0 &&
+	    g_hash_table_contains (matcher->paths, path)) {
+		return TRUE;
+	}
+
+	basename = strrchr (path, G_DIR_SEPARATOR);
+	basename = basename ? basename + 1 : path;
+	len = strlen (basename);
+
+	if (g_hash_table_contains (matcher->names, basename) ||
+	    matcher_match_suffix (matcher, basename, len) ||
+	    matcher_match_prefix (matcher, basename, len)) {
+		return TRUE;
+	}
+
+	return (matcher->globs->len > 0 &&
+	        matcher_match_globs (matcher, basename, len));
+}
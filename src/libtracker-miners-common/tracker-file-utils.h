@@ -42,6 +42,8 @@ guint64  tracker_file_get_mtime_uri                         (const gchar *uri);
 gchar *  tracker_file_get_mime_type                         (GFile       *file);
 gboolean tracker_file_is_locked                             (GFile       *file);
 gboolean tracker_file_is_hidden                             (GFile       *file);
+gboolean tracker_file_is_hidden_with_info                   (GFile       *file,
+                                                             GFileInfo   *info);
 gint     tracker_file_cmp                                   (GFile       *file_a,
                                                              GFile       *file_b);
 
@@ -63,6 +65,14 @@ gboolean tracker_file_system_has_enough_space               (const gchar *path,
 guint64  tracker_file_system_get_remaining_space            (const gchar *path);
 gdouble  tracker_file_system_get_remaining_space_percentage (const gchar *path);
 
+/* File matching */
+typedef struct _TrackerFileMatcher TrackerFileMatcher;
+
+TrackerFileMatcher * tracker_file_matcher_new               (GSList             *patterns);
+void                 tracker_file_matcher_free              (TrackerFileMatcher *matcher);
+gboolean             tracker_file_matcher_match             (TrackerFileMatcher *matcher,
+                                                             const gchar        *path);
+
 G_END_DECLS
 
 #endif /* __LIBTRACKER_COMMON_FILE_UTILS_H__ */
@@ -34,45 +34,207 @@
 #include "tracker-log.h"
 #include "tracker-file-utils.h"
 
+/* Log files are rotated past this size, keeping
+ * LOG_ROTATE_COUNT previous files as <name>.1, <name>.2...
+ */
+#define LOG_MAX_SIZE        (10 << 20)
+#define LOG_ROTATE_COUNT    3
+
+/* Per-thread buffers wake up the flusher past LOG_BUFFER_WAKEUP
+ * bytes, past LOG_BUFFER_MAX the logging thread also waits for the
+ * flush to complete, so memory stays bounded if the flusher lags.
+ */
+#define LOG_BUFFER_WAKEUP   (16 << 10)
+#define LOG_BUFFER_MAX      (1 << 20)
+#define LOG_FLUSH_INTERVAL  (250 * G_TIME_SPAN_MILLISECOND)
+
+typedef enum {
+	LOG_FORMAT_TEXT,
+	LOG_FORMAT_JSON,
+} LogFormat;
+
+/* Owned by the thread logging into it, the mutex is only
+ * ever contended by the flusher while it copies the data out.
+ */
+typedef struct {
+	GMutex mutex;
+	GString *data;
+	gboolean orphaned;
+
+	/* Timestamp formatting is redone once per second */
+	gint64 cached_second;
+	gchar cached_time[64];
+} LogBuffer;
+
 static gboolean  initialized;
 static FILE     *fd;
+static gchar    *log_filename;
+static gsize     log_size;
+static LogFormat log_format;
 static gint      verbosity;
 static guint     log_handler_id;
 static gboolean  use_log_files;
 static GMutex    mutex;
+static GString  *unbuffered;
 
-static inline void
-log_output (const gchar    *domain,
-            GLogLevelFlags  log_level,
-            const gchar    *message)
+static void       log_buffer_orphan (gpointer data);
+
+static gboolean   use_buffers;
+static GPtrArray *buffers;
+static GMutex     buffers_mutex;
+static GPrivate   thread_buffer = G_PRIVATE_INIT (log_buffer_orphan);
+static GMutex     write_mutex;
+static GString   *pending;
+
+/* The flusher is the only thread writing to, and rotating, the
+ * log file. It is created before any thread sets up a seccomp
+ * filter, so it stays allowed to rename and create files.
+ */
+static GThread  *flusher;
+static gboolean  flusher_running;
+static GMutex    flusher_mutex;
+static GCond     flusher_cond;
+static GCond     flush_done_cond;
+static guint64   flush_requested;
+static guint64   flush_completed;
+
+static void
+log_buffer_free (LogBuffer *buffer)
 {
-	time_t        now;
-	gchar         time_str[64];
-	gchar        *output;
-	struct tm    *local_time;
-	const gchar  *log_level_str;
-	static gsize  size = 0;
+	g_mutex_clear (&buffer->mutex);
+	g_string_free (buffer->data, TRUE);
+	g_slice_free (LogBuffer, buffer);
+}
 
-	g_return_if_fail (initialized == TRUE);
-	g_return_if_fail (message != NULL && message[0] != '\0');
+/* Called on thread exit, the flusher frees it once drained */
+static void
+log_buffer_orphan (gpointer data)
+{
+	LogBuffer *buffer = data;
 
-	/* Ensure file logging is thread safe */
-	g_mutex_lock (&mutex);
+	g_mutex_lock (&buffer->mutex);
+	buffer->orphaned = TRUE;
+	g_mutex_unlock (&buffer->mutex);
+}
 
-	/* Check log size, 10MiB limit */
-	if (size > (10 << 20) && fd) {
-		rewind (fd);
+static LogBuffer *
+log_buffer_get (void)
+{
+	LogBuffer *buffer;
 
-		if (ftruncate (fileno (fd), 0) != 0) {
-			/* FIXME: What should we do if this fails? */
-		}
+	buffer = g_private_get (&thread_buffer);
 
-		size = 0;
+	if (G_LIKELY (buffer)) {
+		return buffer;
 	}
 
-	now = time ((time_t *) NULL);
-	local_time = localtime (&now);
-	strftime (time_str, 64, "%d %b %Y, %H:%M:%S:", local_time);
+	buffer = g_slice_new0 (LogBuffer);
+	g_mutex_init (&buffer->mutex);
+	buffer->data = g_string_sized_new (LOG_BUFFER_WAKEUP);
+	buffer->cached_second = -1;
+
+	g_mutex_lock (&buffers_mutex);
+	g_ptr_array_add (buffers, buffer);
+	g_mutex_unlock (&buffers_mutex);
+
+	g_private_set (&thread_buffer, buffer);
+
+	return buffer;
+}
+
+static void
+log_format_time (gint64  second,
+                 gchar  *str,
+                 gsize   len)
+{
+	time_t t = (time_t) second;
+	struct tm local_time;
+
+	localtime_r (&t, &local_time);
+	strftime (str, len,
+	          log_format == LOG_FORMAT_JSON ?
+	          "%Y-%m-%dT%H:%M:%S" : "%d %b %Y, %H:%M:%S:",
+	          &local_time);
+}
+
+static const gchar *
+log_buffer_get_time (LogBuffer *buffer,
+                     gint64     now)
+{
+	gint64 second = now / G_USEC_PER_SEC;
+
+	if (second != buffer->cached_second) {
+		log_format_time (second, buffer->cached_time,
+		                 sizeof (buffer->cached_time));
+		buffer->cached_second = second;
+	}
+
+	return buffer->cached_time;
+}
+
+static const gchar *
+log_level_to_string (GLogLevelFlags log_level)
+{
+	switch (log_level & G_LOG_LEVEL_MASK) {
+	case G_LOG_LEVEL_ERROR:
+		return "error";
+	case G_LOG_LEVEL_CRITICAL:
+		return "critical";
+	case G_LOG_LEVEL_WARNING:
+		return "warning";
+	case G_LOG_LEVEL_MESSAGE:
+		return "message";
+	case G_LOG_LEVEL_INFO:
+		return "info";
+	case G_LOG_LEVEL_DEBUG:
+	default:
+		return "debug";
+	}
+}
+
+static void
+append_json_string (GString     *str,
+                    const gchar *value)
+{
+	const gchar *p;
+
+	g_string_append_c (str, '"');
+
+	for (p = value; p && *p; p++) {
+		switch (*p) {
+		case '"':
+			g_string_append (str, "\\\"");
+			break;
+		case '\\':
+			g_string_append (str, "\\\\");
+			break;
+		case '\n':
+			g_string_append (str, "\\n");
+			break;
+		case '\t':
+			g_string_append (str, "\\t");
+			break;
+		default:
+			if ((guchar) *p < 0x20) {
+				g_string_append_printf (str, "\\u%04x", (guchar) *p);
+			} else {
+				g_string_append_c (str, *p);
+			}
+			break;
+		}
+	}
+
+	g_string_append_c (str, '"');
+}
+
+static void
+log_format_text (GString        *str,
+                 const gchar    *time_str,
+                 const gchar    *domain,
+                 GLogLevelFlags  log_level,
+                 const gchar    *message)
+{
+	const gchar *log_level_str;
 
 	switch (log_level) {
 	case G_LOG_LEVEL_WARNING:
@@ -97,45 +259,259 @@ log_output (const gchar    *domain,
 		break;
 	}
 
-	output = g_strdup_printf ("%s%s %s%s: %s",
-	                          log_level_str ? "\n" : "",
-	                          time_str,
-	                          domain,
-	                          log_level_str ? log_level_str : "",
-	                          message);
+	g_string_append_printf (str, "%s%s %s%s: %s\n",
+	                        log_level_str ? "\n" : "",
+	                        time_str,
+	                        domain,
+	                        log_level_str ? log_level_str : "",
+	                        message);
+}
+
+static void
+log_format_json (LogBuffer      *buffer,
+                 gint64          now,
+                 const gchar    *domain,
+                 GLogLevelFlags  log_level,
+                 const gchar    *message)
+{
+	g_string_append_printf (buffer->data,
+	                        "{\"time\":\"%s.%06d\",\"level\":\"%s\",\"thread\":\"%p\",\"domain\":",
+	                        log_buffer_get_time (buffer, now),
+	                        (gint) (now % G_USEC_PER_SEC),
+	                        log_level_to_string (log_level),
+	                        g_thread_self ());
+	append_json_string (buffer->data, domain);
+	g_string_append (buffer->data, ",\"message\":");
+	append_json_string (buffer->data, message);
+	g_string_append (buffer->data, "}\n");
+}
+
+/* Only ever called from the flusher thread */
+static void
+log_rotate (void)
+{
+	gchar *from, *to;
+	gint i;
+
+	fclose (fd);
+
+	for (i = LOG_ROTATE_COUNT - 1; i > 0; i--) {
+		from = g_strdup_printf ("%s.%d", log_filename, i);
+		to = g_strdup_printf ("%s.%d", log_filename, i + 1);
+		g_rename (from, to);
+		g_free (from);
+		g_free (to);
+	}
+
+	to = g_strconcat (log_filename, ".1", NULL);
+	g_rename (log_filename, to);
+	g_free (to);
+
+	fd = g_fopen (log_filename, "a");
+	log_size = 0;
+}
+
+/* Must be called with write_mutex held */
+static void
+log_write (const gchar *data,
+           gsize        len,
+           gboolean     can_rotate)
+{
+	if (can_rotate && fd && log_size > 0 && log_size + len > LOG_MAX_SIZE) {
+		log_rotate ();
+	}
 
 	if (G_UNLIKELY (fd == NULL)) {
-		FILE *f;
+		fwrite (data, 1, len, stderr);
+		fflush (stderr);
+		return;
+	}
+
+	log_size += fwrite (data, 1, len, fd);
+	fflush (fd);
+}
+
+/* Moves all per-thread buffers to the log file, I/O happens
+ * with no buffer locked, so logging threads never wait on it.
+ */
+static void
+log_flush (gboolean can_rotate)
+{
+	guint i = 0;
+
+	g_mutex_lock (&write_mutex);
+	g_mutex_lock (&buffers_mutex);
 
-		if (log_level == G_LOG_LEVEL_WARNING ||
-		    log_level == G_LOG_LEVEL_CRITICAL ||
-		    log_level == G_LOG_LEVEL_ERROR) {
-			f = stderr;
+	while (i < buffers->len) {
+		LogBuffer *buffer = g_ptr_array_index (buffers, i);
+		gboolean orphaned;
+
+		g_mutex_lock (&buffer->mutex);
+		g_string_append_len (pending, buffer->data->str, buffer->data->len);
+		g_string_truncate (buffer->data, 0);
+		orphaned = buffer->orphaned;
+		g_mutex_unlock (&buffer->mutex);
+
+		if (orphaned) {
+			g_ptr_array_remove_index_fast (buffers, i);
+			log_buffer_free (buffer);
 		} else {
-			f = stdout;
+			i++;
 		}
+	}
+
+	g_mutex_unlock (&buffers_mutex);
+
+	if (pending->len > 0) {
+		log_write (pending->str, pending->len, can_rotate);
+		g_string_truncate (pending, 0);
+	}
+
+	g_mutex_unlock (&write_mutex);
+}
+
+static gpointer
+log_flusher_thread (gpointer user_data)
+{
+	g_mutex_lock (&flusher_mutex);
+
+	while (flusher_running) {
+		guint64 serial;
+
+		if (flush_completed == flush_requested) {
+			g_cond_wait_until (&flusher_cond, &flusher_mutex,
+			                   g_get_monotonic_time () + LOG_FLUSH_INTERVAL);
+		}
+
+		serial = flush_requested;
+
+		g_mutex_unlock (&flusher_mutex);
+		log_flush (TRUE);
+		g_mutex_lock (&flusher_mutex);
+
+		flush_completed = serial;
+		g_cond_broadcast (&flush_done_cond);
+	}
+
+	/* Release anyone still waiting, shutdown flushes the rest */
+	g_cond_broadcast (&flush_done_cond);
+	g_mutex_unlock (&flusher_mutex);
+
+	return NULL;
+}
+
+/* Has the flusher write out everything logged so far and waits
+ * for it, logging threads may not be allowed to rotate the file.
+ */
+static void
+log_flush_sync (void)
+{
+	guint64 serial;
 
-		g_fprintf (f, "%s\n", output);
-		fflush (f);
+	g_mutex_lock (&flusher_mutex);
+
+	serial = ++flush_requested;
+	g_cond_signal (&flusher_cond);
+
+	while (flusher_running && flush_completed < serial) {
+		g_cond_wait (&flush_done_cond, &flusher_mutex);
+	}
+
+	g_mutex_unlock (&flusher_mutex);
+}
+
+/* Used when the log file could not be opened */
+static void
+log_output_unbuffered (const gchar    *domain,
+                       GLogLevelFlags  log_level,
+                       const gchar    *message)
+{
+	gchar time_str[64];
+	FILE *f;
+
+	if (log_level == G_LOG_LEVEL_WARNING ||
+	    log_level == G_LOG_LEVEL_CRITICAL ||
+	    log_level == G_LOG_LEVEL_ERROR) {
+		f = stderr;
 	} else {
-		size += g_fprintf (fd, "%s\n", output);
-		fflush (fd);
+		f = stdout;
+	}
+
+	log_format_time (g_get_real_time () / G_USEC_PER_SEC,
+	                 time_str, sizeof (time_str));
+
+	/* No per-thread buffers here, nothing would ever flush them */
+	g_mutex_lock (&mutex);
+
+	if (!unbuffered) {
+		unbuffered = g_string_new (NULL);
 	}
 
-	g_free (output);
+	log_format_text (unbuffered, time_str, domain, log_level, message);
+	fwrite (unbuffered->str, 1, unbuffered->len, f);
+	fflush (f);
+	g_string_truncate (unbuffered, 0);
 
 	g_mutex_unlock (&mutex);
 }
 
+/* Returns %TRUE if the message went to stdout/stderr already */
+static inline gboolean
+log_output (const gchar    *domain,
+            GLogLevelFlags  log_level,
+            const gchar    *message)
+{
+	LogBuffer *buffer;
+	gint64 now;
+	gsize len;
+
+	g_return_val_if_fail (initialized == TRUE, FALSE);
+	g_return_val_if_fail (message != NULL && message[0] != '\0', FALSE);
+
+	if (G_UNLIKELY (!g_atomic_int_get (&use_buffers))) {
+		log_output_unbuffered (domain, log_level, message);
+		return TRUE;
+	}
+
+	buffer = log_buffer_get ();
+	now = g_get_real_time ();
+
+	g_mutex_lock (&buffer->mutex);
+
+	if (log_format == LOG_FORMAT_JSON) {
+		log_format_json (buffer, now, domain, log_level, message);
+	} else {
+		log_format_text (buffer->data, log_buffer_get_time (buffer, now),
+		                 domain, log_level, message);
+	}
+
+	len = buffer->data->len;
+
+	g_mutex_unlock (&buffer->mutex);
+
+	/* Errors may abort right after, so get them on disk now */
+	if ((log_level & (G_LOG_LEVEL_ERROR | G_LOG_LEVEL_CRITICAL)) != 0 ||
+	    len > LOG_BUFFER_MAX) {
+		log_flush_sync ();
+	} else if (len > LOG_BUFFER_WAKEUP) {
+		g_cond_signal (&flusher_cond);
+	}
+
+	return FALSE;
+}
+
 static void
 tracker_log_handler (const gchar    *domain,
                      GLogLevelFlags  log_level,
                      const gchar    *message,
                      gpointer        user_data)
 {
-	/* Unless enabled, we don't log to file by default */
-	if (use_log_files) {
-		log_output (domain, log_level, message);
+	/* Unless enabled, we don't log to file by default, if the
+	 * file could not be opened, the message was printed already.
+	 */
+	if (use_log_files &&
+	    log_output (domain, log_level, message)) {
+		return;
 	}
 
 	/* Now show the message through stdout/stderr as usual */
@@ -156,6 +532,7 @@ tracker_log_init (gint    this_verbosity,
                   gchar **used_filename)
 {
 	const gchar *env_use_log_files;
+	const gchar *env_log_format;
 	const gchar *env_verbosity;
 	GLogLevelFlags hide_levels = 0;
 
@@ -176,6 +553,14 @@ tracker_log_init (gint    this_verbosity,
 		use_log_files = TRUE;
 	}
 
+	/* Either "text" (default) or "json", for one JSON object per line */
+	env_log_format = g_getenv ("TRACKER_LOG_FORMAT");
+	if (g_strcmp0 (env_log_format, "json") == 0) {
+		log_format = LOG_FORMAT_JSON;
+	} else {
+		log_format = LOG_FORMAT_TEXT;
+	}
+
 	env_verbosity = g_getenv ("TRACKER_VERBOSITY");
 	if (env_verbosity != NULL) {
 		this_verbosity = atoi (env_verbosity);
@@ -221,13 +606,15 @@ tracker_log_init (gint    this_verbosity,
 			           "All logging will go to stderr\n");
 
 			use_log_files = TRUE;
+		} else if (fseek (fd, 0, SEEK_END) == 0) {
+			log_size = ftell (fd);
 		}
 
 		if (used_filename) {
-			*used_filename = filename;
-		} else {
-			g_free (filename);
+			*used_filename = g_strdup (filename);
 		}
+
+		log_filename = filename;
 	} else {
 		*used_filename = NULL;
 	}
@@ -236,6 +623,18 @@ tracker_log_init (gint    this_verbosity,
 
 	g_mutex_init (&mutex);
 
+	if (!buffers) {
+		buffers = g_ptr_array_new ();
+	}
+
+	pending = g_string_sized_new (LOG_BUFFER_WAKEUP);
+
+	if (use_log_files && fd) {
+		g_atomic_int_set (&use_buffers, TRUE);
+		flusher_running = TRUE;
+		flusher = g_thread_new ("tracker-log", log_flusher_thread, NULL);
+	}
+
 	switch (this_verbosity) {
 		/* Log level 3: EVERYTHING */
 	case 3:
@@ -297,9 +696,42 @@ tracker_log_shutdown (void)
 		log_handler_id = 0;
 	}
 
+	/* Threads still logging go straight to stdout/stderr now */
+	g_atomic_int_set (&use_buffers, FALSE);
+
+	if (flusher) {
+		g_mutex_lock (&flusher_mutex);
+		flusher_running = FALSE;
+		g_cond_signal (&flusher_cond);
+		g_mutex_unlock (&flusher_mutex);
+
+		g_thread_join (flusher);
+		flusher = NULL;
+	}
+
+	log_flush (FALSE);
+
+	g_mutex_lock (&write_mutex);
+
+	g_string_free (pending, TRUE);
+	pending = NULL;
+
 	if (use_log_files && fd != NULL) {
 		fclose (fd);
+		fd = NULL;
+	}
+
+	g_mutex_unlock (&write_mutex);
+
+	g_clear_pointer (&log_filename, g_free);
+	log_size = 0;
+
+	g_mutex_lock (&mutex);
+	if (unbuffered) {
+		g_string_free (unbuffered, TRUE);
+		unbuffered = NULL;
 	}
+	g_mutex_unlock (&mutex);
 
 	g_mutex_clear (&mutex);
 
@@ -68,10 +68,8 @@ typedef struct {
 	GSList *ignored_files;
 
 	/* Convenience data */
-	GSList *ignored_directory_patterns;
-	GSList *ignored_directory_paths;
-	GSList *ignored_file_patterns;
-	GSList *ignored_file_paths;
+	TrackerFileMatcher *ignored_directory_matcher;
+	TrackerFileMatcher *ignored_file_matcher;
 } TrackerConfigPrivate;
 
 static void config_set_property                         (GObject           *object,
@@ -480,25 +478,8 @@ config_finalize (GObject *object)
 
 	priv = TRACKER_CONFIG (object)->priv;
 
-	g_slist_foreach (priv->ignored_file_patterns,
-	                 (GFunc) g_pattern_spec_free,
-	                 NULL);
-	g_slist_free (priv->ignored_file_patterns);
-
-	g_slist_foreach (priv->ignored_file_paths,
-	                 (GFunc) g_free,
-	                 NULL);
-	g_slist_free (priv->ignored_file_paths);
-
-	g_slist_foreach (priv->ignored_directory_patterns,
-	                 (GFunc) g_pattern_spec_free,
-	                 NULL);
-	g_slist_free (priv->ignored_directory_patterns);
-
-	g_slist_foreach (priv->ignored_directory_paths,
-	                 (GFunc) g_free,
-	                 NULL);
-	g_slist_free (priv->ignored_directory_paths);
+	tracker_file_matcher_free (priv->ignored_file_matcher);
+	tracker_file_matcher_free (priv->ignored_directory_matcher);
 
 	g_slist_foreach (priv->ignored_files, (GFunc) g_free, NULL);
 	g_slist_free (priv->ignored_files);
@@ -557,82 +538,22 @@ static void
 config_set_ignored_file_conveniences (TrackerConfig *config)
 {
 	TrackerConfigPrivate *priv;
-	GSList *l;
-	GSList *paths = NULL;
-	GSList *patterns = NULL;
 
 	priv = config->priv;
 
-	g_slist_foreach (priv->ignored_file_patterns,
-	                 (GFunc) g_pattern_spec_free,
-	                 NULL);
-	g_slist_free (priv->ignored_file_patterns);
-
-	g_slist_foreach (priv->ignored_file_paths,
-	                 (GFunc) g_free,
-	                 NULL);
-	g_slist_free (priv->ignored_file_paths);
-
-	for (l = priv->ignored_files; l; l = l->next) {
-		const gchar *str = l->data;
-
-		if (!str) {
-			continue;
-		}
-
-		if (G_LIKELY (*str != G_DIR_SEPARATOR)) {
-			GPatternSpec *spec;
-
-			spec = g_pattern_spec_new (l->data);
-			patterns = g_slist_prepend (patterns, spec);
-		} else {
-			paths = g_slist_prepend (paths, g_strdup (l->data));
-		}
-	}
-
-	priv->ignored_file_patterns = g_slist_reverse (patterns);
-	priv->ignored_file_paths = g_slist_reverse (paths);
+	tracker_file_matcher_free (priv->ignored_file_matcher);
+	priv->ignored_file_matcher = tracker_file_matcher_new (priv->ignored_files);
 }
 
 static void
 config_set_ignored_directory_conveniences (TrackerConfig *config)
 {
 	TrackerConfigPrivate *priv;
-	GSList *l;
-	GSList *patterns = NULL;
-	GSList *paths = NULL;
 
 	priv = config->priv;
 
-	g_slist_foreach (priv->ignored_directory_patterns,
-	                 (GFunc) g_pattern_spec_free,
-	                 NULL);
-	g_slist_free (priv->ignored_directory_patterns);
-
-	g_slist_foreach (priv->ignored_directory_paths,
-	                 (GFunc) g_free,
-	                 NULL);
-	g_slist_free (priv->ignored_directory_paths);
-
-	for (l = priv->ignored_directories; l; l = l->next) {
-		const gchar *str = l->data;
-
-		if (!str) {
-			continue;
-		}
-
-		if (G_LIKELY (*str != G_DIR_SEPARATOR)) {
-			GPatternSpec *spec;
-
-			spec = g_pattern_spec_new (l->data);
-			patterns = g_slist_prepend (patterns, spec);
-		} else {
-			paths = g_slist_prepend (paths, g_strdup (l->data));
-		}
-	}
-
-	priv->ignored_directory_patterns = g_slist_reverse (patterns);
-	priv->ignored_directory_paths = g_slist_reverse (paths);
+	tracker_file_matcher_free (priv->ignored_directory_matcher);
+	priv->ignored_directory_matcher = tracker_file_matcher_new (priv->ignored_directories);
 }
 
 static void
@@ -1190,20 +1111,8 @@ config_set_ignored_files (TrackerConfig *config,
  * Convenience functions
  */
 
-GSList *
-tracker_config_get_ignored_directory_patterns (TrackerConfig *config)
-{
-	TrackerConfigPrivate *priv;
-
-	g_return_val_if_fail (TRACKER_IS_CONFIG (config), NULL);
-
-	priv = config->priv;
-
-	return priv->ignored_directory_patterns;
-}
-
-GSList *
-tracker_config_get_ignored_file_patterns (TrackerConfig *config)
+TrackerFileMatcher *
+tracker_config_get_ignored_directory_matcher (TrackerConfig *config)
 {
 	TrackerConfigPrivate *priv;
 
@@ -1211,23 +1120,11 @@ tracker_config_get_ignored_file_patterns (TrackerConfig *config)
 
 	priv = config->priv;
 
-	return priv->ignored_file_patterns;
+	return priv->ignored_directory_matcher;
 }
 
-GSList *
-tracker_config_get_ignored_directory_paths (TrackerConfig *config)
-{
-	TrackerConfigPrivate *priv;
-
-	g_return_val_if_fail (TRACKER_IS_CONFIG (config), NULL);
-
-	priv = config->priv;
-
-	return priv->ignored_directory_paths;
-}
-
-GSList *
-tracker_config_get_ignored_file_paths (TrackerConfig *config)
+TrackerFileMatcher *
+tracker_config_get_ignored_file_matcher (TrackerConfig *config)
 {
 	TrackerConfigPrivate *priv;
 
@@ -1235,5 +1132,5 @@ tracker_config_get_ignored_file_paths (TrackerConfig *config)
 
 	priv = config->priv;
 
-	return priv->ignored_file_paths;
+	return priv->ignored_file_matcher;
 }
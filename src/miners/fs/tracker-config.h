@@ -22,6 +22,8 @@
 
 #include <glib-object.h>
 
+#include <libtracker-miners-common/tracker-common.h>
+
 G_BEGIN_DECLS
 
 #define TRACKER_TYPE_CONFIG         (tracker_config_get_type ())
@@ -76,15 +78,11 @@ void           tracker_config_set_initial_sleep                    (TrackerConfi
  * Convenience functions:
  */
 
-/* The _patterns() APIs return GPatternSpec pointers for basename
- * pattern matching.
+/* The _matcher() APIs return the ignored-directories and ignored-files
+ * settings compiled for full path and basename pattern matching.
  */
-GSList *       tracker_config_get_ignored_directory_patterns        (TrackerConfig *config);
-GSList *       tracker_config_get_ignored_file_patterns             (TrackerConfig *config);
-
-/* The _paths() APIs return string pointers for full paths matching */
-GSList *       tracker_config_get_ignored_directory_paths           (TrackerConfig *config);
-GSList *       tracker_config_get_ignored_file_paths                (TrackerConfig *config);
+TrackerFileMatcher * tracker_config_get_ignored_directory_matcher (TrackerConfig *config);
+TrackerFileMatcher * tracker_config_get_ignored_file_matcher      (TrackerConfig *config);
 
 G_END_DECLS
 
@@ -438,11 +438,10 @@ check_eligible (void)
 	if (print_dir_check) {
 		gboolean check;
 
-		check = tracker_miner_files_check_directory (file,
+		check = tracker_miner_files_check_directory (file, NULL, NULL,
 		                                             tracker_config_get_index_recursive_directories (config),
 			                                     tracker_config_get_index_single_directories (config),
-			                                     tracker_config_get_ignored_directory_paths (config),
-			                                     tracker_config_get_ignored_directory_patterns (config));
+			                                     tracker_config_get_ignored_directory_matcher (config));
 		g_print ("  %s\n",
 		         check ?
 		         _("Directory is eligible to be mined (based on rules)") :
@@ -534,9 +533,8 @@ check_eligible (void)
 	if (print_file_check) {
 		gboolean check;
 
-		check = tracker_miner_files_check_file (file,
-		                                        tracker_config_get_ignored_file_paths (config),
-		                                        tracker_config_get_ignored_file_patterns (config));
+		check = tracker_miner_files_check_file (file, NULL,
+		                                        tracker_config_get_ignored_file_matcher (config));
 
 		g_print ("  %s\n",
 		         check ?
@@ -39,6 +39,8 @@ static const gchar introspection_xml[] =
   "    <method name='IndexFileForProcess'>"
   "      <arg type='s' name='file_uri' direction='in' />"
   "    </method>"
+  "    <property name='InFlight' type='u' access='read' />"
+  "    <property name='PeakInFlight' type='u' access='read' />"
   "  </interface>"
   "</node>";
 
@@ -481,6 +483,17 @@ handle_get_property (GDBusConnection  *connection,
                      GError          **error,
                      gpointer          user_data)
 {
+	TrackerMinerFilesIndexPrivate *priv;
+
+	priv = TRACKER_MINER_FILES_INDEX_GET_PRIVATE (user_data);
+
+	/* Number of files being processed, to help tuning concurrency */
+	if (g_strcmp0 (property_name, "InFlight") == 0) {
+		return g_variant_new_uint32 (tracker_miner_files_get_n_in_flight (priv->files_miner));
+	} else if (g_strcmp0 (property_name, "PeakInFlight") == 0) {
+		return g_variant_new_uint32 (tracker_miner_files_get_peak_in_flight (priv->files_miner));
+	}
+
 	g_assert_not_reached ();
 	return NULL;
 }
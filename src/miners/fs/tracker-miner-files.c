@@ -21,6 +21,8 @@
 
 #include <sys/statvfs.h>
 #include <fcntl.h>
+#include <string.h>
+#include <time.h>
 #ifdef __linux__
 #include <sys/ioctl.h>
 #include <linux/msdos_fs.h>
@@ -66,6 +68,7 @@ struct ProcessFileData {
 	GFile *file;
 	gchar *mime_type;
 	GTask *task;
+	GList link;
 };
 
 struct TrackerMinerFilesPrivate {
@@ -103,12 +106,22 @@ struct TrackerMinerFilesPrivate {
 
 	guint stale_volumes_check_id;
 
-	GList *extraction_queue;
+	/* Files being processed, linked through ProcessFileData */
+	GQueue extraction_queue;
+	guint extraction_queue_peak;
 
 	TrackerThumbnailer *thumbnailer;
 
 	GHashTable *writeback_tasks;
 	gboolean paused_for_writeback;
+
+	GString *sparql_buffer;
+
+	/* Datasource of the last parent directory processed,
+	 * shared by all its non-directory children.
+	 */
+	GFile *datasource_dir;
+	gchar *datasource_urn;
 };
 
 typedef struct {
@@ -228,6 +241,7 @@ static void        miner_files_add_removable_or_optical_directory (TrackerMinerF
                                                                    const gchar       *uuid);
 
 static void        miner_files_update_filters                     (TrackerMinerFiles *files);
+static void        miner_files_clear_datasource_cache             (TrackerMinerFiles *mf);
 
 
 static GInitableIface* miner_files_initable_parent_iface;
@@ -319,6 +333,123 @@ miner_files_filter_event (TrackerMinerFS          *fs,
 	return FALSE;
 }
 
+/* Per-file updates are rendered from fixed templates, compiled once,
+ * with the values for each file bound to their ~parameters. This saves
+ * building the same statements over again for every file.
+ */
+typedef enum {
+	FILE_PARAM_URN,
+	FILE_PARAM_TYPES,
+	FILE_PARAM_PARENT,
+	FILE_PARAM_NAME,
+	FILE_PARAM_SIZE,
+	FILE_PARAM_MTIME,
+	FILE_PARAM_ATIME,
+	FILE_PARAM_URL,
+	FILE_PARAM_MIME_TYPE,
+	FILE_PARAM_DATASOURCE,
+	N_FILE_PARAMS
+} FileParam;
+
+static const gchar *file_param_names[N_FILE_PARAMS] = {
+	"urn", "types", "parent", "name", "size",
+	"mtime", "atime", "url", "mime", "datasource"
+};
+
+typedef struct {
+	const gchar *literal;
+	gsize literal_len;
+	gint param;
+} TemplateSegment;
+
+/* Deletes all statements inserted by the miner for an already
+ * known file, except:
+ *  - rdf:type statements as they could cause implicit deletion of user data
+ *  - nie:contentCreated so it persists across updates
+ *
+ * Additionally, deletes also nie:url as it might have been set by 3rd
+ * parties, and it's used to know whether a file is known to tracker or not.
+ */
+static const gchar file_delete_template[] =
+	"DELETE {"
+	"  GRAPH <" TRACKER_OWN_GRAPH_URN "> {"
+	"    ~urn ?p ?o"
+	"  } "
+	"} "
+	"WHERE {"
+	"  GRAPH <" TRACKER_OWN_GRAPH_URN "> {"
+	"    ~urn ?p ?o"
+	"    FILTER (?p != rdf:type && ?p != nie:contentCreated)"
+	"  } "
+	"} "
+	"DELETE {"
+	"  ~urn nie:url ?o"
+	"} WHERE {"
+	"  ~urn nie:url ?o"
+	"} ";
+
+static const gchar file_insert_template[] =
+	"INSERT SILENT { GRAPH <" TRACKER_OWN_GRAPH_URN "> {"
+	"  ~urn a nfo:FileDataObject, nie:InformationElement~types ;"
+	"~parent"
+	"    nfo:fileName ~name ;"
+	"    nfo:fileSize ~size ;"
+	"    nfo:fileLastModified ~mtime ;"
+	"    nfo:fileLastAccessed ~atime ;"
+	"    nie:isStoredAs ~urn ;"
+	"    nie:url ~url ;"
+	"    nie:mimeType ~mime ;"
+	"    nie:dataSource ~datasource ;"
+	"    tracker:available true ."
+	"} } ";
+
+static GArray *file_delete_segments = NULL;
+static GArray *file_insert_segments = NULL;
+
+static GArray *
+sparql_template_compile (const gchar *template)
+{
+	const gchar *p = template, *start = template;
+	GArray *segments;
+
+	segments = g_array_new (FALSE, FALSE, sizeof (TemplateSegment));
+
+	while ((p = strchr (p, '~')) != NULL) {
+		TemplateSegment segment;
+		gsize name_len;
+		gint i;
+
+		name_len = strspn (p + 1, "abcdefghijklmnopqrstuvwxyz");
+
+		for (i = 0; i < N_FILE_PARAMS; i++) {
+			if (strlen (file_param_names[i]) == name_len &&
+			    strncmp (p + 1, file_param_names[i], name_len) == 0)
+				break;
+		}
+
+		g_assert (i < N_FILE_PARAMS);
+
+		segment.literal = start;
+		segment.literal_len = p - start;
+		segment.param = i;
+		g_array_append_val (segments, segment);
+
+		p += name_len + 1;
+		start = p;
+	}
+
+	if (*start) {
+		TemplateSegment segment;
+
+		segment.literal = start;
+		segment.literal_len = strlen (start);
+		segment.param = -1;
+		g_array_append_val (segments, segment);
+	}
+
+	return segments;
+}
+
 static void
 tracker_miner_files_class_init (TrackerMinerFilesClass *klass)
 {
@@ -329,6 +460,9 @@ tracker_miner_files_class_init (TrackerMinerFilesClass *klass)
 	object_class->get_property = miner_files_get_property;
 	object_class->set_property = miner_files_set_property;
 
+	file_delete_segments = sparql_template_compile (file_delete_template);
+	file_insert_segments = sparql_template_compile (file_insert_template);
+
 	miner_fs_class->process_file = miner_files_process_file;
 	miner_fs_class->process_file_attributes = miner_files_process_file_attributes;
 	miner_fs_class->finished = miner_files_finished;
@@ -431,6 +565,8 @@ tracker_miner_files_init (TrackerMinerFiles *mf)
 	priv->writeback_tasks = g_hash_table_new_full (g_file_hash,
 	                                               (GEqualFunc) g_file_equal,
 	                                               NULL, cancel_and_unref);
+
+	priv->sparql_buffer = g_string_sized_new (2048);
 }
 
 static void
@@ -817,8 +953,10 @@ miner_files_finalize (GObject *object)
 		g_object_unref (priv->thumbnailer);
 	}
 
-	g_list_free (priv->extraction_queue);
 	g_hash_table_destroy (priv->writeback_tasks);
+	g_string_free (priv->sparql_buffer, TRUE);
+	g_clear_object (&priv->datasource_dir);
+	g_free (priv->datasource_urn);
 
 	G_OBJECT_CLASS (tracker_miner_files_parent_class)->finalize (object);
 }
@@ -1322,6 +1460,8 @@ mount_point_removed_cb (TrackerStorage *storage,
 	gchar *urn;
 	GFile *mount_point_file;
 
+	miner_files_clear_datasource_cache (miner);
+
 	urn = g_strdup_printf (TRACKER_PREFIX_DATASOURCE_URN "%s", uuid);
 	g_debug ("Mount point removed for URN '%s'", urn);
 
@@ -1355,6 +1495,8 @@ mount_point_added_cb (TrackerStorage *storage,
 
 	priv = TRACKER_MINER_FILES_GET_PRIVATE (miner);
 
+	miner_files_clear_datasource_cache (miner);
+
 	urn = g_strdup_printf (TRACKER_PREFIX_DATASOURCE_URN "%s", uuid);
 	g_message ("Mount point added for URN '%s'", urn);
 
@@ -2093,79 +2235,163 @@ miner_files_get_file_urn (TrackerMinerFiles *miner,
 }
 
 static void
-miner_files_add_to_datasource (TrackerMinerFiles    *mf,
-                               GFile                *file,
-                               TrackerSparqlBuilder *sparql)
+sparql_template_render (GArray       *segments,
+                        GString      *str,
+                        const gchar **values)
+{
+	guint i;
+
+	for (i = 0; i < segments->len; i++) {
+		TemplateSegment *segment;
+
+		segment = &g_array_index (segments, TemplateSegment, i);
+		g_string_append_len (str, segment->literal, segment->literal_len);
+
+		if (segment->param >= 0)
+			g_string_append (str, values[segment->param]);
+	}
+}
+
+/* Returns a quoted and escaped SPARQL string literal, only
+ * files with odd names need the escaping pass. */
+static gchar *
+sparql_string_literal (const gchar *str)
+{
+	gchar *escaped, *literal;
+
+	if (!strpbrk (str, "\"\\\t\n\r\b\f"))
+		return g_strconcat ("\"", str, "\"", NULL);
+
+	escaped = tracker_sparql_escape_string (str);
+	literal = g_strconcat ("\"", escaped, "\"", NULL);
+	g_free (escaped);
+
+	return literal;
+}
+
+static gchar *
+sparql_date_literal (guint64 time_)
+{
+	time_t t = (time_t) time_;
+	struct tm tm;
+
+	gmtime_r (&t, &tm);
+
+	return g_strdup_printf ("\"%04d-%02d-%02dT%02d:%02d:%02dZ\"",
+	                        tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+	                        tm.tm_hour, tm.tm_min, tm.tm_sec);
+}
+
+static gchar *
+miner_files_lookup_datasource_urn (TrackerMinerFiles *mf,
+                                   GFile             *file)
 {
 	TrackerMinerFilesPrivate *priv;
 	const gchar *removable_device_uuid;
-	gchar *removable_device_urn, *uri;
-	const gchar *urn;
-	gboolean is_iri;
 
 	priv = TRACKER_MINER_FILES_GET_PRIVATE (mf);
-	uri = g_file_get_uri (file);
-
 	removable_device_uuid = tracker_storage_get_uuid_for_file (priv->storage, file);
 
 	if (removable_device_uuid) {
-		removable_device_urn = g_strdup_printf (TRACKER_PREFIX_DATASOURCE_URN "%s",
-		                                        removable_device_uuid);
+		return g_strdup_printf ("<" TRACKER_PREFIX_DATASOURCE_URN "%s>",
+		                        removable_device_uuid);
 	} else {
-		removable_device_urn = g_strdup (TRACKER_DATASOURCE_URN_NON_REMOVABLE_MEDIA);
+		return g_strdup ("<" TRACKER_DATASOURCE_URN_NON_REMOVABLE_MEDIA ">");
 	}
+}
+
+static void
+miner_files_clear_datasource_cache (TrackerMinerFiles *mf)
+{
+	TrackerMinerFilesPrivate *priv;
 
-	urn = miner_files_get_file_urn (mf, file, &is_iri);
+	priv = TRACKER_MINER_FILES_GET_PRIVATE (mf);
 
-	if (is_iri) {
-		tracker_sparql_builder_subject_iri (sparql, urn);
-	} else {
-		tracker_sparql_builder_subject (sparql, urn);
-	}
+	g_clear_object (&priv->datasource_dir);
+	g_clear_pointer (&priv->datasource_urn, g_free);
+}
 
-	tracker_sparql_builder_predicate (sparql, "a");
-	tracker_sparql_builder_object (sparql, "nfo:FileDataObject");
+/* Siblings are usually processed together, so the datasource of
+ * the last parent directory is remembered. Directories are always
+ * looked up, as they might be mount points themselves.
+ */
+static gchar *
+miner_files_get_datasource_urn (TrackerMinerFiles *mf,
+                                GFile             *file,
+                                GFile             *parent,
+                                gboolean           is_directory)
+{
+	TrackerMinerFilesPrivate *priv;
 
-	tracker_sparql_builder_predicate (sparql, "nie:dataSource");
-	tracker_sparql_builder_object_iri (sparql, removable_device_urn);
+	priv = TRACKER_MINER_FILES_GET_PRIVATE (mf);
 
-	tracker_sparql_builder_predicate (sparql, "tracker:available");
-	tracker_sparql_builder_object_boolean (sparql, TRUE);
+	if (is_directory || !parent) {
+		return miner_files_lookup_datasource_urn (mf, file);
+	}
 
-	g_free (removable_device_urn);
-	g_free (uri);
+	if (!priv->datasource_dir ||
+	    !g_file_equal (priv->datasource_dir, parent)) {
+		miner_files_clear_datasource_cache (mf);
+		priv->datasource_dir = g_object_ref (parent);
+		priv->datasource_urn = miner_files_lookup_datasource_urn (mf, parent);
+	}
+
+	return g_strdup (priv->datasource_urn);
 }
 
 static void
-miner_files_add_rdf_types (TrackerSparqlBuilder *sparql,
-                           GFile                *file,
-                           const gchar          *mime_type)
+miner_files_add_rdf_types (GString     *types,
+                           const gchar *mime_type)
 {
-	GStrv rdf_types;
+	const gchar * const *rdf_types;
 	gint i = 0;
 
-	rdf_types = tracker_extract_module_manager_get_fallback_rdf_types (mime_type);
+	rdf_types = tracker_extract_module_manager_peek_fallback_rdf_types (mime_type);
 
 	if (!rdf_types)
 		return;
 
-	if (rdf_types[0]) {
-		tracker_sparql_builder_predicate (sparql, "a");
-
-		while (rdf_types[i]) {
-			tracker_sparql_builder_object (sparql, rdf_types[i]);
-			i++;
-		}
+	while (rdf_types[i]) {
+		g_string_append (types, ", ");
+		g_string_append (types, rdf_types[i]);
+		i++;
 	}
+}
 
-	g_strfreev (rdf_types);
+static ProcessFileData *
+process_file_data_new (TrackerMinerFS *fs,
+                       GFile          *file,
+                       GTask          *task)
+{
+	TrackerMinerFilesPrivate *priv;
+	ProcessFileData *data;
+
+	data = g_slice_new0 (ProcessFileData);
+	data->miner = g_object_ref (fs);
+	data->cancellable = g_object_ref (g_task_get_cancellable (task));
+	data->file = g_object_ref (file);
+	data->task = g_object_ref (task);
+
+	/* The list link is embedded, so that removal is O(1) */
+	priv = TRACKER_MINER_FILES (fs)->private;
+	data->link.data = data;
+	g_queue_push_head_link (&priv->extraction_queue, &data->link);
+	priv->extraction_queue_peak = MAX (priv->extraction_queue_peak,
+	                                   priv->extraction_queue.length);
+
+	return data;
 }
 
 static void
 process_file_data_free (ProcessFileData *data)
 {
+	TrackerMinerFilesPrivate *priv;
+
+	priv = TRACKER_MINER_FILES (data->miner)->private;
+	g_queue_unlink (&priv->extraction_queue, &data->link);
+
 	g_object_unref (data->miner);
-	g_object_unref (data->sparql);
+	g_clear_object (&data->sparql);
 	g_object_unref (data->cancellable);
 	g_object_unref (data->file);
 	g_object_unref (data->task);
@@ -2174,65 +2400,22 @@ process_file_data_free (ProcessFileData *data)
 }
 
 static void
-sparql_builder_finish (ProcessFileData *data,
-                       const gchar     *preupdate,
-                       const gchar     *postupdate,
-                       const gchar     *sparql,
-                       const gchar     *where)
+append_mount_point_queries (ProcessFileData *data,
+                            GString         *str)
 {
 	const gchar *uuid;
 
-	if (sparql && *sparql) {
-		gboolean is_iri;
-		const gchar *urn;
-
-		urn = miner_files_get_file_urn (data->miner, data->file, &is_iri);
-
-		if (is_iri) {
-			gchar *str;
-
-			str = g_strdup_printf ("<%s>", urn);
-			tracker_sparql_builder_append (data->sparql, str);
-			g_free (str);
-		} else {
-			tracker_sparql_builder_append (data->sparql, urn);
-		}
-
-		tracker_sparql_builder_append (data->sparql, sparql);
-	}
-
-	tracker_sparql_builder_graph_close (data->sparql);
-	tracker_sparql_builder_insert_close (data->sparql);
-
-	if (where && *where) {
-		tracker_sparql_builder_where_open (data->sparql);
-		tracker_sparql_builder_append (data->sparql, where);
-		tracker_sparql_builder_where_close (data->sparql);
-	}
-
-	/* Prepend preupdate queries */
-	if (preupdate && *preupdate) {
-		tracker_sparql_builder_prepend (data->sparql, preupdate);
-	}
-
-	/* Append postupdate */
-	if (postupdate && *postupdate) {
-		tracker_sparql_builder_append (data->sparql, postupdate);
-	}
-
 	uuid = g_object_get_qdata (G_OBJECT (data->file),
 	                           data->miner->private->quark_mount_point_uuid);
 
 	/* File represents a mount point */
 	if (G_UNLIKELY (uuid)) {
-		GString *queries;
 		gchar *removable_device_urn, *uri;
 
 		removable_device_urn = g_strdup_printf (TRACKER_PREFIX_DATASOURCE_URN "%s", uuid);
 		uri = g_file_get_uri (G_FILE (data->file));
-		queries = g_string_new ("");
 
-		g_string_append_printf (queries,
+		g_string_append_printf (str,
 		                        "DELETE { "
 		                        "  <%s> tracker:mountPoint ?unknown "
 		                        "} WHERE { "
@@ -2241,7 +2424,7 @@ sparql_builder_finish (ProcessFileData *data,
 		                        "} ",
 		                        removable_device_urn, removable_device_urn);
 
-		g_string_append_printf (queries,
+		g_string_append_printf (str,
 		                        "INSERT { GRAPH <%s> {"
 		                        "  <%s> a tracker:Volume; "
 		                        "       tracker:mountPoint ?u "
@@ -2251,8 +2434,6 @@ sparql_builder_finish (ProcessFileData *data,
 		                        "} ",
 		                        removable_device_urn, removable_device_urn, uri);
 
-		tracker_sparql_builder_append (data->sparql, queries->str);
-		g_string_free (queries, TRUE);
 		g_free (removable_device_urn);
 		g_free (uri);
 	}
@@ -2264,11 +2445,13 @@ process_file_cb (GObject      *object,
                  gpointer      user_data)
 {
 	TrackerMinerFilesPrivate *priv;
-	TrackerSparqlBuilder *sparql;
 	ProcessFileData *data;
 	const gchar *mime_type, *urn, *parent_urn;
+	const gchar *values[N_FILE_PARAMS];
+	gchar *name, *size, *mtime, *atime, *url, *mime, *datasource;
+	gchar *urn_value, *parent_value = NULL;
 	GFileInfo *file_info;
-	guint64 time_;
+	GString *types;
 	GFile *file, *parent;
 	gchar *uri;
 	GError *error = NULL;
@@ -2277,14 +2460,12 @@ process_file_cb (GObject      *object,
 
 	data = user_data;
 	file = G_FILE (object);
-	sparql = data->sparql;
 	file_info = g_file_query_info_finish (file, result, &error);
 	priv = TRACKER_MINER_FILES (data->miner)->private;
 
 	if (error) {
 		/* Something bad happened, notify about the error */
 		tracker_miner_fs_notify_finish (TRACKER_MINER_FS (data->miner), data->task, NULL, error);
-		priv->extraction_queue = g_list_remove (priv->extraction_queue, data);
 		process_file_data_free (data);
 		return;
 	}
@@ -2295,111 +2476,72 @@ process_file_cb (GObject      *object,
 
 	data->mime_type = g_strdup (mime_type);
 
-	if (is_iri) {
-		gchar *delete_properties_sparql;
-
-		/* Update: delete all statements inserted by miner except:
-		 *  - rdf:type statements as they could cause implicit deletion of user data
-		 *  - nie:contentCreated so it persists across updates
-		 *
-		 * Additionally, delete also nie:url as it might have been set by 3rd parties,
-		 * and it's used to know whether a file is known to tracker or not.
-		 */
-		delete_properties_sparql =
-			g_strdup_printf ("DELETE {"
-			                 "  GRAPH <%s> {"
-			                 "    <%s> ?p ?o"
-			                 "  } "
-			                 "} "
-			                 "WHERE {"
-			                 "  GRAPH <%s> {"
-			                 "    <%s> ?p ?o"
-			                 "    FILTER (?p != rdf:type && ?p != nie:contentCreated)"
-			                 "  } "
-			                 "} "
-			                 "DELETE {"
-			                 "  <%s> nie:url ?o"
-			                 "} WHERE {"
-			                 "  <%s> nie:url ?o"
-			                 "}",
-			                 TRACKER_OWN_GRAPH_URN, urn,
-			                 TRACKER_OWN_GRAPH_URN, urn,
-			                 urn, urn);
-
-		tracker_sparql_builder_prepend (sparql, delete_properties_sparql);
-		g_free (delete_properties_sparql);
-	}
-
-	tracker_sparql_builder_insert_silent_open (sparql, NULL);
-	tracker_sparql_builder_graph_open (sparql, TRACKER_OWN_GRAPH_URN);
-
-	if (is_iri) {
-		tracker_sparql_builder_subject_iri (sparql, urn);
-	} else {
-		tracker_sparql_builder_subject (sparql, urn);
-	}
-
-	tracker_sparql_builder_predicate (sparql, "a");
-	tracker_sparql_builder_object (sparql, "nfo:FileDataObject");
-	tracker_sparql_builder_object (sparql, "nie:InformationElement");
+	urn_value = is_iri ? g_strconcat ("<", urn, ">", NULL) : g_strdup (urn);
 
+	types = g_string_new (NULL);
 	is_directory = (g_file_info_get_file_type (file_info) == G_FILE_TYPE_DIRECTORY ?
 	                TRUE : FALSE);
 	if (is_directory) {
-		tracker_sparql_builder_object (sparql, "nfo:Folder");
+		g_string_append (types, ", nfo:Folder");
 	}
 
+	if (g_file_info_get_size (file_info) > 0)
+		miner_files_add_rdf_types (types, mime_type);
+
 	parent = g_file_get_parent (file);
 	parent_urn = tracker_miner_fs_query_urn (TRACKER_MINER_FS (data->miner), parent);
+	datasource = miner_files_get_datasource_urn (data->miner, file, parent, is_directory);
 	g_object_unref (parent);
 
 	if (parent_urn) {
-		tracker_sparql_builder_predicate (sparql, "nfo:belongsToContainer");
-		tracker_sparql_builder_object_iri (sparql, parent_urn);
-	}
-
-	tracker_sparql_builder_predicate (sparql, "nfo:fileName");
-	tracker_sparql_builder_object_string (sparql, g_file_info_get_display_name (file_info));
-
-	tracker_sparql_builder_predicate (sparql, "nfo:fileSize");
-	tracker_sparql_builder_object_int64 (sparql, g_file_info_get_size (file_info));
+		parent_value = g_strconcat ("    nfo:belongsToContainer <", parent_urn, "> ;", NULL);
+	}
+
+	name = sparql_string_literal (g_file_info_get_display_name (file_info));
+	size = g_strdup_printf ("%" G_GINT64_FORMAT, g_file_info_get_size (file_info));
+	mtime = sparql_date_literal (g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED));
+	atime = sparql_date_literal (g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_ACCESS));
+	url = sparql_string_literal (uri);
+	mime = sparql_string_literal (mime_type);
+
+	values[FILE_PARAM_URN] = urn_value;
+	values[FILE_PARAM_TYPES] = types->str;
+	values[FILE_PARAM_PARENT] = parent_value ? parent_value : "";
+	values[FILE_PARAM_NAME] = name;
+	values[FILE_PARAM_SIZE] = size;
+	values[FILE_PARAM_MTIME] = mtime;
+	values[FILE_PARAM_ATIME] = atime;
+	values[FILE_PARAM_URL] = url;
+	values[FILE_PARAM_MIME_TYPE] = mime;
+	values[FILE_PARAM_DATASOURCE] = datasource;
+
+	/* The buffer is reused across files, tracker_miner_fs_notify_finish()
+	 * takes its own copy of the update. */
+	g_string_truncate (priv->sparql_buffer, 0);
 
-	time_ = g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
-	tracker_sparql_builder_predicate (sparql, "nfo:fileLastModified");
-	tracker_sparql_builder_object_date (sparql, (time_t *) &time_);
-
-	time_ = g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_ACCESS);
-	tracker_sparql_builder_predicate (sparql, "nfo:fileLastAccessed");
-	tracker_sparql_builder_object_date (sparql, (time_t *) &time_);
-
-	/* Laying the link between the IE and the DO. We use IE = DO */
-	tracker_sparql_builder_predicate (sparql, "nie:isStoredAs");
 	if (is_iri) {
-		tracker_sparql_builder_object_iri (sparql, urn);
-	} else {
-		tracker_sparql_builder_object (sparql, urn);
+		sparql_template_render (file_delete_segments, priv->sparql_buffer, values);
 	}
 
-	/* The URL of the DataObject (because IE = DO, this is correct) */
-	tracker_sparql_builder_predicate (sparql, "nie:url");
-	tracker_sparql_builder_object_string (sparql, uri);
-
-	tracker_sparql_builder_predicate (sparql, "nie:mimeType");
-	tracker_sparql_builder_object_string (sparql, mime_type);
-
-	miner_files_add_to_datasource (data->miner, file, sparql);
-
-	if (g_file_info_get_size (file_info) > 0)
-		miner_files_add_rdf_types (sparql, file, mime_type);
+	sparql_template_render (file_insert_segments, priv->sparql_buffer, values);
+	append_mount_point_queries (data, priv->sparql_buffer);
 
-	sparql_builder_finish (data, NULL, NULL, NULL, NULL);
 	tracker_miner_fs_notify_finish (TRACKER_MINER_FS (data->miner), data->task,
-					tracker_sparql_builder_get_result (sparql),
+					priv->sparql_buffer->str,
 					NULL);
 
-	priv->extraction_queue = g_list_remove (priv->extraction_queue, data);
 	process_file_data_free (data);
 
+	g_string_free (types, TRUE);
+	g_free (urn_value);
+	g_free (parent_value);
+	g_free (name);
+	g_free (size);
+	g_free (mtime);
+	g_free (atime);
+	g_free (url);
+	g_free (mime);
+	g_free (datasource);
 	g_object_unref (file_info);
 	g_free (uri);
 }
@@ -2409,19 +2551,10 @@ miner_files_process_file (TrackerMinerFS *fs,
                           GFile          *file,
                           GTask          *task)
 {
-	TrackerMinerFilesPrivate *priv;
 	ProcessFileData *data;
 	const gchar *attrs;
 
-	data = g_slice_new0 (ProcessFileData);
-	data->miner = g_object_ref (fs);
-	data->cancellable = g_object_ref (g_task_get_cancellable (task));
-	data->sparql = tracker_sparql_builder_new_update ();
-	data->file = g_object_ref (file);
-	data->task = g_object_ref (task);
-
-	priv = TRACKER_MINER_FILES (fs)->private;
-	priv->extraction_queue = g_list_prepend (priv->extraction_queue, data);
+	data = process_file_data_new (fs, file, task);
 
 	attrs = G_FILE_ATTRIBUTE_STANDARD_TYPE ","
 		G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE ","
@@ -2553,12 +2686,8 @@ miner_files_process_file_attributes (TrackerMinerFS *fs,
 	ProcessFileData *data;
 	const gchar *attrs;
 
-	data = g_slice_new0 (ProcessFileData);
-	data->miner = g_object_ref (fs);
-	data->cancellable = g_object_ref (g_task_get_cancellable (task));
+	data = process_file_data_new (fs, file, task);
 	data->sparql = tracker_sparql_builder_new_update ();
-	data->file = g_object_ref (file);
-	data->task = g_object_ref (task);
 
 	/* Query only attributes that may change in an ATTRIBUTES_UPDATED event */
 	attrs = G_FILE_ATTRIBUTE_TIME_MODIFIED ","
@@ -2818,72 +2947,89 @@ tracker_miner_files_new (TrackerConfig  *config,
 	                       NULL);
 }
 
-gboolean
-tracker_miner_files_check_file (GFile  *file,
-                                GSList *ignored_file_paths,
-                                GSList *ignored_file_patterns)
+static gboolean
+file_is_hidden (GFile     *file,
+                GFileInfo *info)
 {
-	GSList *l;
-	gchar *basename;
-	gchar *path;
-	gboolean should_process;
+	if (info) {
+		return tracker_file_is_hidden_with_info (file, info);
+	}
 
-	should_process = FALSE;
-	basename = NULL;
-	path = NULL;
+	return tracker_file_is_hidden (file);
+}
 
-	if (tracker_file_is_hidden (file)) {
-		/* Ignore hidden files */
-		goto done;
+/* Only FAT filesystems answer FAT_IOCTL_GET_ATTRIBUTES, there is no
+ * point in opening files elsewhere. Without a TrackerStorage or a
+ * known filesystem type for the file, every file is checked.
+ */
+static gboolean
+file_may_be_on_fat (GFile          *file,
+                    TrackerStorage *storage)
+{
+	const gchar *fs_type;
+
+	if (!storage) {
+		return TRUE;
 	}
 
-	path = g_file_get_path (file);
+	fs_type = tracker_storage_get_filesystem_type_for_file (storage, file);
 
-	for (l = ignored_file_paths; l; l = l->next) {
-		if (strcmp (l->data, path) == 0) {
-			goto done;
-		}
+	if (!fs_type) {
+		return TRUE;
 	}
 
-	basename = g_file_get_basename (file);
+	return (g_strcmp0 (fs_type, "vfat") == 0 ||
+	        g_strcmp0 (fs_type, "msdos") == 0 ||
+	        g_strcmp0 (fs_type, "exfat") == 0);
+}
 
-	for (l = ignored_file_patterns; l; l = l->next) {
-		if (g_pattern_match_string (l->data, basename)) {
-			goto done;
-		}
+gboolean
+tracker_miner_files_check_file (GFile              *file,
+                                GFileInfo          *info,
+                                TrackerFileMatcher *ignored_files)
+{
+	gchar *path;
+	gboolean should_process;
+
+	if (file_is_hidden (file, info)) {
+		/* Ignore hidden files */
+		return FALSE;
 	}
 
-	should_process = TRUE;
+	path = g_file_get_path (file);
 
-done:
-	g_free (basename);
+	if (!path) {
+		/* Only basename patterns may apply */
+		path = g_file_get_basename (file);
+	}
+
+	should_process = !tracker_file_matcher_match (ignored_files, path);
 	g_free (path);
 
 	return should_process;
 }
 
 gboolean
-tracker_miner_files_check_directory (GFile  *file,
-                                     GSList *index_recursive_directories,
-                                     GSList *index_single_directories,
-                                     GSList *ignored_directory_paths,
-                                     GSList *ignored_directory_patterns)
+tracker_miner_files_check_directory (GFile              *file,
+                                     GFileInfo          *info,
+                                     TrackerStorage     *storage,
+                                     GSList             *index_recursive_directories,
+                                     GSList             *index_single_directories,
+                                     TrackerFileMatcher *ignored_directories)
 {
-	GSList *l;
-	gchar *basename;
 	gchar *path;
 	gboolean should_process;
 	gboolean is_hidden;
 
 	should_process = FALSE;
-	basename = NULL;
 
 	path = g_file_get_path (file);
 
 	/* First we check the GIO hidden check. This does a number of
 	 * things for us which is good (like checking ".foo" dirs).
+	 * If we were given the file info, it already carries that.
 	 */
-	is_hidden = tracker_file_is_hidden (file);
+	is_hidden = file_is_hidden (file, info);
 
 #ifdef __linux__
 	/* Second we check if the file is on FAT and if the hidden
@@ -2891,7 +3037,7 @@ tracker_miner_files_check_directory (GFile  *file,
 	 * not for Windows files under a Linux OS, so we have to check
 	 * anyway.
 	 */
-	if (!is_hidden) {
+	if (!is_hidden && file_may_be_on_fat (file, storage)) {
 		int fd;
 
 		fd = g_open (path, O_RDONLY, 0);
@@ -2924,25 +3070,14 @@ tracker_miner_files_check_directory (GFile  *file,
 		goto done;
 	}
 
-	for (l = ignored_directory_paths; l; l = l->next) {
-		if (strcmp (l->data, path) == 0) {
-			goto done;
-		}
-	}
-
-	basename = g_file_get_basename (file);
-
-	for (l = ignored_directory_patterns; l; l = l->next) {
-		if (g_pattern_match_string (l->data, basename)) {
-			goto done;
-		}
+	if (tracker_file_matcher_match (ignored_directories, path)) {
+		goto done;
 	}
 
 	/* Check module directory ignore patterns */
 	should_process = TRUE;
 
 done:
-	g_free (basename);
 	g_free (path);
 
 	return should_process;
@@ -3157,11 +3292,15 @@ tracker_miner_files_is_file_eligible (TrackerMinerFiles *miner,
 {
 	TrackerConfig *config;
 	GFile *dir;
-	GFileInfo *file_info;
+	GFileInfo *file_info, *dir_info;
 	gboolean is_dir;
 
+	/* Query the hidden attribute along with the type,
+	 * so the checks below don't need to query it again.
+	 */
 	file_info = g_file_query_info (file,
-	                               G_FILE_ATTRIBUTE_STANDARD_TYPE,
+	                               G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+	                               G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN,
 	                               G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
 	                               NULL, NULL);
 
@@ -3171,7 +3310,6 @@ tracker_miner_files_is_file_eligible (TrackerMinerFiles *miner,
 	}
 
 	is_dir = (g_file_info_get_file_type (file_info) == G_FILE_TYPE_DIRECTORY);
-	g_object_unref (file_info);
 
 	g_object_get (miner,
 	              "config", &config,
@@ -3179,27 +3317,37 @@ tracker_miner_files_is_file_eligible (TrackerMinerFiles *miner,
 
 	if (is_dir) {
 		dir = g_object_ref (file);
+		dir_info = file_info;
 	} else {
-		if (!tracker_miner_files_check_file (file,
-		                                     tracker_config_get_ignored_file_paths (config),
-		                                     tracker_config_get_ignored_file_patterns (config))) {
+		gboolean check;
+
+		check = tracker_miner_files_check_file (file, file_info,
+		                                        tracker_config_get_ignored_file_matcher (config));
+		g_object_unref (file_info);
+
+		if (!check) {
 			/* file is not eligible to be indexed */
 			g_object_unref (config);
 			return FALSE;
 		}
 
 		dir = g_file_get_parent (file);
+		dir_info = NULL;
 	}
 
 	if (dir) {
 		gboolean found = FALSE;
+		gboolean check;
 		GSList *l;
 
-		if (!tracker_miner_files_check_directory (dir,
-		                                          tracker_config_get_index_recursive_directories (config),
-		                                          tracker_config_get_index_single_directories (config),
-		                                          tracker_config_get_ignored_directory_paths (config),
-		                                          tracker_config_get_ignored_directory_patterns (config))) {
+		check = tracker_miner_files_check_directory (dir, dir_info,
+		                                             miner->private->storage,
+		                                             tracker_config_get_index_recursive_directories (config),
+		                                             tracker_config_get_index_single_directories (config),
+		                                             tracker_config_get_ignored_directory_matcher (config));
+		g_clear_object (&dir_info);
+
+		if (!check) {
 			/* file is not eligible to be indexed */
 			g_object_unref (dir);
 			g_object_unref (config);
@@ -3551,3 +3699,19 @@ tracker_miner_files_writeback_notify (TrackerMinerFiles *mf,
 	g_hash_table_insert (mf->private->writeback_tasks, file, NULL);
 	g_object_unref (cancellable);
 }
+
+guint
+tracker_miner_files_get_n_in_flight (TrackerMinerFiles *mf)
+{
+	g_return_val_if_fail (TRACKER_IS_MINER_FILES (mf), 0);
+
+	return mf->private->extraction_queue.length;
+}
+
+guint
+tracker_miner_files_get_peak_in_flight (TrackerMinerFiles *mf)
+{
+	g_return_val_if_fail (TRACKER_IS_MINER_FILES (mf), 0);
+
+	return mf->private->extraction_queue_peak;
+}
@@ -23,6 +23,7 @@
 #include <libtracker-miner/tracker-miner.h>
 
 #include "tracker-config.h"
+#include "tracker-storage.h"
 
 G_BEGIN_DECLS
 
@@ -52,14 +53,15 @@ TrackerMiner *tracker_miner_files_new                      (TrackerConfig  *conf
                                                             GError        **error);
 
 /* Convenience functions for --eligible tracker-miner-fs cmdline */
-gboolean      tracker_miner_files_check_file               (GFile             *file,
-                                                            GSList            *ignored_file_paths,
-                                                            GSList            *ignored_file_patterns);
-gboolean      tracker_miner_files_check_directory          (GFile             *file,
-                                                            GSList            *index_recursive_directories,
-                                                            GSList            *index_single_directories,
-                                                            GSList            *ignored_directory_paths,
-                                                            GSList            *ignored_directory_patterns);
+gboolean      tracker_miner_files_check_file               (GFile              *file,
+                                                            GFileInfo          *info,
+                                                            TrackerFileMatcher *ignored_files);
+gboolean      tracker_miner_files_check_directory          (GFile              *file,
+                                                            GFileInfo          *info,
+                                                            TrackerStorage     *storage,
+                                                            GSList             *index_recursive_directories,
+                                                            GSList             *index_single_directories,
+                                                            TrackerFileMatcher *ignored_directories);
 gboolean      tracker_miner_files_check_directory_contents (GFile             *parent,
                                                             GList             *children,
                                                             GSList            *ignored_content);
@@ -90,6 +92,9 @@ void     tracker_miner_files_writeback_notify     (TrackerMinerFiles *mf,
                                                    GFile             *file,
                                                    const GError      *error);
 
+guint    tracker_miner_files_get_n_in_flight      (TrackerMinerFiles *mf);
+guint    tracker_miner_files_get_peak_in_flight   (TrackerMinerFiles *mf);
+
 G_END_DECLS
 
 #endif /* __TRACKER_MINER_FS_FILES_H__ */
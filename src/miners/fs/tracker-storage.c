@@ -46,16 +46,35 @@ typedef struct {
 	GNode *mounts;
 	GHashTable *mounts_by_uuid;
 	GHashTable *unmount_watchdogs;
+
+	/* Same MountInfos as in the mounts tree, by decreasing
+	 * mount point length, so the first one prefixing a path
+	 * is the innermost mount containing it.
+	 */
+	GPtrArray *mount_index;
+
+	/* Filesystem type of every unix mount, not just the
+	 * ones above, sorted the same way as mount_index.
+	 */
+	GUnixMountMonitor *unix_mount_monitor;
+	GPtrArray *filesystems;
 } TrackerStoragePrivate;
 
 typedef struct {
 	gchar *mount_point;
+	gsize mount_point_len;
 	gchar *uuid;
 	guint unmount_timer_id;
 	guint removable : 1;
 	guint optical : 1;
 } MountInfo;
 
+typedef struct {
+	gchar *mount_point;
+	gsize mount_point_len;
+	gchar *fs_type;
+} FilesystemInfo;
+
 typedef struct {
 	const gchar *path;
 	GNode *node;
@@ -86,6 +105,10 @@ static void     mount_removed_cb         (GVolumeMonitor *monitor,
 static void     mount_pre_removed_cb     (GVolumeMonitor *monitor,
                                           GMount         *mount,
                                           gpointer        user_data);
+static void     filesystems_rebuild      (TrackerStorage *storage);
+static void     filesystem_info_free     (FilesystemInfo *info);
+static void     unix_mounts_changed_cb   (GUnixMountMonitor *monitor,
+                                          gpointer           user_data);
 
 enum {
 	MOUNT_POINT_ADDED,
@@ -146,6 +169,7 @@ tracker_storage_init (TrackerStorage *storage)
 	priv = TRACKER_STORAGE_GET_PRIVATE (storage);
 
 	priv->mounts = g_node_new (NULL);
+	priv->mount_index = g_ptr_array_new ();
 
 	priv->mounts_by_uuid = g_hash_table_new_full (g_str_hash,
 	                                              g_str_equal,
@@ -164,6 +188,12 @@ tracker_storage_init (TrackerStorage *storage)
 	g_signal_connect_object (priv->volume_monitor, "mount-added",
 	                         G_CALLBACK (mount_added_cb), storage, 0);
 
+	priv->filesystems = g_ptr_array_new_with_free_func ((GDestroyNotify) filesystem_info_free);
+	priv->unix_mount_monitor = g_unix_mount_monitor_get ();
+	g_signal_connect_object (priv->unix_mount_monitor, "mounts-changed",
+	                         G_CALLBACK (unix_mounts_changed_cb), storage, 0);
+	filesystems_rebuild (storage);
+
 	g_message ("Mount monitors set up for to watch for added, removed and pre-unmounts...");
 
 	/* Get all mounts and set them up */
@@ -189,6 +219,13 @@ tracker_storage_finalize (GObject *object)
 		mount_node_free (priv->mounts);
 	}
 
+	g_ptr_array_unref (priv->mount_index);
+	g_ptr_array_unref (priv->filesystems);
+
+	if (priv->unix_mount_monitor) {
+		g_object_unref (priv->unix_mount_monitor);
+	}
+
 	if (priv->volume_monitor) {
 		g_object_unref (priv->volume_monitor);
 	}
@@ -266,14 +303,185 @@ mount_info_free (GNode    *node,
 	return FALSE;
 }
 
+static gboolean
+mount_index_add_func (GNode    *node,
+                      gpointer  user_data)
+{
+	if (node->data) {
+		g_ptr_array_add (user_data, node->data);
+	}
+
+	return FALSE;
+}
+
+static gint
+mount_info_compare_length (gconstpointer a,
+                           gconstpointer b)
+{
+	const MountInfo *info_a = *((MountInfo **) a);
+	const MountInfo *info_b = *((MountInfo **) b);
+
+	if (info_a->mount_point_len == info_b->mount_point_len) {
+		return 0;
+	}
+
+	return info_a->mount_point_len > info_b->mount_point_len ? -1 : 1;
+}
+
+/* Must be called whenever the mounts tree changes */
+static void
+mount_index_rebuild (TrackerStorage *storage)
+{
+	TrackerStoragePrivate *priv;
+
+	priv = TRACKER_STORAGE_GET_PRIVATE (storage);
+
+	g_ptr_array_set_size (priv->mount_index, 0);
+	g_node_traverse (priv->mounts,
+	                 G_PRE_ORDER,
+	                 G_TRAVERSE_ALL,
+	                 -1,
+	                 mount_index_add_func,
+	                 priv->mount_index);
+	g_ptr_array_sort (priv->mount_index, mount_info_compare_length);
+}
+
+static gboolean
+mount_point_contains (const gchar *mount_point,
+                      gsize        mount_point_len,
+                      const gchar *path,
+                      gsize        path_len)
+{
+	/* Mount points end with a slash, the path
+	 * may equal the mount point without it.
+	 */
+	if (path_len + 1 < mount_point_len ||
+	    strncmp (path, mount_point, mount_point_len - 1) != 0) {
+		return FALSE;
+	}
+
+	return (path[mount_point_len - 1] == G_DIR_SEPARATOR ||
+	        path[mount_point_len - 1] == '\0');
+}
+
 static MountInfo *
-mount_info_find (GNode       *root,
-                 const gchar *path)
+mount_index_lookup (TrackerStorage *storage,
+                    const gchar    *path)
 {
-	GNode *node;
+	TrackerStoragePrivate *priv;
+	gsize path_len;
+	guint i;
+
+	priv = TRACKER_STORAGE_GET_PRIVATE (storage);
+	path_len = strlen (path);
 
-	node = mount_node_find (root, path);
-	return (node) ? node->data : NULL;
+	for (i = 0; i < priv->mount_index->len; i++) {
+		MountInfo *info = g_ptr_array_index (priv->mount_index, i);
+
+		if (mount_point_contains (info->mount_point, info->mount_point_len,
+		                          path, path_len)) {
+			return info;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+filesystem_info_free (FilesystemInfo *info)
+{
+	g_free (info->mount_point);
+	g_free (info->fs_type);
+	g_slice_free (FilesystemInfo, info);
+}
+
+static gint
+filesystem_info_compare_length (gconstpointer a,
+                                gconstpointer b)
+{
+	const FilesystemInfo *info_a = *((FilesystemInfo **) a);
+	const FilesystemInfo *info_b = *((FilesystemInfo **) b);
+
+	if (info_a->mount_point_len == info_b->mount_point_len) {
+		return 0;
+	}
+
+	return info_a->mount_point_len > info_b->mount_point_len ? -1 : 1;
+}
+
+static void
+filesystems_rebuild (TrackerStorage *storage)
+{
+	TrackerStoragePrivate *priv;
+	GList *entries, *l;
+
+	priv = TRACKER_STORAGE_GET_PRIVATE (storage);
+
+	g_ptr_array_set_size (priv->filesystems, 0);
+	entries = g_unix_mounts_get (NULL);
+
+	for (l = entries; l; l = l->next) {
+		GUnixMountEntry *entry = l->data;
+		FilesystemInfo *info;
+		const gchar *mount_path;
+
+		mount_path = g_unix_mount_get_mount_path (entry);
+
+		info = g_slice_new (FilesystemInfo);
+		info->fs_type = g_strdup (g_unix_mount_get_fs_type (entry));
+
+		if (g_str_has_suffix (mount_path, G_DIR_SEPARATOR_S)) {
+			info->mount_point = g_strdup (mount_path);
+		} else {
+			info->mount_point = g_strconcat (mount_path, G_DIR_SEPARATOR_S, NULL);
+		}
+
+		info->mount_point_len = strlen (info->mount_point);
+		g_ptr_array_add (priv->filesystems, info);
+		g_unix_mount_free (entry);
+	}
+
+	g_list_free (entries);
+
+	/* Mounts stacked on the same mount point keep their
+	 * relative order, the last one mounted wins.
+	 */
+	g_ptr_array_sort (priv->filesystems, filesystem_info_compare_length);
+}
+
+static FilesystemInfo *
+filesystems_lookup (TrackerStorage *storage,
+                    const gchar    *path)
+{
+	TrackerStoragePrivate *priv;
+	FilesystemInfo *found = NULL;
+	gsize path_len;
+	guint i;
+
+	priv = TRACKER_STORAGE_GET_PRIVATE (storage);
+	path_len = strlen (path);
+
+	for (i = 0; i < priv->filesystems->len; i++) {
+		FilesystemInfo *info = g_ptr_array_index (priv->filesystems, i);
+
+		if (found && info->mount_point_len < found->mount_point_len) {
+			break;
+		}
+
+		if (mount_point_contains (info->mount_point, info->mount_point_len,
+		                          path, path_len)) {
+			found = info;
+		}
+	}
+
+	return found;
+}
+
+static void
+unix_mounts_changed_cb (GUnixMountMonitor *monitor,
+                        gpointer           user_data)
+{
+	filesystems_rebuild (user_data);
 }
 
 static TrackerStorageType
@@ -327,6 +535,7 @@ mount_add_hierarchy (GNode       *root,
 
 	info = g_slice_new (MountInfo);
 	info->mount_point = mp;
+	info->mount_point_len = strlen (mp);
 	info->uuid = g_strdup (uuid);
 	info->removable = removable;
 	info->optical = optical;
@@ -349,6 +558,12 @@ mount_add_new (TrackerStorage *storage,
 
 	node = mount_add_hierarchy (priv->mounts, uuid, mount_point, removable_device, optical_disc);
 	g_hash_table_insert (priv->mounts_by_uuid, g_strdup (uuid), node);
+	mount_index_rebuild (storage);
+
+	/* The unix mount monitor may notify after the volume
+	 * monitor, have the filesystem type known already.
+	 */
+	filesystems_rebuild (storage);
 
 	g_signal_emit (storage,
 	               signals[MOUNT_POINT_ADDED],
@@ -770,6 +985,7 @@ mount_remove (TrackerStorage *storage,
 
 		g_hash_table_remove (priv->mounts_by_uuid, info->uuid);
 		mount_node_free (node);
+		mount_index_rebuild (storage);
 	} else {
 		g_message ("Mount:'%s' now unmounted from:'%s' (was not tracked)",
 		           name,
@@ -1057,6 +1273,25 @@ tracker_storage_get_type_for_uuid (TrackerStorage     *storage,
 	return type;
 }
 
+static MountInfo *
+mount_info_find_for_file (TrackerStorage *storage,
+                          GFile          *file)
+{
+	MountInfo *info;
+	gchar *path;
+
+	path = g_file_get_path (file);
+
+	if (!path) {
+		return NULL;
+	}
+
+	info = mount_index_lookup (storage, path);
+	g_free (path);
+
+	return info;
+}
+
 /**
  * tracker_storage_get_uuid_for_file:
  * @storage: A #TrackerStorage
@@ -1073,41 +1308,51 @@ const gchar *
 tracker_storage_get_uuid_for_file (TrackerStorage *storage,
                                    GFile          *file)
 {
-	TrackerStoragePrivate *priv;
-	gchar *path;
 	MountInfo *info;
 
 	g_return_val_if_fail (TRACKER_IS_STORAGE (storage), FALSE);
 
-	path = g_file_get_path (file);
+	info = mount_info_find_for_file (storage, file);
 
-	if (!path) {
+	if (!info) {
 		return NULL;
 	}
 
-	/* Normalize all paths to have a / at the end */
-	if (!g_str_has_suffix (path, G_DIR_SEPARATOR_S)) {
-		gchar *norm_path;
+	return info->uuid;
+}
 
-		norm_path = g_strconcat (path, G_DIR_SEPARATOR_S, NULL);
-		g_free (path);
-		path = norm_path;
-	}
+/**
+ * tracker_storage_get_filesystem_type_for_file:
+ * @storage: A #TrackerStorage
+ * @file: a file
+ *
+ * Returns the filesystem type (e.g. "vfat") of the mount containing
+ * @file. Unlike the other lookups, this covers every mounted
+ * filesystem, not just the volumes tracked by @storage.
+ *
+ * Returns: The filesystem type, or %NULL if @file is not a local
+ * file. This should not be freed.
+ *
+ * Since: 2.0
+ **/
+const gchar *
+tracker_storage_get_filesystem_type_for_file (TrackerStorage *storage,
+                                              GFile          *file)
+{
+	FilesystemInfo *info;
+	gchar *path;
 
-	priv = TRACKER_STORAGE_GET_PRIVATE (storage);
+	g_return_val_if_fail (TRACKER_IS_STORAGE (storage), NULL);
 
-	info = mount_info_find (priv->mounts, path);
+	path = g_file_get_path (file);
 
-	if (!info) {
-		g_free (path);
+	if (!path) {
 		return NULL;
 	}
 
-	/* g_debug ("Mount for path '%s' is '%s' (UUID:'%s')", */
-	/*          path, info->mount_point, info->uuid); */
-
+	info = filesystems_lookup (storage, path);
 	g_free (path);
 
-	return info->uuid;
+	return info ? info->fs_type : NULL;
 }
 
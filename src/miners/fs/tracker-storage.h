@@ -112,6 +112,8 @@ TrackerStorageType tracker_storage_get_type_for_uuid        (TrackerStorage
                                                              const gchar        *uuid);
 const gchar *      tracker_storage_get_uuid_for_file        (TrackerStorage     *storage,
                                                              GFile              *file);
+const gchar *      tracker_storage_get_filesystem_type_for_file (TrackerStorage *storage,
+                                                                 GFile          *file);
 
 G_END_DECLS
 
@@ -29,9 +29,15 @@
 #define TRACKER_RESOURCES_OBJECT        "/org/freedesktop/Tracker1/Resources"
 #define TRACKER_INTERFACE_RESOURCES     "org.freedesktop.Tracker1.Resources"
 
+/* Events arriving within this window are resolved together,
+ * in batches of up to EVENT_BATCH_SIZE subjects.
+ */
+#define EVENT_BATCH_WINDOW_MS           100
+#define EVENT_BATCH_SIZE                100
+
 typedef struct {
 	gint32 subject_id;
-	gint32 *types;
+	GArray *types;
 } WritebackEvent;
 
 typedef struct {
@@ -41,13 +47,15 @@ typedef struct {
 	guint d_signal;
 
 	GQueue *events;
+	GHashTable *pending_events; /* subject ID -> event in the queue */
+	GHashTable *class_uris;     /* class ID -> class URI */
 	guint event_dispatch_id;
 	guint querying : 1;
 } TrackerWritebackListenerPrivate;
 
 typedef struct {
 	TrackerWritebackListener *self;
-	GStrv rdf_types;
+	GHashTable *events; /* subject ID -> event */
 } QueryData;
 
 enum {
@@ -154,7 +162,7 @@ writeback_listener_get_property (GObject    *object,
 static void
 free_event (WritebackEvent *event)
 {
-	g_free (event->types);
+	g_array_unref (event->types);
 	g_free (event);
 }
 
@@ -170,7 +178,9 @@ writeback_listener_finalize (GObject *object)
 		g_source_remove (priv->event_dispatch_id);
 	}
 
+	g_hash_table_unref (priv->pending_events);
 	g_queue_free_full (priv->events, (GDestroyNotify) free_event);
+	g_hash_table_unref (priv->class_uris);
 
 	if (priv->connection && priv->d_signal) {
 		g_dbus_connection_signal_unsubscribe (priv->d_connection, priv->d_signal);
@@ -198,6 +208,8 @@ tracker_writeback_listener_init (TrackerWritebackListener *object)
 
 	priv = tracker_writeback_listener_get_instance_private (listener);
 	priv->events = g_queue_new ();
+	priv->pending_events = g_hash_table_new (NULL, NULL);
+	priv->class_uris = g_hash_table_new_full (NULL, NULL, NULL, g_free);
 }
 
 static gboolean
@@ -266,6 +278,8 @@ query_data_new (TrackerWritebackListener *self)
 	QueryData *data = g_slice_new0 (QueryData);
 
 	data->self = g_object_ref (self);
+	data->events = g_hash_table_new_full (NULL, NULL, NULL,
+	                                      (GDestroyNotify) free_event);
 
 	return data;
 }
@@ -274,12 +288,84 @@ static void
 query_data_free (QueryData *data)
 {
 	g_object_unref (data->self);
-	if (data->rdf_types) {
-		g_strfreev (data->rdf_types);
-	}
+	g_hash_table_unref (data->events);
 	g_slice_free (QueryData, data);
 }
 
+static void
+append_id_list (GString    *query,
+                GHashTable *ids)
+{
+	GHashTableIter iter;
+	gpointer key;
+	gboolean comma = FALSE;
+
+	g_hash_table_iter_init (&iter, ids);
+
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		if (comma) {
+			g_string_append_printf (query, ", %d", GPOINTER_TO_INT (key));
+		} else {
+			g_string_append_printf (query, "%d", GPOINTER_TO_INT (key));
+			comma = TRUE;
+		}
+	}
+}
+
+/* Returns the class URIs of the event types, as resolved
+ * in the cache. Types that are not classes are left out.
+ */
+static GStrv
+event_get_rdf_types (TrackerWritebackListener *self,
+                     WritebackEvent           *event)
+{
+	TrackerWritebackListenerPrivate *priv;
+	GPtrArray *rdf_types;
+	guint i;
+
+	priv = tracker_writeback_listener_get_instance_private (self);
+	rdf_types = g_ptr_array_new ();
+
+	for (i = 0; i < event->types->len; i++) {
+		gint32 rdf_type = g_array_index (event->types, gint32, i);
+		const gchar *uri;
+
+		uri = g_hash_table_lookup (priv->class_uris, GINT_TO_POINTER (rdf_type));
+
+		if (uri) {
+			g_ptr_array_add (rdf_types, g_strdup (uri));
+		}
+	}
+
+	g_ptr_array_add (rdf_types, NULL);
+
+	return (GStrv) g_ptr_array_free (rdf_types, FALSE);
+}
+
+static void
+writeback_subject (TrackerWritebackListener *self,
+                   WritebackEvent           *event,
+                   GFile                    *file,
+                   GPtrArray                *results)
+{
+	TrackerWritebackListenerPrivate *priv;
+	GStrv rdf_types;
+
+	priv = tracker_writeback_listener_get_instance_private (self);
+	rdf_types = event_get_rdf_types (self, event);
+
+	if (!rdf_types[0] || !g_file_query_exists (file, NULL)) {
+		g_message ("  No files qualify for updates");
+	} else {
+		tracker_miner_files_writeback_file (priv->files_miner,
+		                                    file,
+		                                    rdf_types,
+		                                    results);
+	}
+
+	g_strfreev (rdf_types);
+}
+
 static void
 sparql_query_cb (GObject      *object,
                  GAsyncResult *result,
@@ -287,65 +373,57 @@ sparql_query_cb (GObject      *object,
 {
 	QueryData *data = user_data;
 	TrackerWritebackListener *self = TRACKER_WRITEBACK_LISTENER (data->self);
-	TrackerWritebackListenerPrivate *priv;
 	TrackerSparqlCursor *cursor;
 	GError *error = NULL;
 
-	priv = tracker_writeback_listener_get_instance_private (self);
-
 	cursor = tracker_sparql_connection_query_finish (TRACKER_SPARQL_CONNECTION (object), result, &error);
 
 	if (!error) {
-		guint cols = tracker_sparql_cursor_get_n_columns (cursor);
+		WritebackEvent *event = NULL;
 		GPtrArray *results = NULL;
 		GFile *file = NULL;
 
+		/* Rows come sorted by subject, each subject is written
+		 * back as soon as all its rows were collected.
+		 */
 		while (tracker_sparql_cursor_next (cursor, NULL, NULL)) {
-			GStrv row = NULL;
+			gint32 subject_id;
+			GStrv row;
 			guint i;
 
-			if (file == NULL) {
-				file = g_file_new_for_uri (tracker_sparql_cursor_get_string (cursor, 0, NULL));
-				if (!g_file_query_exists (file, NULL)) {
-					g_object_unref (file);
-					g_message ("  No files qualify for updates");
-					query_data_free (data);
-					g_object_unref (cursor);
-
-					check_start_idle (self, TRUE);
-					return;
+			subject_id = tracker_sparql_cursor_get_integer (cursor, 4);
+
+			if (!event || event->subject_id != subject_id) {
+				if (event) {
+					writeback_subject (self, event, file, results);
+					g_clear_object (&file);
+					g_clear_pointer (&results, g_ptr_array_unref);
 				}
-			}
 
-			for (i = 0; i < cols; i++) {
-				if (!row) {
-					row = g_new0 (gchar*, cols);
+				event = g_hash_table_lookup (data->events,
+				                             GINT_TO_POINTER (subject_id));
+				if (!event) {
+					continue;
 				}
-				row[i] = g_strdup (tracker_sparql_cursor_get_string (cursor, i, NULL));
-			}
 
-			if (!results) {
+				file = g_file_new_for_uri (tracker_sparql_cursor_get_string (cursor, 0, NULL));
 				results = g_ptr_array_new_with_free_func ((GDestroyNotify) g_strfreev);
 			}
 
-			g_ptr_array_add (results, row);
-		}
+			/* url, subject, predicate, object */
+			row = g_new0 (gchar*, 5);
 
-		if (results != NULL && results->len > 0) {
-			tracker_miner_files_writeback_file (priv->files_miner,
-			                                    file,
-			                                    data->rdf_types,
-			                                    results);
-		} else {
-			g_message ("  No files qualify for updates");
-		}
+			for (i = 0; i < 4; i++) {
+				row[i] = g_strdup (tracker_sparql_cursor_get_string (cursor, i, NULL));
+			}
 
-		if (file) {
-			g_object_unref (file);
+			g_ptr_array_add (results, row);
 		}
 
-		if (results) {
-			g_ptr_array_unref (results);
+		if (event) {
+			writeback_subject (self, event, file, results);
+			g_clear_object (&file);
+			g_clear_pointer (&results, g_ptr_array_unref);
 		}
 
 		g_object_unref (cursor);
@@ -359,6 +437,34 @@ sparql_query_cb (GObject      *object,
 	check_start_idle (self, TRUE);
 }
 
+static void
+query_properties (QueryData *data)
+{
+	TrackerWritebackListenerPrivate *priv;
+	GString *query;
+
+	priv = tracker_writeback_listener_get_instance_private (data->self);
+
+	query = g_string_new ("SELECT ?url ?subject ?predicate ?object tracker:id (?subject) { "
+	                      "?subject a nfo:FileDataObject ; "
+	                      "         ?predicate ?object ; "
+	                      "         nie:url ?url . "
+	                      "?predicate tracker:writeback true . "
+	                      "FILTER (tracker:id (?subject) IN (");
+	append_id_list (query, data->events);
+	g_string_append (query, ")) "
+	                 "FILTER (NOT EXISTS { GRAPH <" TRACKER_OWN_GRAPH_URN "> "
+	                 "{ ?subject ?predicate ?object } }) } "
+	                 "ORDER BY tracker:id (?subject)");
+
+	tracker_sparql_connection_query_async (priv->connection,
+	                                       query->str,
+	                                       NULL,
+	                                       sparql_query_cb,
+	                                       data);
+	g_string_free (query, TRUE);
+}
+
 static void
 rdf_types_to_uris_cb (GObject      *object,
                       GAsyncResult *result,
@@ -368,65 +474,31 @@ rdf_types_to_uris_cb (GObject      *object,
 	TrackerWritebackListener *self = TRACKER_WRITEBACK_LISTENER (data->self);
 	TrackerWritebackListenerPrivate *priv;
 	TrackerSparqlCursor *cursor;
-	TrackerSparqlConnection *connection;
 	GError *error = NULL;
-	gchar *query;
-	GArray *rdf_types;
-	gchar *subject = NULL;
 
 	priv = tracker_writeback_listener_get_instance_private (self);
-	connection = priv->connection;
 
-	cursor = tracker_sparql_connection_query_finish (connection, result, &error);
+	cursor = tracker_sparql_connection_query_finish (priv->connection, result, &error);
 
-	if (error)
-		goto trouble;
+	if (error) {
+		g_message ("  No files qualify for updates (%s)", error->message);
+		g_error_free (error);
+		query_data_free (data);
 
-	rdf_types = g_array_new (TRUE, TRUE, sizeof (gchar *));
+		check_start_idle (self, TRUE);
+		return;
+	}
 
 	while (tracker_sparql_cursor_next (cursor, NULL, NULL)) {
-		gchar *uri = g_strdup (tracker_sparql_cursor_get_string (cursor, 0, NULL));
-		if (subject == NULL) {
-			subject = g_strdup (tracker_sparql_cursor_get_string (cursor, 1, NULL));
-		}
-		g_array_append_val (rdf_types, uri);
+		gint32 id = tracker_sparql_cursor_get_integer (cursor, 0);
+
+		g_hash_table_insert (priv->class_uris, GINT_TO_POINTER (id),
+		                     g_strdup (tracker_sparql_cursor_get_string (cursor, 1, NULL)));
 	}
 
 	g_object_unref (cursor);
 
-	data->rdf_types = (GStrv) rdf_types->data;
-	g_array_free (rdf_types, FALSE);
-
-	if (subject == NULL)
-		goto trouble;
-
-	query = g_strdup_printf ("SELECT ?url '%s' ?predicate ?object { "
-	                         "<%s> a nfo:FileDataObject . "
-	                         "<%s> ?predicate ?object ; nie:url ?url . "
-	                         "?predicate tracker:writeback true . "
-	                         "FILTER (NOT EXISTS { GRAPH <" TRACKER_OWN_GRAPH_URN "> "
-	                         "{ <%s> ?predicate ?object } }) } ",
-	                         subject, subject, subject, subject);
-
-	tracker_sparql_connection_query_async (connection,
-	                                       query,
-	                                       NULL,
-	                                       sparql_query_cb,
-	                                       data);
-
-	g_free (subject);
-	g_free (query);
-
-	return;
-
-trouble:
-	if (error) {
-		g_message ("  No files qualify for updates (%s)", error->message);
-		g_error_free (error);
-	}
-	query_data_free (data);
-
-	check_start_idle (self, TRUE);
+	query_properties (data);
 }
 
 static gboolean
@@ -436,49 +508,58 @@ process_event (gpointer user_data)
 	TrackerWritebackListenerPrivate *priv;
 	WritebackEvent *event;
 	QueryData *data = NULL;
+	GHashTable *unknown_types;
 	GString *query;
-	gboolean comma = FALSE;
-	gint i;
+	guint i;
 
 	priv = tracker_writeback_listener_get_instance_private (self);
-	event = g_queue_pop_head (priv->events);
 	priv->event_dispatch_id = 0;
 
-	if (!event)
+	if (g_queue_is_empty (priv->events)) {
+		priv->querying = FALSE;
 		return G_SOURCE_REMOVE;
+	}
 
 	data = query_data_new (self);
+	unknown_types = g_hash_table_new (NULL, NULL);
 
-	/* Two queries are grouped together here to reduce the amount of
-	 * queries that must be made. tracker:uri() is idd unrelated to
-	 * the other part of the query (and is repeated each result, idd) */
+	while (g_hash_table_size (data->events) < EVENT_BATCH_SIZE &&
+	       (event = g_queue_pop_head (priv->events)) != NULL) {
+		g_hash_table_remove (priv->pending_events,
+		                     GINT_TO_POINTER (event->subject_id));
+		g_hash_table_insert (data->events,
+		                     GINT_TO_POINTER (event->subject_id), event);
 
-	query = g_string_new ("SELECT ");
-	g_string_append_printf (query, "?resource tracker:uri (%d) { "
-		                       "?resource a rdfs:Class . "
-		                       "FILTER (tracker:id (?resource) IN (",
-	                        event->subject_id);
+		for (i = 0; i < event->types->len; i++) {
+			gint32 rdf_type = g_array_index (event->types, gint32, i);
 
-	for (i = 0; event->types[i] != 0; i++) {
-		gint32 rdf_type = event->types[i];
-
-		if (comma) {
-			g_string_append_printf (query, ", %d", rdf_type);
-		} else {
-			g_string_append_printf (query, "%d", rdf_type);
-			comma = TRUE;
+			if (!g_hash_table_contains (priv->class_uris, GINT_TO_POINTER (rdf_type))) {
+				g_hash_table_add (unknown_types, GINT_TO_POINTER (rdf_type));
+			}
 		}
 	}
 
-	g_string_append (query, ")) }");
+	/* Class IDs are resolved once, and remembered for later
+	 * events, only unknown ones need querying here.
+	 */
+	if (g_hash_table_size (unknown_types) == 0) {
+		query_properties (data);
+	} else {
+		query = g_string_new ("SELECT tracker:id (?resource) ?resource { "
+		                      "?resource a rdfs:Class . "
+		                      "FILTER (tracker:id (?resource) IN (");
+		append_id_list (query, unknown_types);
+		g_string_append (query, ")) }");
+
+		tracker_sparql_connection_query_async (priv->connection,
+		                                       query->str,
+		                                       NULL,
+		                                       rdf_types_to_uris_cb,
+		                                       data);
+		g_string_free (query, TRUE);
+	}
 
-	tracker_sparql_connection_query_async (priv->connection,
-	                                       query->str,
-	                                       NULL,
-	                                       rdf_types_to_uris_cb,
-	                                       data);
-	g_string_free (query, TRUE);
-	free_event (event);
+	g_hash_table_unref (unknown_types);
 
 	return G_SOURCE_REMOVE;
 }
@@ -501,10 +582,39 @@ check_start_idle (TrackerWritebackListener *self,
 	}
 
 	priv->querying = TRUE;
-	priv->event_dispatch_id =
-		g_idle_add_full (G_PRIORITY_LOW,
-		                 process_event,
-		                 self, NULL);
+
+	if (force) {
+		/* Events queued meanwhile waited long enough */
+		priv->event_dispatch_id =
+			g_idle_add_full (G_PRIORITY_LOW,
+			                 process_event,
+			                 self, NULL);
+	} else {
+		/* Give related events some time to arrive */
+		priv->event_dispatch_id =
+			g_timeout_add_full (G_PRIORITY_LOW,
+			                    EVENT_BATCH_WINDOW_MS,
+			                    process_event,
+			                    self, NULL);
+	}
+}
+
+static void
+add_event_types (WritebackEvent *event,
+                 GVariantIter   *iter)
+{
+	gint32 rdf_type;
+	guint i;
+
+	while (g_variant_iter_loop (iter, "i", &rdf_type)) {
+		for (i = 0; i < event->types->len; i++) {
+			if (g_array_index (event->types, gint32, i) == rdf_type)
+				break;
+		}
+
+		if (i == event->types->len)
+			g_array_append_val (event->types, rdf_type);
+	}
 }
 
 static void
@@ -524,18 +634,24 @@ on_writeback_cb (GDBusConnection      *connection,
 	priv = tracker_writeback_listener_get_instance_private (self);
 	g_variant_get (parameters, "(a{iai})", &iter1);
 
-	if (g_variant_iter_next (iter1, "{iai}", &subject_id, &iter2)) {
-		WritebackEvent *event = g_new (WritebackEvent, 1);
-		GArray *types = g_array_new (TRUE, TRUE, sizeof (gint32));
-		gint32 rdf_type;
+	while (g_variant_iter_next (iter1, "{iai}", &subject_id, &iter2)) {
+		WritebackEvent *event;
+
+		/* Coalesce with the pending event for the same subject */
+		event = g_hash_table_lookup (priv->pending_events,
+		                             GINT_TO_POINTER (subject_id));
 
-		while (g_variant_iter_loop (iter2, "i", &rdf_type))
-			g_array_append_val (types, rdf_type);
+		if (!event) {
+			event = g_new (WritebackEvent, 1);
+			event->subject_id = subject_id;
+			event->types = g_array_new (FALSE, FALSE, sizeof (gint32));
+			g_queue_push_tail (priv->events, event);
+			g_hash_table_insert (priv->pending_events,
+			                     GINT_TO_POINTER (subject_id), event);
+		}
 
+		add_event_types (event, iter2);
 		g_variant_iter_free (iter2);
-		event->subject_id = subject_id;
-		event->types = (gint32 *) g_array_free (types, FALSE);
-		g_queue_push_tail (priv->events, event);
 	}
 
 	g_variant_iter_free (iter1);
@@ -48,6 +48,8 @@ enum {
 	PROP_MAX_BYTES,
 	PROP_MAX_MEDIA_ART_WIDTH,
 	PROP_WAIT_FOR_MINER_FS,
+	PROP_MAX_THREADS,
+	PROP_MAX_EXTRACTING_FILES,
 };
 
 G_DEFINE_TYPE (TrackerConfig, tracker_config, G_TYPE_SETTINGS);
@@ -106,6 +108,24 @@ tracker_config_class_init (TrackerConfigClass *klass)
 	                                                       "%TRUE to wait for tracker-miner-fs is done before extracting. %FAlSE otherwise",
 	                                                       FALSE,
 	                                                       G_PARAM_READWRITE));
+
+	g_object_class_install_property (object_class,
+	                                 PROP_MAX_THREADS,
+	                                 g_param_spec_int ("max-threads",
+	                                                   "Max Threads",
+	                                                   "Maximum number of threads running extractor modules (0=one per processor)",
+	                                                   0, 256,
+	                                                   0,
+	                                                   G_PARAM_READWRITE));
+
+	g_object_class_install_property (object_class,
+	                                 PROP_MAX_EXTRACTING_FILES,
+	                                 g_param_spec_int ("max-extracting-files",
+	                                                   "Max Extracting Files",
+	                                                   "Maximum number of files being extracted at the same time (0=automatic)",
+	                                                   0, 64,
+	                                                   0,
+	                                                   G_PARAM_READWRITE));
 }
 
 static void
@@ -135,6 +155,8 @@ config_set_property (GObject      *object,
 	case PROP_MAX_BYTES:
 	case PROP_MAX_MEDIA_ART_WIDTH:
 	case PROP_WAIT_FOR_MINER_FS:
+	case PROP_MAX_THREADS:
+	case PROP_MAX_EXTRACTING_FILES:
 		break;
 
 	default:
@@ -177,6 +199,16 @@ config_get_property (GObject    *object,
 		                     tracker_config_get_wait_for_miner_fs (config));
 		break;
 
+	case PROP_MAX_THREADS:
+		g_value_set_int (value,
+		                 tracker_config_get_max_threads (config));
+		break;
+
+	case PROP_MAX_EXTRACTING_FILES:
+		g_value_set_int (value,
+		                 tracker_config_get_max_extracting_files (config));
+		break;
+
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, param_id, pspec);
 		break;
@@ -228,6 +260,8 @@ config_constructed (GObject *object)
 	g_settings_bind (settings, "sched-idle", object, "sched-idle", G_SETTINGS_BIND_GET);
 	g_settings_bind (settings, "max-media-art-width", object, "max-media-art-width", G_SETTINGS_BIND_GET);
 	g_settings_bind (settings, "wait-for-miner-fs", object, "wait-for-miner-fs", G_SETTINGS_BIND_GET);
+	g_settings_bind (settings, "max-threads", object, "max-threads", G_SETTINGS_BIND_GET);
+	g_settings_bind (settings, "max-extracting-files", object, "max-extracting-files", G_SETTINGS_BIND_GET);
 
 	/* Cache settings accessed from extractor modules, we don't want
 	 * the GSettings object accessed within these as it may trigger
@@ -326,3 +360,19 @@ tracker_config_get_wait_for_miner_fs (TrackerConfig *config)
 
 	return g_settings_get_boolean (G_SETTINGS (config), "wait-for-miner-fs");
 }
+
+gint
+tracker_config_get_max_threads (TrackerConfig *config)
+{
+	g_return_val_if_fail (TRACKER_IS_CONFIG (config), 0);
+
+	return g_settings_get_int (G_SETTINGS (config), "max-threads");
+}
+
+gint
+tracker_config_get_max_extracting_files (TrackerConfig *config)
+{
+	g_return_val_if_fail (TRACKER_IS_CONFIG (config), 0);
+
+	return g_settings_get_int (G_SETTINGS (config), "max-extracting-files");
+}
@@ -25,6 +25,8 @@
 #include "tracker-extract-decorator.h"
 #include "tracker-extract-persistence.h"
 #include "tracker-extract-priority-dbus.h"
+#include "tracker-extract-statistics-dbus.h"
+#include "tracker-main.h"
 
 enum {
 	PROP_EXTRACTOR = 1
@@ -32,7 +34,24 @@ enum {
 
 #define TRACKER_EXTRACT_DATA_SOURCE TRACKER_PREFIX_TRACKER "extractor-data-source"
 #define TRACKER_EXTRACT_FAILURE_DATA_SOURCE TRACKER_PREFIX_TRACKER "extractor-failure-data-source"
-#define MAX_EXTRACTING_FILES 1
+
+/* The number of files in flight is adapted to how fast extraction
+ * goes, it grows by one file for every window of files extracted
+ * without latency going up, and halves when it does.
+ */
+#define MIN_EXTRACTING_FILES 1
+#define MAX_EXTRACTING_FILES_CEILING 64
+
+/* Smoothed latency over the base latency ratios that grow and
+ * shrink the window, in between it's left as is.
+ */
+#define LATENCY_GROW_RATIO 2
+#define LATENCY_SHRINK_RATIO 4
+
+/* The base latency is sampled again after this many files, so
+ * it follows changes in the kind of files being extracted.
+ */
+#define LATENCY_BASE_RESET 256
 
 #define TRACKER_EXTRACT_DECORATOR_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), TRACKER_TYPE_EXTRACT_DECORATOR, TrackerExtractDecoratorPrivate))
 
@@ -43,6 +62,7 @@ struct _ExtractData {
 	TrackerDecorator *decorator;
 	TrackerDecoratorInfo *decorator_info;
 	GFile *file;
+	gint64 start_time;
 };
 
 struct _TrackerExtractDecoratorPrivate {
@@ -50,12 +70,27 @@ struct _TrackerExtractDecoratorPrivate {
 	GTimer *timer;
 	guint n_extracting_files;
 
+	/* Items are collected while tracker_decorator_next() calls
+	 * are in flight, and extracted together once all returned.
+	 */
+	GPtrArray *next_batch;
+	guint n_next_requests;
+
+	/* Extraction window */
+	guint max_extracting_files;
+	guint extracting_files_ceiling;
+	guint n_window_completions;
+	guint n_latency_samples;
+	gint64 base_latency;
+	gint64 smoothed_latency;
+
 	TrackerExtractPersistence *persistence;
 	GHashTable *recovery_files;
 
 	/* DBus name -> AppData */
 	GHashTable *apps;
 	TrackerExtractDBusPriority *iface;
+	TrackerExtractDBusStatistics *statistics_iface;
 };
 
 typedef struct {
@@ -134,8 +169,10 @@ tracker_extract_decorator_finalize (GObject *object)
 		g_timer_destroy (priv->timer);
 
 	g_object_unref (priv->iface);
+	g_object_unref (priv->statistics_iface);
 	g_hash_table_unref (priv->apps);
 	g_hash_table_unref (priv->recovery_files);
+	g_ptr_array_unref (priv->next_batch);
 
 	G_OBJECT_CLASS (tracker_extract_decorator_parent_class)->finalize (object);
 }
@@ -169,19 +206,104 @@ decorator_save_info (TrackerExtractDecorator *decorator,
 	return resource;
 }
 
+static guint
+decorator_get_extracting_files_ceiling (void)
+{
+	TrackerConfig *config;
+	gint max_files = 0, n_threads = 0;
+	gboolean sched_idle = FALSE;
+	guint ceiling;
+
+	config = tracker_main_get_config ();
+
+	if (config) {
+		max_files = tracker_config_get_max_extracting_files (config);
+		n_threads = tracker_config_get_max_threads (config);
+		sched_idle = (tracker_config_get_sched_idle (config) != TRACKER_SCHED_IDLE_NEVER);
+	}
+
+	if (max_files > 0)
+		return MIN (max_files, MAX_EXTRACTING_FILES_CEILING);
+
+	if (n_threads <= 0)
+		n_threads = g_get_num_processors ();
+
+	if (sched_idle) {
+		/* We only get CPU time others don't want, don't keep
+		 * more files around than there are threads to run them.
+		 */
+		ceiling = n_threads;
+	} else {
+		/* Keep a file waiting for every thread, so these
+		 * don't go idle while we fetch the next item.
+		 */
+		ceiling = n_threads * 2;
+	}
+
+	return CLAMP (ceiling, MIN_EXTRACTING_FILES, MAX_EXTRACTING_FILES_CEILING);
+}
+
 static void
-get_metadata_cb (TrackerExtract *extract,
-                 GAsyncResult   *result,
-                 ExtractData    *data)
+decorator_update_window (TrackerExtractDecorator *decorator,
+                         gint64                   latency)
+{
+	TrackerExtractDecoratorPrivate *priv;
+	guint max_extracting_files;
+
+	priv = decorator->priv;
+
+	if (priv->n_latency_samples == 0) {
+		priv->smoothed_latency = latency;
+	} else {
+		priv->smoothed_latency += (latency - priv->smoothed_latency) / 8;
+	}
+
+	if (priv->n_latency_samples % LATENCY_BASE_RESET == 0) {
+		priv->base_latency = MIN (latency, priv->smoothed_latency);
+	} else {
+		priv->base_latency = MIN (latency, priv->base_latency);
+	}
+
+	priv->n_latency_samples++;
+	priv->n_window_completions++;
+
+	/* Let the files extracted with the current window drain
+	 * before judging it, once per window at most.
+	 */
+	if (priv->n_window_completions < priv->max_extracting_files)
+		return;
+
+	priv->n_window_completions = 0;
+	max_extracting_files = priv->max_extracting_files;
+
+	if (priv->smoothed_latency > priv->base_latency * LATENCY_SHRINK_RATIO) {
+		max_extracting_files = MAX (max_extracting_files / 2,
+		                            MIN_EXTRACTING_FILES);
+	} else if (priv->smoothed_latency <= priv->base_latency * LATENCY_GROW_RATIO &&
+	           tracker_decorator_get_n_items (TRACKER_DECORATOR (decorator)) > 0) {
+		max_extracting_files = MIN (max_extracting_files + 1,
+		                            priv->extracting_files_ceiling);
+	}
+
+	if (max_extracting_files != priv->max_extracting_files) {
+		g_debug ("Extracting up to %u files at once (latency %" G_GINT64_FORMAT
+		         "us, base %" G_GINT64_FORMAT "us)",
+		         max_extracting_files,
+		         priv->smoothed_latency, priv->base_latency);
+		priv->max_extracting_files = max_extracting_files;
+	}
+}
+
+static void
+decorator_extract_done (ExtractData        *data,
+                        TrackerExtractInfo *info,
+                        const GError       *error)
 {
 	TrackerExtractDecoratorPrivate *priv;
-	TrackerExtractInfo *info;
 	TrackerResource *resource;
-	GError *error = NULL;
 	gchar *sparql;
 
 	priv = TRACKER_EXTRACT_DECORATOR (data->decorator)->priv;
-	info = tracker_extract_file_finish (extract, result, &error);
 
 	tracker_extract_persistence_remove_file (priv->persistence, data->file);
 	g_hash_table_remove (priv->recovery_files, tracker_decorator_info_get_url (data->decorator_info));
@@ -190,9 +312,9 @@ get_metadata_cb (TrackerExtract *extract,
 		if (error->domain == TRACKER_EXTRACT_ERROR) {
 			g_message ("Extraction failed: %s\n", error ? error->message : "no error given");
 			tracker_decorator_info_complete (data->decorator_info, NULL);
-			g_clear_error (&error);
 		} else {
-			tracker_decorator_info_complete_error (data->decorator_info, error);
+			tracker_decorator_info_complete_error (data->decorator_info,
+			                                       g_error_copy (error));
 		}
 	} else {
 		resource = decorator_save_info (TRACKER_EXTRACT_DECORATOR (data->decorator),
@@ -200,18 +322,84 @@ get_metadata_cb (TrackerExtract *extract,
 		sparql = tracker_resource_print_sparql_update (resource, NULL,
 		                                               TRACKER_OWN_GRAPH_URN);
 		tracker_decorator_info_complete (data->decorator_info, sparql);
-		tracker_extract_info_unref (info);
 		g_object_unref (resource);
 	}
 
 	priv->n_extracting_files--;
-	decorator_get_next_file (data->decorator);
+	decorator_update_window (TRACKER_EXTRACT_DECORATOR (data->decorator),
+	                         g_get_monotonic_time () - data->start_time);
+
+	/* Refilling on every completion would extract batches of a
+	 * single file, wait until half the window is free instead.
+	 */
+	if (priv->n_extracting_files <= priv->max_extracting_files / 2)
+		decorator_get_next_file (data->decorator);
 
 	tracker_decorator_info_unref (data->decorator_info);
 	g_object_unref (data->file);
 	g_free (data);
 }
 
+static void
+extract_batch_item_cb (TrackerExtract     *extract,
+                       guint               index,
+                       TrackerExtractInfo *info,
+                       const GError       *error,
+                       GPtrArray          *batch)
+{
+	decorator_extract_done (g_ptr_array_index (batch, index), info, error);
+}
+
+static void
+extract_batch_cb (TrackerExtract *extract,
+                  GAsyncResult   *result,
+                  GPtrArray      *batch)
+{
+	tracker_extract_file_batch_finish (extract, result, NULL);
+	g_ptr_array_unref (batch);
+}
+
+static void
+decorator_extract_batch (TrackerExtractDecorator *decorator)
+{
+	TrackerExtractDecoratorPrivate *priv;
+	const gchar **files, **mimetypes;
+	GCancellable **cancellables;
+	GPtrArray *batch;
+	guint i;
+
+	priv = decorator->priv;
+
+	if (priv->n_next_requests > 0 || priv->next_batch->len == 0)
+		return;
+
+	batch = priv->next_batch;
+	priv->next_batch = g_ptr_array_new ();
+
+	files = g_new (const gchar *, batch->len);
+	mimetypes = g_new (const gchar *, batch->len);
+	cancellables = g_new (GCancellable *, batch->len);
+
+	for (i = 0; i < batch->len; i++) {
+		ExtractData *data = g_ptr_array_index (batch, i);
+		GTask *task;
+
+		task = tracker_decorator_info_get_task (data->decorator_info);
+		files[i] = tracker_decorator_info_get_url (data->decorator_info);
+		mimetypes[i] = tracker_decorator_info_get_mimetype (data->decorator_info);
+		cancellables[i] = g_task_get_cancellable (task);
+	}
+
+	tracker_extract_file_batch (priv->extractor,
+	                            files, mimetypes, cancellables, batch->len,
+	                            (TrackerExtractBatchFunc) extract_batch_item_cb,
+	                            (GAsyncReadyCallback) extract_batch_cb,
+	                            batch);
+	g_free (files);
+	g_free (mimetypes);
+	g_free (cancellables);
+}
+
 static GFile *
 decorator_get_recovery_file (TrackerExtractDecorator *decorator,
                              TrackerDecoratorInfo    *info)
@@ -241,10 +429,10 @@ decorator_next_item_cb (TrackerDecorator *decorator,
 	TrackerDecoratorInfo *info;
 	GError *error = NULL;
 	ExtractData *data;
-	GTask *task;
 
 	priv = TRACKER_EXTRACT_DECORATOR (decorator)->priv;
 	info = tracker_decorator_next_finish (decorator, result, &error);
+	priv->n_next_requests--;
 
 	if (!info) {
 		priv->n_extracting_files--;
@@ -263,12 +451,14 @@ decorator_next_item_cb (TrackerDecorator *decorator,
 		}
 
 		g_clear_error (&error);
+		decorator_extract_batch (TRACKER_EXTRACT_DECORATOR (decorator));
 		return;
 	} else if (!tracker_decorator_info_get_url (info)) {
 		/* Skip virtual elements with no real file representation */
 		priv->n_extracting_files--;
 		tracker_decorator_info_unref (info);
 		decorator_get_next_file (decorator);
+		decorator_extract_batch (TRACKER_EXTRACT_DECORATOR (decorator));
 		return;
 	}
 
@@ -276,17 +466,14 @@ decorator_next_item_cb (TrackerDecorator *decorator,
 	data->decorator = decorator;
 	data->decorator_info = info;
 	data->file = decorator_get_recovery_file (TRACKER_EXTRACT_DECORATOR (decorator), info);
-	task = tracker_decorator_info_get_task (info);
+	data->start_time = g_get_monotonic_time ();
 
 	g_message ("Extracting metadata for '%s'", tracker_decorator_info_get_url (info));
 
 	tracker_extract_persistence_add_file (priv->persistence, data->file);
 
-	tracker_extract_file (priv->extractor,
-	                      tracker_decorator_info_get_url (info),
-	                      tracker_decorator_info_get_mimetype (info),
-	                      g_task_get_cancellable (task),
-	                      (GAsyncReadyCallback) get_metadata_cb, data);
+	g_ptr_array_add (priv->next_batch, data);
+	decorator_extract_batch (TRACKER_EXTRACT_DECORATOR (decorator));
 }
 
 static void
@@ -302,9 +489,10 @@ decorator_get_next_file (TrackerDecorator *decorator)
 		return;
 
 	available_items = tracker_decorator_get_n_items (decorator);
-	while (priv->n_extracting_files < MAX_EXTRACTING_FILES &&
+	while (priv->n_extracting_files < priv->max_extracting_files &&
 	       available_items > 0) {
 		priv->n_extracting_files++;
+		priv->n_next_requests++;
 		available_items--;
 		tracker_decorator_next (decorator, NULL,
 		                        (GAsyncReadyCallback) decorator_next_item_cb,
@@ -322,6 +510,12 @@ tracker_extract_decorator_paused (TrackerMiner *miner)
 
 	if (priv->timer)
 		g_timer_stop (priv->timer);
+
+	/* Whatever made us pause may still be competing
+	 * for resources after resuming, start over small.
+	 */
+	priv->max_extracting_files = MIN_EXTRACTING_FILES;
+	priv->n_window_completions = 0;
 }
 
 static void
@@ -352,6 +546,8 @@ tracker_extract_decorator_items_available (TrackerDecorator *decorator)
 	if (tracker_miner_is_paused (TRACKER_MINER (decorator)))
 		g_timer_stop (priv->timer);
 
+	priv->extracting_files_ceiling = decorator_get_extracting_files_ceiling ();
+
 	decorator_get_next_file (decorator);
 }
 
@@ -525,6 +721,21 @@ handle_clear_rdf_types_cb (TrackerExtractDBusPriority *iface,
 	return TRUE;
 }
 
+static gboolean
+handle_get_module_statistics_cb (TrackerExtractDBusStatistics *iface,
+                                 GDBusMethodInvocation        *invocation,
+                                 TrackerExtractDecorator      *decorator)
+{
+	TrackerExtractDecoratorPrivate *priv;
+
+	priv = TRACKER_EXTRACT_DECORATOR (decorator)->priv;
+
+	tracker_extract_dbus_statistics_complete_get_module_statistics (iface, invocation,
+	                                                                tracker_extract_get_statistics (priv->extractor));
+
+	return TRUE;
+}
+
 static void
 tracker_extract_decorator_class_init (TrackerExtractDecoratorClass *klass)
 {
@@ -606,6 +817,9 @@ tracker_extract_decorator_init (TrackerExtractDecorator *decorator)
 	TrackerExtractDecoratorPrivate *priv;
 
 	decorator->priv = priv = TRACKER_EXTRACT_DECORATOR_GET_PRIVATE (decorator);
+	priv->max_extracting_files = MIN_EXTRACTING_FILES;
+	priv->extracting_files_ceiling = MIN_EXTRACTING_FILES;
+	priv->next_batch = g_ptr_array_new ();
 	priv->recovery_files = g_hash_table_new_full (g_str_hash, g_str_equal,
 	                                              (GDestroyNotify) g_free,
 	                                              (GDestroyNotify) g_object_unref);
@@ -640,6 +854,11 @@ tracker_extract_decorator_initable_init (GInitable     *initable,
 	tracker_extract_dbus_priority_set_supported_rdf_types (priv->iface,
 	                                                       supported_classes);
 
+	priv->statistics_iface = tracker_extract_dbus_statistics_skeleton_new ();
+	g_signal_connect (priv->statistics_iface, "handle-get-module-statistics",
+	                  G_CALLBACK (handle_get_module_statistics_cb),
+	                  decorator);
+
 	conn = g_bus_get_sync (TRACKER_IPC_BUS, NULL, error);
 	if (conn == NULL) {
 		ret = FALSE;
@@ -654,6 +873,14 @@ tracker_extract_decorator_initable_init (GInitable     *initable,
 		goto out;
 	}
 
+	if (!g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (priv->statistics_iface),
+	                                       conn,
+	                                       "/org/freedesktop/Tracker1/Extract/Statistics",
+	                                       error)) {
+		ret = FALSE;
+		goto out;
+	}
+
 	/* Chainup to parent's init last, to have a chance to export our
 	 * DBus interface before RequestName returns. Otherwise our iface
 	 * won't be ready by the time the tracker-extract appear on the bus. */
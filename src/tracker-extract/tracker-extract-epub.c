@@ -531,7 +531,7 @@ content_xml_text_handler (GMarkupParseContext   *context,
 }
 
 static gchar *
-extract_opf_path (const gchar *uri)
+extract_opf_path (TrackerGsfArchive *archive)
 {
 	GMarkupParseContext *context;
 	gchar *path = NULL;
@@ -547,7 +547,7 @@ extract_opf_path (const gchar *uri)
 	/* Load the internal container file from the Zip archive,
 	 * and parse it to extract the .opf file to get metadata from
 	 */
-	tracker_gsf_parse_xml_in_zip (uri, "META-INF/container.xml", context, &error);
+	tracker_gsf_archive_parse_xml (archive, "META-INF/container.xml", context, &error);
 	g_markup_parse_context_free (context);
 
 	if (error || !path) {
@@ -561,9 +561,9 @@ extract_opf_path (const gchar *uri)
 }
 
 static gchar *
-extract_opf_contents (const gchar *uri,
-                      const gchar *content_prefix,
-                      GList       *content_files)
+extract_opf_contents (TrackerGsfArchive *archive,
+                      const gchar       *content_prefix,
+                      GList             *content_files)
 {
 	OPFContentData content_data = { 0 };
 	TrackerConfig *config;
@@ -590,7 +590,7 @@ extract_opf_contents (const gchar *uri,
 
 		/* Page file is relative to OPF file location */
 		path = g_build_filename (content_prefix, l->data, NULL);
-		tracker_gsf_parse_xml_in_zip (uri, path, context, &error);
+		tracker_gsf_archive_parse_xml (archive, path, context, &error);
 
 		if (error) {
 			g_warning ("Error extracting EPUB contents (%s): %s",
@@ -611,7 +611,8 @@ extract_opf_contents (const gchar *uri,
 }
 
 static TrackerResource *
-extract_opf (const gchar          *uri,
+extract_opf (TrackerGsfArchive    *archive,
+             const gchar          *uri,
              const gchar          *opf_path)
 {
 	TrackerResource *ebook;
@@ -639,7 +640,7 @@ extract_opf (const gchar          *uri,
 	/* Load the internal container file from the Zip archive,
 	 * and parse it to extract the .opf file to get metadata from
 	 */
-	tracker_gsf_parse_xml_in_zip (uri, opf_path, context, &error);
+	tracker_gsf_archive_parse_xml (archive, opf_path, context, &error);
 	g_markup_parse_context_free (context);
 
 	if (error) {
@@ -652,7 +653,7 @@ extract_opf (const gchar          *uri,
 	}
 
 	dirname = g_path_get_dirname (opf_path);
-	contents = extract_opf_contents (uri, dirname, data->pages);
+	contents = extract_opf_contents (archive, dirname, data->pages);
 	g_free (dirname);
 
 	if (contents && *contents) {
@@ -668,6 +669,7 @@ extract_opf (const gchar          *uri,
 G_MODULE_EXPORT gboolean
 tracker_extract_get_metadata (TrackerExtractInfo *info)
 {
+	TrackerGsfArchive *archive;
 	TrackerResource *ebook;
 	gchar *opf_path, *uri;
 	GFile *file;
@@ -675,14 +677,24 @@ tracker_extract_get_metadata (TrackerExtractInfo *info)
 	file = tracker_extract_info_get_file (info);
 	uri = g_file_get_uri (file);
 
-	opf_path = extract_opf_path (uri);
+	/* Open the archive once for all the files parsed from it */
+	archive = tracker_gsf_archive_open (uri);
+
+	if (!archive) {
+		g_free (uri);
+		return FALSE;
+	}
+
+	opf_path = extract_opf_path (archive);
 
 	if (!opf_path) {
+		tracker_gsf_archive_free (archive);
 		g_free (uri);
 		return FALSE;
 	}
 
-	ebook = extract_opf (uri, opf_path);
+	ebook = extract_opf (archive, uri, opf_path);
+	tracker_gsf_archive_free (archive);
 	g_free (opf_path);
 	g_free (uri);
 
@@ -110,10 +110,10 @@ read_metadata (GifFileType          *gifFile,
 	GifRecordType RecordType;
 	int frameheight;
 	int framewidth;
-	unsigned char *framedata = NULL;
+	int codesize;
+	GifByteType *codeblock;
 	GPtrArray *keywords;
 	guint i;
-	gint h;
 	int status;
 	MergeData md = { 0 };
 	GifData   gd = { 0 };
@@ -147,26 +147,32 @@ read_metadata (GifFileType          *gifFile,
 			framewidth  = gifFile->Image.Width;
 			frameheight = gifFile->Image.Height;
 
-			framedata = g_malloc_n (framewidth, sizeof(GifPixelType));
-			for (h = 0; h < frameheight; h++)
-			{
-				if (DGifGetLine(gifFile, framedata, framewidth)==GIF_ERROR) {
-					g_free (framedata);
+			/* Hop over the compressed image data one sub-block
+			 * at a time, there's nothing to extract from pixels.
+			 */
+			status = DGifGetCode (gifFile, &codesize, &codeblock);
+
+			while (status == GIF_OK && codeblock != NULL) {
+				status = DGifGetCodeNext (gifFile, &codeblock);
+			}
+
+			if (status == GIF_ERROR) {
 #if GIFLIB_MAJOR < 5
-					print_gif_error();
+				print_gif_error();
 #else  /* GIFLIB_MAJOR < 5 */
-					gif_error ("Could not load a block of GIF pixes", gifFile->Error);
+				gif_error ("Could not skip a block of GIF pixels", gifFile->Error);
 #endif /* GIFLIB_MAJOR < 5 */
-					return NULL;
-				}
+				g_free (gd.width);
+				g_free (gd.height);
+				g_free (gd.comment);
+				return NULL;
 			}
 
+			g_free (gd.width);
+			g_free (gd.height);
 			gd.width  = g_strdup_printf ("%d", framewidth);
 			gd.height = g_strdup_printf ("%d", frameheight);
 
-
-			g_free (framedata);
-
 		break;
 		case EXTENSION_RECORD_TYPE:
 			extBlock.bytes = NULL;
@@ -25,11 +25,15 @@
 #include <glib.h>
 
 #include <libxml/HTMLparser.h>
+#include <libtracker-miners-common/tracker-file-utils.h>
 #include <libtracker-miners-common/tracker-utils.h>
 #include <libtracker-extract/tracker-extract.h>
 
 #include "tracker-main.h"
 
+/* Size of the chunks fed to the parser */
+#define HTML_BUFFER_SIZE 8192 /* bytes */
+
 typedef enum {
 	READ_TITLE,
 	READ_IGNORE
@@ -41,11 +45,25 @@ typedef struct {
 	guint in_body : 1;
 	guint has_license : 1;
 	guint has_description : 1;
+	guint done : 1;
 	GString *title;
 	GString *plain_text;
 	guint n_bytes_remaining;
+	htmlParserCtxtPtr context;
 } parser_data;
 
+/* Once in the body, head metadata is complete, so parsing
+ * is over as soon as there is no room left for text.
+ */
+static void
+parser_check_done (parser_data *pd)
+{
+	if (pd->in_body && pd->n_bytes_remaining == 0 && !pd->done) {
+		pd->done = TRUE;
+		xmlStopParser (pd->context);
+	}
+}
+
 static gboolean
 has_attribute (const gchar **attrs,
                const gchar  *attr,
@@ -167,6 +185,7 @@ parser_start_element (void           *data,
 		}
 	} else if (g_ascii_strcasecmp (name, "body") == 0) {
 		pd->in_body = TRUE;
+		parser_check_done (pd);
 	} else if (g_ascii_strcasecmp (name, "script") == 0) {
 		/* Ignore javascript and such */
 		pd->current = READ_IGNORE;
@@ -222,6 +241,7 @@ parser_characters (void          *data,
 				pd->n_bytes_remaining -= text_len;
 			} else {
 				pd->n_bytes_remaining = 0;
+				parser_check_done (pd);
 			}
 		}
 		break;
@@ -234,9 +254,12 @@ tracker_extract_get_metadata (TrackerExtractInfo *info)
 	TrackerResource *metadata;
 	GFile *file;
 	TrackerConfig *config;
-	htmlDocPtr doc;
-	parser_data pd;
+	htmlParserCtxtPtr context;
+	parser_data pd = { 0 };
+	gchar buf[HTML_BUFFER_SIZE];
 	gchar *filename;
+	FILE *f;
+	gsize len;
 	xmlSAXHandler handler = {
 		NULL, /* internalSubset */
 		NULL, /* isStandalone */
@@ -286,14 +309,40 @@ tracker_extract_get_metadata (TrackerExtractInfo *info)
 	config = tracker_main_get_config ();
 	pd.n_bytes_remaining = tracker_config_get_max_bytes (config);
 
+	/* Feed the file in chunks to a push parser, so nothing is
+	 * read past the point where all we want is extracted.
+	 */
 	filename = g_file_get_path (file);
-	doc = htmlSAXParseFile (filename, NULL, &handler, &pd);
-	g_free (filename);
+	f = tracker_file_open (filename);
+
+	if (f) {
+		len = fread (buf, 1, sizeof (buf), f);
+		context = htmlCreatePushParserCtxt (&handler, &pd, buf, len,
+		                                    filename, XML_CHAR_ENCODING_NONE);
+		pd.context = context;
+
+		if (context) {
+			while (!pd.done &&
+			       (len = fread (buf, 1, sizeof (buf), f)) > 0) {
+				htmlParseChunk (context, buf, len, 0);
+			}
 
-	if (doc) {
-		xmlFreeDoc (doc);
+			if (!pd.done) {
+				htmlParseChunk (context, NULL, 0, 1);
+			}
+
+			if (context->myDoc) {
+				xmlFreeDoc (context->myDoc);
+			}
+
+			htmlFreeParserCtxt (context);
+		}
+
+		tracker_file_close (f, FALSE);
 	}
 
+	g_free (filename);
+
 	g_strstrip (pd.plain_text->str);
 	g_strstrip (pd.title->str);
 
@@ -70,6 +70,7 @@ typedef enum {
 typedef struct {
 	/* Common constant stuff */
 	const gchar *uri;
+	TrackerGsfArchive *archive;
 	MsOfficeXMLFileType file_type;
 
 	/* Tag type, reused by Content and Metadata parsers */
@@ -92,8 +93,9 @@ typedef struct {
 	gboolean generator_already_set;
 
 	/* Content-parsing specific things */
-	GString *content;
-	gulong bytes_pending;
+	TrackerTextNormalizer *content;
+	gulong max_bytes;
+	gboolean content_full;
 	gboolean style_element_present;
 	gboolean preserve_attribute_present;
 	GTimer *timer;
@@ -283,6 +285,18 @@ msoffice_xml_content_parse_stop (GMarkupParseContext  *context,
 	info->tag_type = MS_OFFICE_XML_TAG_INVALID;
 }
 
+static void
+msoffice_xml_content_append (MsOfficeXMLParserInfo *info,
+                             const gchar           *text,
+                             gsize                  text_len)
+{
+	/* A whitespace is added to separate next strings appended */
+	if (!tracker_text_normalizer_feed (info->content, text, text_len) ||
+	    !tracker_text_normalizer_feed (info->content, " ", 1)) {
+		info->content_full = TRUE;
+	}
+}
+
 static void
 msoffice_xml_content_parse (GMarkupParseContext  *context,
                             const gchar          *text,
@@ -291,10 +305,9 @@ msoffice_xml_content_parse (GMarkupParseContext  *context,
                             GError              **error)
 {
 	MsOfficeXMLParserInfo *info = user_data;
-	gsize written_bytes = 0;
 
 	/* If reached max bytes to extract, just return */
-	if (info->bytes_pending == 0) {
+	if (info->content_full) {
 		g_set_error_literal (error,
 		                     maximum_size_error_quark,
 		                     0,
@@ -304,36 +317,18 @@ msoffice_xml_content_parse (GMarkupParseContext  *context,
 
 	/* Create content string if not already done before */
 	if (G_UNLIKELY (info->content == NULL)) {
-		info->content =	g_string_new ("");
+		info->content =	tracker_text_normalizer_new (info->max_bytes, 0);
 	}
 
 	switch (info->tag_type) {
 	case MS_OFFICE_XML_TAG_WORD_TEXT:
-		tracker_text_validate_utf8 (text,
-		                            MIN (text_len, info->bytes_pending),
-		                            &info->content,
-		                            &written_bytes);
-		g_string_append_c (info->content, ' ');
-		info->bytes_pending -= written_bytes;
-		break;
-
 	case MS_OFFICE_XML_TAG_SLIDE_TEXT:
-		tracker_text_validate_utf8 (text,
-		                            MIN (text_len, info->bytes_pending),
-		                            &info->content,
-		                            &written_bytes);
-		g_string_append_c (info->content, ' ');
-		info->bytes_pending -= written_bytes;
+		msoffice_xml_content_append (info, text, text_len);
 		break;
 
 	case MS_OFFICE_XML_TAG_XLS_SHARED_TEXT:
 		if (atoi (text) == 0)  {
-			tracker_text_validate_utf8 (text,
-			                            MIN (text_len, info->bytes_pending),
-			                            &info->content,
-			                            &written_bytes);
-			g_string_append_c (info->content, ' ');
-			info->bytes_pending -= written_bytes;
+			msoffice_xml_content_append (info, text, text_len);
 		}
 		break;
 
@@ -626,10 +621,10 @@ xml_read (MsOfficeXMLParserInfo *parser_info,
 
 		/* Load the internal XML file from the Zip archive, and parse it
 		 * using the given context */
-		tracker_gsf_parse_xml_in_zip (parser_info->uri,
-		                              xml_filename,
-		                              context,
-		                              &error);
+		tracker_gsf_archive_parse_xml (parser_info->archive,
+		                               xml_filename,
+		                               context,
+		                               &error);
 		g_markup_parse_context_free (context);
 
 		if (error) {
@@ -794,7 +789,7 @@ extract_content (MsOfficeXMLParserInfo *info)
 
 		part_name = parts->data;
 		/* If reached max bytes to extract, don't event start parsing the file... just return */
-		if (info->bytes_pending == 0) {
+		if (info->content_full) {
 			g_debug ("Skipping '%s' as already reached max bytes to extract",
 			         part_name);
 			break;
@@ -848,7 +843,8 @@ tracker_extract_get_metadata (TrackerExtractInfo *extract_info)
 	info.content = NULL;
 	info.title_already_set = FALSE;
 	info.generator_already_set = FALSE;
-	info.bytes_pending = tracker_config_get_max_bytes (config);
+	info.max_bytes = tracker_config_get_max_bytes (config);
+	info.content_full = info.max_bytes == 0;
 
 	/* Create content-type parser context */
 	context = g_markup_parse_context_new (&content_types_parser,
@@ -857,25 +853,32 @@ tracker_extract_get_metadata (TrackerExtractInfo *extract_info)
 	                                      NULL);
 
 	info.timer = g_timer_new ();
-	/* Load the internal XML file from the Zip archive, and parse it
-	 * using the given context */
-	tracker_gsf_parse_xml_in_zip (uri,
-	                              "[Content_Types].xml",
-	                              context,
-	                              &error);
-	if (error) {
-		g_debug ("Parsing the content-types file gave an error: '%s'",
-		         error->message);
-		g_error_free (error);
-	}
 
-	extract_content (&info);
+	/* All parts are read from the same archive, open it once */
+	info.archive = tracker_gsf_archive_open (uri);
+
+	if (info.archive) {
+		/* Load the internal XML file from the Zip archive, and parse it
+		 * using the given context */
+		tracker_gsf_archive_parse_xml (info.archive,
+		                               "[Content_Types].xml",
+		                               context,
+		                               &error);
+		if (error) {
+			g_debug ("Parsing the content-types file gave an error: '%s'",
+			         error->message);
+			g_error_free (error);
+		}
+
+		extract_content (&info);
+		tracker_gsf_archive_free (info.archive);
+	}
 
 	/* If we got any content, add it */
 	if (info.content) {
 		gchar *content;
 
-		content = g_string_free (info.content, FALSE);
+		content = tracker_text_normalizer_finish (info.content, NULL);
 		info.content = NULL;
 
 		if (content) {
@@ -378,15 +378,15 @@ read_32bit (const guint8 *buffer)
  *  in UTF-16 otherwise.
  * @param p_bytes_remaining Pointer to #gsize specifying how many bytes
  *  should still be considered.
- * @param p_content Pointer to a #GString where the output normalized words
+ * @param content #TrackerTextNormalizer where the output normalized words
  *  will be appended.
  */
 static void
-msoffice_convert_and_normalize_chunk (guint8    *buffer,
-                                      gsize      chunk_size,
-                                      gboolean   is_ansi,
-                                      gsize     *bytes_remaining,
-                                      GString  **content)
+msoffice_convert_and_normalize_chunk (guint8                *buffer,
+                                      gsize                  chunk_size,
+                                      gboolean               is_ansi,
+                                      gsize                 *bytes_remaining,
+                                      TrackerTextNormalizer *content)
 {
 	gsize n_bytes_utf8;
 	gchar *converted_text;
@@ -416,16 +416,17 @@ msoffice_convert_and_normalize_chunk (guint8    *buffer,
 
 		len_to_validate = MIN (*bytes_remaining, n_bytes_utf8);
 
-		if (tracker_text_validate_utf8 (converted_text,
-		                                len_to_validate,
-		                                content,
-		                                NULL)) {
-			/* A whitespace is added to separate next strings appended */
-			g_string_append_c (*content, ' ');
+		/* A whitespace is added to separate next strings appended */
+		if (tracker_text_normalizer_feed (content,
+		                                  converted_text,
+		                                  len_to_validate) &&
+		    tracker_text_normalizer_feed (content, " ", 1)) {
+			/* Update accumulated UTF-8 bytes read */
+			*bytes_remaining -= len_to_validate;
+		} else {
+			/* Normalized text is full, stop reading */
+			*bytes_remaining = 0;
 		}
-
-		/* Update accumulated UTF-8 bytes read */
-		*bytes_remaining -= len_to_validate;
 		g_free (converted_text);
 	} else {
 		g_warning ("Couldn't convert %" G_GSIZE_FORMAT " bytes from %s to UTF-8: %s",
@@ -623,7 +624,7 @@ extract_powerpoint_content (GsfInfile *infile,
 {
 	/* Try to find Powerpoint Document stream */
 	GsfInput *stream;
-	GString *all_texts = NULL;
+	TrackerTextNormalizer *all_texts = NULL;
 	gsf_off_t last_document_container;
 
 	/* If no content requested, return */
@@ -700,6 +701,8 @@ extract_powerpoint_content (GsfInfile *infile,
 		guint8 *buffer = NULL;
 		gsize buffer_size = 0;
 
+		all_texts = tracker_text_normalizer_new (max_bytes, 0);
+
 		/*
 		 * Read while we have either TextBytesAtom or
 		 * TextCharsAtom and we have read less than max_bytes
@@ -725,7 +728,7 @@ extract_powerpoint_content (GsfInfile *infile,
 				                                      read_size,
 				                                      FALSE, /* Always UTF-16 */
 				                                      &bytes_remaining,
-				                                      &all_texts);
+				                                      all_texts);
 			}
 		}
 
@@ -734,7 +737,7 @@ extract_powerpoint_content (GsfInfile *infile,
 
 	g_object_unref (stream);
 
-	return all_texts ? g_string_free (all_texts, FALSE) : NULL;
+	return all_texts ? tracker_text_normalizer_finish (all_texts, NULL) : NULL;
 }
 
 static GsfInfile *
@@ -780,7 +783,7 @@ extract_msword_content (GsfInfile *infile,
 	gint lcb_piece_table;
 	gint piece_count = 0;
 	gint32 fc;
-	GString *content = NULL;
+	TrackerTextNormalizer *content = NULL;
 	guint8 *text_buffer = NULL;
 	gint text_buffer_size = 0;
 	gsize n_bytes_remaining;
@@ -883,6 +886,8 @@ extract_msword_content (GsfInfile *infile,
 	 */
 	i = 0;
 	n_bytes_remaining = n_bytes;
+	content = tracker_text_normalizer_new (n_bytes, 0);
+
 	while (n_bytes_remaining > 0 &&
 	       i < piece_count) {
 		guint8 *piece_descriptor;
@@ -947,7 +952,7 @@ extract_msword_content (GsfInfile *infile,
 			                                      piece_size,
 			                                      is_ansi,
 			                                      &n_bytes_remaining,
-			                                      &content);
+			                                      content);
 		}
 
 		/* Go on to next piece */
@@ -959,7 +964,7 @@ extract_msword_content (GsfInfile *infile,
 	g_object_unref (table_stream);
 	g_free (clx);
 
-	return content ? g_string_free (content, FALSE) : NULL;
+	return tracker_text_normalizer_finish (content, NULL);
 }
 
 /* Reads and interprets the flags of a given string. May be
@@ -1229,10 +1234,10 @@ read_excel_string (GsfInput *stream,
  * only if fExtSt is 0x1.
  */
 static void
-xls_get_extended_record_string (GsfInput  *stream,
-                                GArray    *list,
-                                gsize     *p_bytes_remaining,
-                                GString  **p_content)
+xls_get_extended_record_string (GsfInput              *stream,
+                                GArray                *list,
+                                gsize                 *p_bytes_remaining,
+                                TrackerTextNormalizer *content)
 {
 	ExcelExtendedStringRecord *record;
 	guint32 cst_unique;
@@ -1330,7 +1335,7 @@ xls_get_extended_record_string (GsfInput  *stream,
 		                                      chunk_size,
 		                                      !is_high_byte,
 		                                      p_bytes_remaining,
-		                                      p_content);
+		                                      content);
 
 		/* Formatting string */
 		if (c_run > 0) {
@@ -1410,7 +1415,7 @@ extract_excel_content (GsfInfile *infile,
                        gboolean  *is_encrypted)
 {
 	ExcelBiffHeader header1;
-	GString *content = NULL;
+	TrackerTextNormalizer *content;
 	GsfInput *stream;
 	guint saved_offset;
 	gsize n_bytes_remaining = n_bytes;
@@ -1426,6 +1431,8 @@ extract_excel_content (GsfInfile *infile,
 		return NULL;
 	}
 
+	content = tracker_text_normalizer_new (n_bytes, 0);
+
 	/* Read until we reach eof or any of our limits reached */
 	while (n_bytes_remaining > 0 &&
 	       !gsf_input_eof (stream)) {
@@ -1511,7 +1518,7 @@ extract_excel_content (GsfInfile *infile,
 			xls_get_extended_record_string (stream,
 			                                list,
 			                                &n_bytes_remaining,
-			                                &content);
+			                                content);
 
 			g_array_unref (list);
 
@@ -1531,7 +1538,7 @@ extract_excel_content (GsfInfile *infile,
 	g_debug ("Bytes extracted: %" G_GSIZE_FORMAT,
 	         n_bytes - n_bytes_remaining);
 
-	return content ? g_string_free (content, FALSE) : NULL;
+	return tracker_text_normalizer_finish (content, NULL);
 }
 
 /**
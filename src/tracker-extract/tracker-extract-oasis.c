@@ -71,8 +71,7 @@ typedef struct {
 typedef struct {
 	ODTTagType current;
 	ODTFileType file_type;
-	GString *content;
-	gulong bytes_pending;
+	TrackerTextNormalizer *content;
 } ODTContentParseInfo;
 
 GQuark maximum_size_error_quark = 0;
@@ -107,16 +106,16 @@ static void xml_text_handler_content           (GMarkupParseContext   *context,
                                                 gsize                  text_len,
                                                 gpointer               user_data,
                                                 GError               **error);
-static void extract_oasis_content              (const gchar           *uri,
+static void extract_oasis_content              (TrackerGsfArchive     *archive,
                                                 gulong                 total_bytes,
                                                 ODTFileType            file_type,
                                                 TrackerResource       *metadata);
 
 static void
-extract_oasis_content (const gchar     *uri,
-                       gulong           total_bytes,
-                       ODTFileType      file_type,
-                       TrackerResource *metadata)
+extract_oasis_content (TrackerGsfArchive *archive,
+                       gulong             total_bytes,
+                       ODTFileType        file_type,
+                       TrackerResource   *metadata)
 {
 	gchar *content = NULL;
 	ODTContentParseInfo info;
@@ -138,22 +137,24 @@ extract_oasis_content (const gchar     *uri,
 	/* Create parse info */
 	info.current = ODT_TAG_TYPE_UNKNOWN;
 	info.file_type = file_type;
-	info.content = g_string_new ("");
-	info.bytes_pending = total_bytes;
+	info.content = tracker_text_normalizer_new (total_bytes, 0);
 
 	/* Create parsing context */
 	context = g_markup_parse_context_new (&parser, 0, &info, NULL);
 
 	/* Load the internal XML file from the Zip archive, and parse it
 	 * using the given context */
-	tracker_gsf_parse_xml_in_zip (uri, "content.xml", context, &error);
+	tracker_gsf_archive_parse_xml (archive, "content.xml", context, &error);
 
 	if (!error || g_error_matches (error, maximum_size_error_quark, 0)) {
-		content = g_string_free (info.content, FALSE);
-		tracker_resource_set_string (metadata, "nie:plainTextContent", content);
+		content = tracker_text_normalizer_finish (info.content, NULL);
+
+		if (content) {
+			tracker_resource_set_string (metadata, "nie:plainTextContent", content);
+		}
 	} else {
 		g_warning ("Got error parsing XML file: %s\n", error->message);
-		g_string_free (info.content, TRUE);
+		tracker_text_normalizer_free (info.content);
 	}
 
 	if (error) {
@@ -167,6 +168,7 @@ extract_oasis_content (const gchar     *uri,
 G_MODULE_EXPORT gboolean
 tracker_extract_get_metadata (TrackerExtractInfo *extract_info)
 {
+	TrackerGsfArchive *archive;
 	TrackerResource *metadata;
 	TrackerConfig *config;
 	ODTMetadataParseInfo info = { 0 };
@@ -207,13 +209,18 @@ tracker_extract_get_metadata (TrackerExtractInfo *extract_info)
 	info.current = ODT_TAG_TYPE_UNKNOWN;
 	info.uri = uri;
 
-	/* Create parsing context */
-	context = g_markup_parse_context_new (&parser, 0, &info, NULL);
+	/* Both meta.xml and content.xml are read from the same archive */
+	archive = tracker_gsf_archive_open (uri);
 
-	/* Load the internal XML file from the Zip archive, and parse it
-	 * using the given context */
-	tracker_gsf_parse_xml_in_zip (uri, "meta.xml", context, NULL);
-	g_markup_parse_context_free (context);
+	if (archive) {
+		/* Create parsing context */
+		context = g_markup_parse_context_new (&parser, 0, &info, NULL);
+
+		/* Load the internal XML file from the Zip archive, and parse it
+		 * using the given context */
+		tracker_gsf_archive_parse_xml (archive, "meta.xml", context, NULL);
+		g_markup_parse_context_free (context);
+	}
 
 	if (g_ascii_strcasecmp (mime_used, "application/vnd.oasis.opendocument.text") == 0) {
 		file_type = FILE_TYPE_ODT;
@@ -229,10 +236,13 @@ tracker_extract_get_metadata (TrackerExtractInfo *extract_info)
 	}
 
 	/* Extract content with the given limitations */
-	extract_oasis_content (uri,
-	                       tracker_config_get_max_bytes (config),
-	                       file_type,
-	                       metadata);
+	if (archive) {
+		extract_oasis_content (archive,
+		                       tracker_config_get_max_bytes (config),
+		                       file_type,
+		                       metadata);
+		tracker_gsf_archive_free (archive);
+	}
 
 	g_free (uri);
 
@@ -498,33 +508,19 @@ xml_text_handler_content (GMarkupParseContext  *context,
                           GError              **error)
 {
 	ODTContentParseInfo *data = user_data;
-	gsize written_bytes = 0;
 
 	switch (data->current) {
 	case ODT_TAG_TYPE_WORD_TEXT:
 	case ODT_TAG_TYPE_SLIDE_TEXT:
 	case ODT_TAG_TYPE_SPREADSHEET_TEXT:
 	case ODT_TAG_TYPE_GRAPHICS_TEXT:
-		if (data->bytes_pending == 0) {
+		/* Text nodes are separated by whitespace */
+		if (!tracker_text_normalizer_feed (data->content, text, text_len) ||
+		    !tracker_text_normalizer_feed (data->content, " ", 1)) {
 			g_set_error_literal (error,
 			                     maximum_size_error_quark, 0,
 			                     "Maximum text limit reached");
-			break;
 		}
-
-		/* Look for valid UTF-8 text */
-		if (tracker_text_validate_utf8 (text,
-		                                MIN (text_len, data->bytes_pending),
-		                                &data->content,
-		                                &written_bytes)) {
-			if (data->content->str[data->content->len - 1] != ' ') {
-				/* If some bytes found to be valid, append an extra whitespace
-				 * as separator */
-				g_string_append_c (data->content, ' ');
-			}
-		}
-
-		data->bytes_pending -= written_bytes;
 		break;
 
 	default:
@@ -21,7 +21,6 @@
 
 #include "config.h"
 
-#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/select.h>
@@ -196,21 +195,26 @@ static gchar *
 extract_content_text (PopplerDocument *document,
                       gsize            n_bytes)
 {
-	GString *string;
+	TrackerTextNormalizer *normalizer;
 	GTimer *timer;
-	gsize remaining_bytes;
+	gboolean full = FALSE;
+	gchar *content;
+	gsize content_len = 0;
 	gint n_pages, i;
 	gdouble elapsed;
 
+	if (n_bytes == 0) {
+		return NULL;
+	}
+
 	n_pages = poppler_document_get_n_pages (document);
-	string = g_string_new ("");
+	normalizer = tracker_text_normalizer_new (n_bytes, 0);
 	timer = g_timer_new ();
 
-	for (i = 0, remaining_bytes = n_bytes, elapsed = g_timer_elapsed (timer, NULL);
-	     i < n_pages && remaining_bytes > 0 && elapsed < EXTRACTION_PROCESS_TIMEOUT;
+	for (i = 0, elapsed = g_timer_elapsed (timer, NULL);
+	     i < n_pages && !full && elapsed < EXTRACTION_PROCESS_TIMEOUT;
 	     i++, elapsed = g_timer_elapsed (timer, NULL)) {
 		PopplerPage *page;
-		gsize written_bytes = 0;
 		gchar *text;
 
 		page = poppler_document_get_page (document, i);
@@ -221,18 +225,13 @@ extract_content_text (PopplerDocument *document,
 			continue;
 		}
 
-		if (tracker_text_validate_utf8 (text,
-		                                MIN (strlen (text), remaining_bytes),
-		                                &string,
-		                                &written_bytes)) {
-			g_string_append_c (string, ' ');
-		}
-
-		remaining_bytes -= written_bytes;
+		/* Pages are separated by whitespace, and only the
+		 * normalized text is kept from one page to the next */
+		full = (!tracker_text_normalizer_feed (normalizer, text, -1) ||
+		        !tracker_text_normalizer_feed (normalizer, " ", 1));
 
-		g_debug ("Extracted %" G_GSIZE_FORMAT " bytes from page %d, "
-		         "%" G_GSIZE_FORMAT " bytes remaining",
-		         written_bytes, i, remaining_bytes);
+		g_debug ("Extracted text from page %d%s",
+		         i, full ? ", maximum size reached" : "");
 
 		g_free (text);
 		g_object_unref (page);
@@ -242,16 +241,18 @@ extract_content_text (PopplerDocument *document,
 		g_debug ("Extraction timed out, %d seconds reached", EXTRACTION_PROCESS_TIMEOUT);
 	}
 
+	content = tracker_text_normalizer_finish (normalizer, &content_len);
+
 	g_debug ("Content extraction finished: %d/%d pages indexed in %2.2f seconds, "
 	         "%" G_GSIZE_FORMAT " bytes extracted",
 	         i,
 	         n_pages,
 	         g_timer_elapsed (timer, NULL),
-	         (n_bytes - remaining_bytes));
+	         content_len);
 
 	g_timer_destroy (timer);
 
-	return g_string_free (string, FALSE);
+	return content;
 }
 
 static void
@@ -299,54 +300,27 @@ tracker_extract_get_metadata (TrackerExtractInfo *info)
 	GPtrArray *keywords;
 	guint i;
 	GFile *file;
-	gchar *filename;
-	int fd;
-	gchar *contents = NULL;
+	GBytes *contents;
 	gsize len;
-	struct stat st;
 
 	file = tracker_extract_info_get_file (info);
-	filename = g_file_get_path (file);
-
-	fd = tracker_file_open_fd (filename);
+	uri = g_file_get_uri (file);
+	contents = tracker_extract_info_get_contents (info, &error);
 
-	if (fd == -1) {
-		g_warning ("Could not open pdf file '%s': %s\n",
-		           filename,
-		           g_strerror (errno));
-		g_free (filename);
+	if (!contents) {
+		g_warning ("Could not map pdf file '%s': %s\n",
+		           uri,
+		           error->message);
+		g_error_free (error);
+		g_free (uri);
 		return FALSE;
 	}
 
-	if (fstat (fd, &st) == -1) {
-		g_warning ("Could not fstat pdf file '%s': %s\n",
-		           filename,
-		           g_strerror (errno));
-		close (fd);
-		g_free (filename);
-		return FALSE;
-	}
-
-	if (st.st_size == 0) {
-		contents = NULL;
-		len = 0;
-	} else {
-		contents = (gchar *) mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-		if (contents == NULL || contents == MAP_FAILED) {
-			g_warning ("Could not mmap pdf file '%s': %s\n",
-			           filename,
-			           g_strerror (errno));
-			close (fd);
-			g_free (filename);
-			return FALSE;
-		}
-		len = st.st_size;
-	}
-
-	g_free (filename);
-	uri = g_file_get_uri (file);
-
-	document = poppler_document_new_from_data (contents, len, NULL, &error);
+	/* Poppler doesn't modify the data, the mapping is shared
+	 * with any other module handling the file afterwards.
+	 */
+	document = poppler_document_new_from_data ((gchar *) g_bytes_get_data (contents, &len),
+	                                           len, NULL, &error);
 
 	if (error) {
 		if (error->code == POPPLER_ERROR_ENCRYPTED) {
@@ -360,7 +334,7 @@ tracker_extract_get_metadata (TrackerExtractInfo *info)
 
 			g_error_free (error);
 			g_free (uri);
-			close (fd);
+			g_bytes_unref (contents);
 
 			return TRUE;
 		} else {
@@ -370,7 +344,7 @@ tracker_extract_get_metadata (TrackerExtractInfo *info)
 
 			g_error_free (error);
 			g_free (uri);
-			close (fd);
+			g_bytes_unref (contents);
 
 			return FALSE;
 		}
@@ -381,7 +355,7 @@ tracker_extract_get_metadata (TrackerExtractInfo *info)
 		           "NULL returned without an error",
 		           uri);
 		g_free (uri);
-		close (fd);
+		g_bytes_unref (contents);
 		return FALSE;
 	}
 
@@ -608,12 +582,7 @@ tracker_extract_get_metadata (TrackerExtractInfo *info)
 	g_free (uri);
 
 	g_object_unref (document);
-
-	if (contents) {
-		munmap (contents, len);
-	}
-
-	close (fd);
+	g_bytes_unref (contents);
 
 	tracker_extract_info_set_resource (info, metadata);
 	g_object_unref (metadata);
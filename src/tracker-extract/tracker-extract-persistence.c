@@ -17,24 +17,95 @@
  * Boston, MA  02110-1301, USA.
  */
 
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
 #include "tracker-extract-persistence.h"
 
 #define MAX_RETRIES 3
 
+#define JOURNAL_NAME "journal"
+
+/* Once the journal holds this many records and most of them are
+ * stale, it gets rewritten with just the files still in flight.
+ */
+#define COMPACT_THRESHOLD 1024
+
+/* Seconds to wait before syncing journal writes to disk, so that
+ * several of them share a single fsync().
+ */
+#define SYNC_INTERVAL 2
+
+typedef enum {
+	RECORD_ADD = 'A',
+	RECORD_REMOVE = 'R',
+} RecordType;
+
+/* Each journal record is this header, followed by the path */
+typedef struct {
+	guint8 type;
+	guint8 n_retries;
+	guint16 reserved;
+	guint32 path_len;
+} RecordHeader;
+
 typedef struct _TrackerExtractPersistencePrivate TrackerExtractPersistencePrivate;
 
 struct _TrackerExtractPersistencePrivate
 {
-	GFile *tmp_dir;
+	gchar *journal_path;
+	gint fd;
+
+	/* Files in flight, path -> number of retries */
+	GHashTable *files;
+
+	/* Records not yet written to the journal */
+	GByteArray *pending;
+	guint n_records;
+
+	guint sync_id;
+	gboolean needs_sync;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (TrackerExtractPersistence, tracker_extract_persistence, G_TYPE_OBJECT)
 
 static GQuark n_retries_quark = 0;
 
+static void journal_sync (TrackerExtractPersistence *persistence);
+
+static void
+tracker_extract_persistence_finalize (GObject *object)
+{
+	TrackerExtractPersistence *persistence = TRACKER_EXTRACT_PERSISTENCE (object);
+	TrackerExtractPersistencePrivate *priv;
+
+	priv = tracker_extract_persistence_get_instance_private (persistence);
+
+	journal_sync (persistence);
+
+	if (priv->fd >= 0)
+		close (priv->fd);
+
+	g_hash_table_unref (priv->files);
+	g_byte_array_unref (priv->pending);
+	g_free (priv->journal_path);
+
+	G_OBJECT_CLASS (tracker_extract_persistence_parent_class)->finalize (object);
+}
+
 static void
 tracker_extract_persistence_class_init (TrackerExtractPersistenceClass *klass)
 {
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->finalize = tracker_extract_persistence_finalize;
+
 	n_retries_quark = g_quark_from_static_string ("tracker-extract-n-retries-quark");
 }
 
@@ -56,7 +127,10 @@ tracker_extract_persistence_init (TrackerExtractPersistence *persistence)
 		g_assert_not_reached ();
 	}
 
-	priv->tmp_dir = g_file_new_for_path (tmp_path);
+	priv->journal_path = g_build_filename (tmp_path, JOURNAL_NAME, NULL);
+	priv->fd = -1;
+	priv->files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	priv->pending = g_byte_array_new ();
 	g_free (tmp_path);
 }
 
@@ -69,87 +143,215 @@ increment_n_retries (GFile *file)
 	g_object_set_qdata (G_OBJECT (file), n_retries_quark, GUINT_TO_POINTER (n_retries + 1));
 }
 
-static GFile *
-persistence_create_symlink_file (TrackerExtractPersistence *persistence,
-                                 GFile                     *file)
+static gboolean
+journal_open (TrackerExtractPersistencePrivate *priv,
+              gboolean                          truncate)
+{
+	if (priv->fd >= 0)
+		close (priv->fd);
+
+	priv->fd = g_open (priv->journal_path,
+	                   O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC |
+	                   (truncate ? O_TRUNC : 0),
+	                   0600);
+
+	if (priv->fd < 0) {
+		g_warning ("Could not open failsafe persistence journal '%s': %m",
+		           priv->journal_path);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+journal_append (TrackerExtractPersistencePrivate *priv,
+                RecordType                        type,
+                guint                             n_retries,
+                const gchar                      *path)
+{
+	RecordHeader header = { 0, };
+
+	header.type = type;
+	header.n_retries = MIN (n_retries, G_MAXUINT8);
+	header.path_len = strlen (path);
+
+	g_byte_array_append (priv->pending, (const guint8 *) &header, sizeof (header));
+	g_byte_array_append (priv->pending, (const guint8 *) path, header.path_len);
+	priv->n_records++;
+}
+
+static gboolean
+journal_sync_cb (gpointer user_data)
 {
+	TrackerExtractPersistence *persistence = user_data;
 	TrackerExtractPersistencePrivate *priv;
-	guint n_retries = GPOINTER_TO_UINT (g_object_get_qdata (G_OBJECT (file), n_retries_quark));
-	gchar *link_name, *path, *md5;
-	GFile *link_file;
 
 	priv = tracker_extract_persistence_get_instance_private (persistence);
-	path = g_file_get_path (file);
-	md5 = g_compute_checksum_for_string (G_CHECKSUM_MD5, path, -1);
-	link_name = g_strdup_printf ("%d-%s", n_retries, md5);
-	link_file = g_file_get_child (priv->tmp_dir, link_name);
+	priv->sync_id = 0;
+	journal_sync (persistence);
 
-	g_free (link_name);
-	g_free (path);
-	g_free (md5);
+	return G_SOURCE_REMOVE;
+}
+
+/* Writes out all pending records in one go. This needs to happen
+ * before a file is handed to an extractor module, if the module
+ * crashes the process the record must be in the journal already.
+ * Syncing to disk is only needed to survive system crashes, so
+ * it's done from a timeout.
+ */
+static gboolean
+journal_flush (TrackerExtractPersistence *persistence)
+{
+	TrackerExtractPersistencePrivate *priv;
+	gsize written = 0;
+
+	priv = tracker_extract_persistence_get_instance_private (persistence);
+
+	if (priv->pending->len == 0)
+		return TRUE;
+
+	if (priv->fd < 0 && !journal_open (priv, FALSE))
+		return FALSE;
+
+	while (written < priv->pending->len) {
+		gssize retval;
+
+		retval = write (priv->fd,
+		                &priv->pending->data[written],
+		                priv->pending->len - written);
+
+		if (retval < 0) {
+			if (errno == EINTR)
+				continue;
+
+			g_warning ("Could not write into failsafe persistence journal: %m");
+			g_byte_array_set_size (priv->pending, 0);
+			return FALSE;
+		}
+
+		written += retval;
+	}
 
-	return link_file;
+	g_byte_array_set_size (priv->pending, 0);
+	priv->needs_sync = TRUE;
+
+	if (priv->sync_id == 0) {
+		priv->sync_id = g_timeout_add_seconds (SYNC_INTERVAL,
+		                                       journal_sync_cb,
+		                                       persistence);
+	}
+
+	return TRUE;
 }
 
-static GFile *
-persistence_symlink_get_file (GFileInfo *info)
+static void
+journal_sync (TrackerExtractPersistence *persistence)
 {
-	const gchar *symlink_name, *symlink_target;
-	gchar *md5, **items;
-	GFile *file = NULL;
-	guint n_retries;
+	TrackerExtractPersistencePrivate *priv;
+
+	priv = tracker_extract_persistence_get_instance_private (persistence);
 
-	symlink_name = g_file_info_get_name (info);
-	symlink_target = g_file_info_get_symlink_target (info);
+	journal_flush (persistence);
 
-	if (!g_path_is_absolute (symlink_target)) {
-		g_critical ("Symlink paths must be absolute, '%s' points to '%s'",
-		            symlink_name, symlink_target);
-		return NULL;
+	if (priv->sync_id != 0) {
+		g_source_remove (priv->sync_id);
+		priv->sync_id = 0;
 	}
 
-	md5 = g_compute_checksum_for_string (G_CHECKSUM_MD5, symlink_target, -1);
-	items = g_strsplit (symlink_name, "-", 2);
-	n_retries = g_strtod (items[0], NULL);
+	if (priv->needs_sync && priv->fd >= 0 && fsync (priv->fd) != 0)
+		g_warning ("Could not sync failsafe persistence journal: %m");
 
-	if (g_strcmp0 (items[1], md5) == 0) {
-		file = g_file_new_for_path (symlink_target);
-		g_object_set_qdata (G_OBJECT (file), n_retries_quark,
-		                    GUINT_TO_POINTER (n_retries));
-	} else {
-		g_critical ("path MD5 for '%s' doesn't match with symlink '%s'",
-		            symlink_target, symlink_name);
+	priv->needs_sync = FALSE;
+}
+
+/* Rewrites the journal with one record per file in flight */
+static void
+journal_compact (TrackerExtractPersistence *persistence)
+{
+	TrackerExtractPersistencePrivate *priv;
+	GError *error = NULL;
+	GHashTableIter iter;
+	GByteArray *pending;
+	gpointer key, value;
+	guint n_records;
+
+	priv = tracker_extract_persistence_get_instance_private (persistence);
+
+	/* The new journal is built aside, records still pending must
+	 * be kept around until it is known to be written.
+	 */
+	pending = priv->pending;
+	n_records = priv->n_records;
+	priv->pending = g_byte_array_new ();
+	priv->n_records = 0;
+
+	g_hash_table_iter_init (&iter, priv->files);
+
+	while (g_hash_table_iter_next (&iter, &key, &value))
+		journal_append (priv, RECORD_ADD, GPOINTER_TO_UINT (value), key);
+
+	/* This replaces the journal atomically */
+	if (!g_file_set_contents (priv->journal_path,
+	                          (const gchar *) priv->pending->data,
+	                          priv->pending->len,
+	                          &error)) {
+		g_warning ("Could not compact failsafe persistence journal: %s",
+		           error->message);
+		g_error_free (error);
+
+		g_byte_array_unref (priv->pending);
+		priv->pending = pending;
+		priv->n_records = n_records;
+
+		if (priv->sync_id == 0) {
+			priv->sync_id = g_timeout_add_seconds (SYNC_INTERVAL,
+			                                       journal_sync_cb,
+			                                       persistence);
+		}
+
+		return;
 	}
 
-	g_strfreev (items);
-	g_free (md5);
+	g_byte_array_unref (pending);
+	g_byte_array_set_size (priv->pending, 0);
+	priv->needs_sync = FALSE;
+
+	if (priv->sync_id != 0) {
+		g_source_remove (priv->sync_id);
+		priv->sync_id = 0;
+	}
 
-	return file;
+	journal_open (priv, FALSE);
 }
 
 static gboolean
 persistence_store_file (TrackerExtractPersistence *persistence,
                         GFile                     *file)
 {
-	GError *error = NULL;
+	TrackerExtractPersistencePrivate *priv;
 	gboolean success;
-	GFile *link_file;
+	guint n_retries;
 	gchar *path;
 
-	increment_n_retries (file);
+	priv = tracker_extract_persistence_get_instance_private (persistence);
 	path = g_file_get_path (file);
-	link_file = persistence_create_symlink_file (persistence, file);
 
-	success = g_file_make_symbolic_link (link_file, path, NULL, &error);
+	if (!path)
+		return FALSE;
+
+	increment_n_retries (file);
+	n_retries = GPOINTER_TO_UINT (g_object_get_qdata (G_OBJECT (file), n_retries_quark));
+
+	journal_append (priv, RECORD_ADD, n_retries, path);
+	success = journal_flush (persistence);
 
 	if (!success) {
-		g_warning ("Could not save '%s' into failsafe persistence store: %s",
-		           path, error ? error->message : "no error given");
-		g_clear_error (&error);
+		g_warning ("Could not save '%s' into failsafe persistence store",
+		           path);
 	}
 
-	g_object_unref (link_file);
-	g_free (path);
+	g_hash_table_insert (priv->files, path, GUINT_TO_POINTER (n_retries));
 
 	return success;
 }
@@ -158,24 +360,127 @@ static gboolean
 persistence_remove_file (TrackerExtractPersistence *persistence,
                          GFile                     *file)
 {
-	GError *error = NULL;
-	GFile *link_file;
-	gboolean success;
-
-	link_file = persistence_create_symlink_file (persistence, file);
-	success = g_file_delete (link_file, NULL, &error);
+	TrackerExtractPersistencePrivate *priv;
+	gchar *path;
 
-	if (!success) {
-		gchar *path = g_file_get_path (file);
+	priv = tracker_extract_persistence_get_instance_private (persistence);
+	path = g_file_get_path (file);
 
-		g_warning ("Could not delete '%s' from failsafe persistence store",
-		           path);
+	if (!path || !g_hash_table_remove (priv->files, path)) {
 		g_free (path);
+		return FALSE;
 	}
 
-	g_object_unref (link_file);
+	/* Removals are written right away, so a crash in another
+	 * file doesn't get this one retried, only the fsync() is
+	 * left for the sync timeout.
+	 */
+	journal_append (priv, RECORD_REMOVE, 0, path);
+	g_free (path);
 
-	return success;
+	if (priv->n_records >= COMPACT_THRESHOLD &&
+	    priv->n_records >= 4 * g_hash_table_size (priv->files)) {
+		journal_compact (persistence);
+	} else {
+		journal_flush (persistence);
+	}
+
+	return TRUE;
+}
+
+/* Replays the journal, returns the files that were in flight */
+static GHashTable *
+persistence_read_journal (TrackerExtractPersistence *persistence)
+{
+	TrackerExtractPersistencePrivate *priv;
+	GHashTable *files;
+	gchar *contents, *p, *end;
+	gsize len;
+
+	priv = tracker_extract_persistence_get_instance_private (persistence);
+	files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	if (!g_file_get_contents (priv->journal_path, &contents, &len, NULL))
+		return files;
+
+	p = contents;
+	end = contents + len;
+
+	while (p < end) {
+		RecordHeader header;
+		gchar *path;
+
+		if ((gsize) (end - p) < sizeof (header)) {
+			g_debug ("Ignoring truncated record at the end of the journal");
+			break;
+		}
+
+		memcpy (&header, p, sizeof (header));
+		p += sizeof (header);
+
+		if ((gsize) (end - p) < header.path_len) {
+			g_debug ("Ignoring truncated record at the end of the journal");
+			break;
+		}
+
+		path = g_strndup (p, header.path_len);
+		p += header.path_len;
+
+		if (header.type == RECORD_ADD) {
+			g_hash_table_insert (files, path,
+			                     GUINT_TO_POINTER (header.n_retries));
+		} else if (header.type == RECORD_REMOVE) {
+			g_hash_table_remove (files, path);
+			g_free (path);
+		} else {
+			g_critical ("Unknown record type '%c' in the failsafe persistence journal",
+			            header.type);
+			g_free (path);
+			break;
+		}
+	}
+
+	g_free (contents);
+
+	return files;
+}
+
+/* Older versions kept a symlink per file in flight in the same
+ * directory, these are stale once the journal is used.
+ */
+static void
+persistence_remove_symlinks (TrackerExtractPersistence *persistence)
+{
+	TrackerExtractPersistencePrivate *priv;
+	const gchar *name;
+	gchar *dirname;
+	GDir *dir;
+
+	priv = tracker_extract_persistence_get_instance_private (persistence);
+	dirname = g_path_get_dirname (priv->journal_path);
+	dir = g_dir_open (dirname, 0, NULL);
+
+	if (!dir) {
+		g_free (dirname);
+		return;
+	}
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		gchar *path;
+
+		path = g_build_filename (dirname, name, NULL);
+
+		if (g_file_test (path, G_FILE_TEST_IS_SYMLINK) &&
+		    g_unlink (path) != 0) {
+			g_warning ("Could not remove stale persistence symlink '%s': %m",
+			           path);
+		}
+
+		g_free (path);
+	}
+
+	g_dir_close (dir);
+	g_free (dirname);
 }
 
 static void
@@ -185,41 +490,29 @@ persistence_retrieve_files (TrackerExtractPersistence *persistence,
                             gpointer                   user_data)
 {
 	TrackerExtractPersistencePrivate *priv;
-	GFileEnumerator *enumerator;
-	GFileInfo *info;
+	GHashTableIter iter;
+	GHashTable *files;
+	gpointer key, value;
 
 	priv = tracker_extract_persistence_get_instance_private (persistence);
-	enumerator = g_file_enumerate_children (priv->tmp_dir,
-	                                        G_FILE_ATTRIBUTE_STANDARD_NAME ","
-	                                        G_FILE_ATTRIBUTE_STANDARD_SYMLINK_TARGET,
-	                                        G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
-	                                        NULL, NULL);
-	if (!enumerator)
-		return;
+	files = persistence_read_journal (persistence);
 
-	while ((info = g_file_enumerator_next_file (enumerator, NULL, NULL)) != NULL) {
-		GFile *file, *symlink_file;
-		guint n_retries;
+	/* Start over with an empty journal, the files will get
+	 * probably added back soon after, and n_retries incremented.
+	 */
+	journal_open (priv, TRUE);
 
-		symlink_file = g_file_enumerator_get_child (enumerator, info);
-		file = persistence_symlink_get_file (info);
+	g_hash_table_iter_init (&iter, files);
 
-		if (!file) {
-			/* If we got here, persistence_symlink_get_file() already emitted a g_critical */
-			g_object_unref (symlink_file);
-			g_object_unref (info);
-			continue;
-		}
-
-		/* Delete the symlink, it will get probably added back soon after,
-		 * and n_retries incremented.
-		 */
-		g_file_delete (symlink_file, NULL, NULL);
-		g_object_unref (symlink_file);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		guint n_retries = GPOINTER_TO_UINT (value);
+		GFile *file;
 
-		n_retries = GPOINTER_TO_UINT (g_object_get_qdata (G_OBJECT (file), n_retries_quark));
+		file = g_file_new_for_path (key);
+		g_object_set_qdata (G_OBJECT (file), n_retries_quark,
+		                    GUINT_TO_POINTER (n_retries));
 
-		/* Trigger retry/ignore func for the symlink target */
+		/* Trigger retry/ignore func for the file */
 		if (n_retries >= MAX_RETRIES) {
 			ignore_func (file, user_data);
 		} else {
@@ -227,11 +520,9 @@ persistence_retrieve_files (TrackerExtractPersistence *persistence,
 		}
 
 		g_object_unref (file);
-		g_object_unref (info);
 	}
 
-	g_file_enumerator_close (enumerator, NULL, NULL);
-	g_object_unref (enumerator);
+	g_hash_table_unref (files);
 }
 
 TrackerExtractPersistence *
@@ -244,6 +535,7 @@ tracker_extract_persistence_initialize (TrackerFileRecoveryFunc retry_func,
 	if (!persistence) {
 		persistence = g_object_new (TRACKER_TYPE_EXTRACT_PERSISTENCE,
 		                            NULL);
+		persistence_remove_symlinks (persistence);
 		persistence_retrieve_files (persistence,
 		                            retry_func, ignore_func,
 		                            user_data);
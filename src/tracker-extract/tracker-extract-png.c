@@ -20,7 +20,10 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <png.h>
+#include <zlib.h>
 
 #include <libtracker-miners-common/tracker-file-utils.h>
 #include <libtracker-miners-common/tracker-date-time.h>
@@ -29,6 +32,21 @@
 #define RFC1123_DATE_FORMAT "%d %B %Y %H:%M:%S %z"
 #define CMS_PER_INCH        2.54
 
+#define CHUNK_TYPE(a,b,c,d) (((guint32) (a) << 24) | ((b) << 16) | ((c) << 8) | (d))
+
+#define CHUNK_IHDR CHUNK_TYPE ('I', 'H', 'D', 'R')
+#define CHUNK_IDAT CHUNK_TYPE ('I', 'D', 'A', 'T')
+#define CHUNK_IEND CHUNK_TYPE ('I', 'E', 'N', 'D')
+#define CHUNK_tEXt CHUNK_TYPE ('t', 'E', 'X', 't')
+#define CHUNK_zTXt CHUNK_TYPE ('z', 'T', 'X', 't')
+#define CHUNK_iTXt CHUNK_TYPE ('i', 'T', 'X', 't')
+#define CHUNK_eXIf CHUNK_TYPE ('e', 'X', 'I', 'f')
+
+/* Metadata chunks bigger than this are skipped, as is
+ * decompressed text going past it.
+ */
+#define MAX_METADATA_SIZE (8 * 1024 * 1024)
+
 typedef struct {
 	const gchar *title;
 	const gchar *copyright;
@@ -67,6 +85,20 @@ typedef struct {
 	const gchar *software;
 } PngData;
 
+typedef struct {
+	gchar *key;
+	gchar *text;
+	gsize length;
+} PngText;
+
+typedef struct {
+	png_uint_32 width;
+	png_uint_32 height;
+	gint bit_depth;
+	GArray *texts;
+	GBytes *exif;
+} PngInfo;
+
 static gchar *
 rfc1123_to_iso8601_date (const gchar *date)
 {
@@ -76,7 +108,7 @@ rfc1123_to_iso8601_date (const gchar *date)
 	return tracker_date_format_to_iso8601 (date, RFC1123_DATE_FORMAT);
 }
 
-#if defined(PNG_iTXt_SUPPORTED) && (defined(HAVE_EXEMPI) || defined(HAVE_LIBEXIF))
+#if defined(HAVE_EXEMPI) || defined(HAVE_LIBEXIF)
 
 /* Handle raw profiles by Imagemagick (at least). Hex encoded with
  * line-changes and other (undocumented/unofficial) twists.
@@ -180,157 +212,138 @@ raw_profile_new (const gchar *input,
 	return output;
 }
 
-#endif /* defined(PNG_iTXt_SUPPORTED) && (defined(HAVE_EXEMPI) || defined(HAVE_LIBEXIF)) */
+#endif /* defined(HAVE_EXEMPI) || defined(HAVE_LIBEXIF) */
 
 static void
 read_metadata (TrackerResource      *metadata,
-               png_structp           png_ptr,
-               png_infop             info_ptr,
-               png_infop             end_ptr,
+               GArray               *texts,
+               GBytes               *exif,
                const gchar          *uri)
 {
 	MergeData md = { 0 };
 	PngData pd = { 0 };
 	TrackerExifData *ed = NULL;
 	TrackerXmpData *xd = NULL;
-	png_infop info_ptrs[2];
-	png_textp text_ptr;
-	gint info_index;
-	gint num_text;
+	PngText *text_ptr;
 	gint i;
-	gint found;
 	GPtrArray *keywords;
 
-	info_ptrs[0] = info_ptr;
-	info_ptrs[1] = end_ptr;
+	text_ptr = (PngText *) texts->data;
 
-	for (info_index = 0; info_index < 2; info_index++) {
-		if ((found = png_get_text (png_ptr, info_ptrs[info_index], &text_ptr, &num_text)) < 1) {
-			g_debug ("Calling png_get_text() returned %d (< 1)", found);
+	for (i = 0; i < texts->len; i++) {
+		if (!text_ptr[i].key || !text_ptr[i].text || text_ptr[i].text[0] == '\0') {
 			continue;
 		}
 
-		for (i = 0; i < num_text; i++) {
-			if (!text_ptr[i].key || !text_ptr[i].text || text_ptr[i].text[0] == '\0') {
-				continue;
-			}
-
-#if defined(HAVE_EXEMPI) && defined(PNG_iTXt_SUPPORTED)
-			if (g_strcmp0 ("XML:com.adobe.xmp", text_ptr[i].key) == 0) {
-				/* ATM tracker_extract_xmp_read supports setting xd
-				 * multiple times, keep it that way as here it's
-				 * theoretically possible that the function gets
-				 * called multiple times
-				 */
-				xd = tracker_xmp_new (text_ptr[i].text,
-				                      text_ptr[i].itxt_length,
-				                      uri);
+#ifdef HAVE_EXEMPI
+		if (g_strcmp0 ("XML:com.adobe.xmp", text_ptr[i].key) == 0) {
+			/* ATM tracker_extract_xmp_read supports setting xd
+			 * multiple times, keep it that way as here it's
+			 * theoretically possible that the function gets
+			 * called multiple times
+			 */
+			xd = tracker_xmp_new (text_ptr[i].text,
+			                      text_ptr[i].length,
+			                      uri);
 
-				continue;
-			}
-
-			if (g_strcmp0 ("Raw profile type xmp", text_ptr[i].key) == 0) {
-				gchar *xmp_buffer;
-				guint xmp_buffer_length = 0;
-				guint input_len;
-
-				if (text_ptr[i].text_length) {
-					input_len = text_ptr[i].text_length;
-				} else {
-					input_len = text_ptr[i].itxt_length;
-				}
-
-				xmp_buffer = raw_profile_new (text_ptr[i].text,
-				                              input_len,
-				                              &xmp_buffer_length);
+			continue;
+		}
 
-				if (xmp_buffer) {
-					xd = tracker_xmp_new (xmp_buffer,
-					                      xmp_buffer_length,
-					                      uri);
-				}
+		if (g_strcmp0 ("Raw profile type xmp", text_ptr[i].key) == 0) {
+			gchar *xmp_buffer;
+			guint xmp_buffer_length = 0;
 
-				g_free (xmp_buffer);
+			xmp_buffer = raw_profile_new (text_ptr[i].text,
+			                              text_ptr[i].length,
+			                              &xmp_buffer_length);
 
-				continue;
+			if (xmp_buffer) {
+				xd = tracker_xmp_new (xmp_buffer,
+				                      xmp_buffer_length,
+				                      uri);
 			}
-#endif /*HAVE_EXEMPI && PNG_iTXt_SUPPORTED */
 
-#if defined(HAVE_LIBEXIF) && defined(PNG_iTXt_SUPPORTED)
-			if (g_strcmp0 ("Raw profile type exif", text_ptr[i].key) == 0) {
-				gchar *exif_buffer;
-				guint exif_buffer_length = 0;
-				guint input_len;
+			g_free (xmp_buffer);
 
-				if (text_ptr[i].text_length) {
-					input_len = text_ptr[i].text_length;
-				} else {
-					input_len = text_ptr[i].itxt_length;
-				}
-
-				exif_buffer = raw_profile_new (text_ptr[i].text,
-				                               input_len,
-				                               &exif_buffer_length);
+			continue;
+		}
+#endif /* HAVE_EXEMPI */
 
-				if (exif_buffer) {
-					ed = tracker_exif_new (exif_buffer,
-					                       exif_buffer_length,
-					                       uri);
-				}
+#ifdef HAVE_LIBEXIF
+		if (g_strcmp0 ("Raw profile type exif", text_ptr[i].key) == 0) {
+			gchar *exif_buffer;
+			guint exif_buffer_length = 0;
 
-				g_free (exif_buffer);
+			exif_buffer = raw_profile_new (text_ptr[i].text,
+			                               text_ptr[i].length,
+			                               &exif_buffer_length);
 
-				continue;
+			if (exif_buffer) {
+				ed = tracker_exif_new (exif_buffer,
+				                       exif_buffer_length,
+				                       uri);
 			}
-#endif /* HAVE_LIBEXIF && PNG_iTXt_SUPPORTED */
 
-			if (g_strcmp0 (text_ptr[i].key, "Author") == 0) {
-				pd.author = text_ptr[i].text;
-				continue;
-			}
+			g_free (exif_buffer);
 
-			if (g_strcmp0 (text_ptr[i].key, "Creator") == 0) {
-				pd.creator = text_ptr[i].text;
-				continue;
-			}
+			continue;
+		}
+#endif /* HAVE_LIBEXIF */
 
-			if (g_strcmp0 (text_ptr[i].key, "Description") == 0) {
-				pd.description = text_ptr[i].text;
-				continue;
-			}
+		if (g_strcmp0 (text_ptr[i].key, "Author") == 0) {
+			pd.author = text_ptr[i].text;
+			continue;
+		}
 
-			if (g_strcmp0 (text_ptr[i].key, "Comment") == 0) {
-				pd.comment = text_ptr[i].text;
-				continue;
-			}
+		if (g_strcmp0 (text_ptr[i].key, "Creator") == 0) {
+			pd.creator = text_ptr[i].text;
+			continue;
+		}
 
-			if (g_strcmp0 (text_ptr[i].key, "Copyright") == 0) {
-				pd.copyright = text_ptr[i].text;
-				continue;
-			}
+		if (g_strcmp0 (text_ptr[i].key, "Description") == 0) {
+			pd.description = text_ptr[i].text;
+			continue;
+		}
 
-			if (g_strcmp0 (text_ptr[i].key, "Creation Time") == 0) {
-				pd.creation_time = rfc1123_to_iso8601_date (text_ptr[i].text);
-				continue;
-			}
+		if (g_strcmp0 (text_ptr[i].key, "Comment") == 0) {
+			pd.comment = text_ptr[i].text;
+			continue;
+		}
 
-			if (g_strcmp0 (text_ptr[i].key, "Title") == 0) {
-				pd.title = text_ptr[i].text;
-				continue;
-			}
+		if (g_strcmp0 (text_ptr[i].key, "Copyright") == 0) {
+			pd.copyright = text_ptr[i].text;
+			continue;
+		}
 
-			if (g_strcmp0 (text_ptr[i].key, "Disclaimer") == 0) {
-				pd.disclaimer = text_ptr[i].text;
-				continue;
-			}
+		if (g_strcmp0 (text_ptr[i].key, "Creation Time") == 0) {
+			pd.creation_time = rfc1123_to_iso8601_date (text_ptr[i].text);
+			continue;
+		}
 
-			if (g_strcmp0(text_ptr[i].key, "Software") == 0) {
-				pd.software = text_ptr[i].text;
-				continue;
-			}
+		if (g_strcmp0 (text_ptr[i].key, "Title") == 0) {
+			pd.title = text_ptr[i].text;
+			continue;
+		}
+
+		if (g_strcmp0 (text_ptr[i].key, "Disclaimer") == 0) {
+			pd.disclaimer = text_ptr[i].text;
+			continue;
+		}
+
+		if (g_strcmp0(text_ptr[i].key, "Software") == 0) {
+			pd.software = text_ptr[i].text;
+			continue;
 		}
 	}
 
+#ifdef HAVE_LIBEXIF
+	if (!ed && exif) {
+		ed = tracker_exif_new (g_bytes_get_data (exif, NULL),
+		                       g_bytes_get_size (exif),
+		                       uri);
+	}
+#endif /* HAVE_LIBEXIF */
+
 	if (!ed) {
 		ed = g_new0 (TrackerExifData, 1);
 	}
@@ -620,12 +633,356 @@ guess_dlna_profile (gint          depth,
 	return FALSE;
 }
 
-G_MODULE_EXPORT gboolean
-tracker_extract_get_metadata (TrackerExtractInfo *info)
+static void
+png_text_clear (PngText *text)
+{
+	g_free (text->key);
+	g_free (text->text);
+}
+
+static void
+png_info_init (PngInfo *png)
+{
+	memset (png, 0, sizeof (PngInfo));
+	png->texts = g_array_new (FALSE, TRUE, sizeof (PngText));
+	g_array_set_clear_func (png->texts, (GDestroyNotify) png_text_clear);
+}
+
+static void
+png_info_clear (PngInfo *png)
+{
+	g_array_unref (png->texts);
+	g_clear_pointer (&png->exif, g_bytes_unref);
+}
+
+static void
+png_info_add_text (PngInfo     *png,
+                   const gchar *key,
+                   gchar       *text,
+                   gsize        length)
+{
+	PngText entry;
+
+	entry.key = g_strdup (key);
+	entry.text = text;
+	entry.length = length;
+	g_array_append_val (png->texts, entry);
+}
+
+static guint32
+read_uint32 (const guchar *data)
+{
+	return (((guint32) data[0] << 24) | ((guint32) data[1] << 16) |
+	        ((guint32) data[2] << 8) | (guint32) data[3]);
+}
+
+static gchar *
+inflate_text (const guchar *data,
+              gsize         size,
+              gsize        *length)
+{
+	z_stream stream = { 0 };
+	GByteArray *output;
+	guchar buffer[16384];
+	gint ret;
+
+	if (inflateInit (&stream) != Z_OK)
+		return NULL;
+
+	stream.next_in = (Bytef *) data;
+	stream.avail_in = size;
+	output = g_byte_array_new ();
+
+	do {
+		stream.next_out = buffer;
+		stream.avail_out = sizeof (buffer);
+		ret = inflate (&stream, Z_NO_FLUSH);
+
+		if (ret == Z_OK || ret == Z_STREAM_END)
+			g_byte_array_append (output, buffer, sizeof (buffer) - stream.avail_out);
+	} while (ret == Z_OK && output->len <= MAX_METADATA_SIZE);
+
+	inflateEnd (&stream);
+
+	if (ret != Z_STREAM_END) {
+		g_byte_array_free (output, TRUE);
+		return NULL;
+	}
+
+	*length = output->len;
+	g_byte_array_append (output, (const guint8 *) "", 1);
+
+	return (gchar *) g_byte_array_free (output, FALSE);
+}
+
+static gchar *
+latin1_to_utf8 (const gchar *text,
+                gsize        size,
+                gsize       *length)
+{
+	return g_convert (text, size, "UTF-8", "ISO-8859-1", NULL, length, NULL);
+}
+
+static void
+parse_text_chunk (PngInfo      *png,
+                  guint32       type,
+                  const guchar *data,
+                  gsize         size)
+{
+	const guchar *p, *end = data + size;
+	const gchar *key = (const gchar *) data;
+	gchar *text = NULL, *raw;
+	gsize length = 0, raw_length, i;
+	gboolean compressed;
+
+	p = memchr (data, '\0', size);
+
+	/* Keywords are 1 to 79 characters long */
+	if (!p || p == data || p - data > 79)
+		return;
+
+	p++;
+
+	switch (type) {
+	case CHUNK_tEXt:
+		text = latin1_to_utf8 ((const gchar *) p, end - p, &length);
+		break;
+	case CHUNK_zTXt:
+		/* Deflate is the only defined compression method */
+		if (p >= end || *p != 0)
+			return;
+
+		raw = inflate_text (p + 1, end - p - 1, &raw_length);
+
+		if (raw) {
+			text = latin1_to_utf8 (raw, raw_length, &length);
+			g_free (raw);
+		}
+		break;
+	case CHUNK_iTXt:
+		if (end - p < 2)
+			return;
+
+		compressed = (p[0] != 0);
+
+		if (compressed && p[1] != 0)
+			return;
+
+		p += 2;
+
+		/* Skip language tag and translated keyword */
+		for (i = 0; i < 2; i++) {
+			p = memchr (p, '\0', end - p);
+
+			if (!p)
+				return;
+
+			p++;
+		}
+
+		if (compressed) {
+			text = inflate_text (p, end - p, &length);
+		} else {
+			length = end - p;
+			text = g_malloc (length + 1);
+			memcpy (text, p, length);
+			text[length] = '\0';
+		}
+		break;
+	}
+
+	if (text)
+		png_info_add_text (png, key, text, length);
+}
+
+static void
+parse_exif_chunk (PngInfo      *png,
+                  const guchar *data,
+                  gsize         size)
+{
+	GByteArray *exif;
+
+	if (png->exif)
+		return;
+
+	/* The chunk holds the bare TIFF structure, libexif
+	 * expects it behind the same header as in JPEG files.
+	 */
+	exif = g_byte_array_sized_new (size + 6);
+	g_byte_array_append (exif, (const guint8 *) "Exif\0\0", 6);
+	g_byte_array_append (exif, data, size);
+	png->exif = g_byte_array_free_to_bytes (exif);
+}
+
+static guchar *
+read_chunk_data (FILE         *f,
+                 const guchar *header,
+                 guint32       length,
+                 gboolean     *valid)
+{
+	guchar crc[4];
+	guchar *data;
+	uLong checksum;
+
+	data = g_malloc (MAX (length, 1));
+
+	if (fread (data, 1, length, f) != length ||
+	    fread (crc, 1, 4, f) != 4) {
+		g_free (data);
+		return NULL;
+	}
+
+	/* The CRC covers the chunk type and data */
+	checksum = crc32 (0, header + 4, 4);
+	checksum = crc32 (checksum, data, length);
+	*valid = (checksum == read_uint32 (crc));
+
+	return data;
+}
+
+static gboolean
+skip_chunk_data (FILE    *f,
+                 guint32  length)
+{
+	return fseeko (f, (off_t) length + 4, SEEK_CUR) == 0;
+}
+
+/* Walks the chunk list, reading IHDR and the metadata chunks and
+ * seeking over everything else, so image data is never decoded.
+ * Returns %FALSE on anything that doesn't look like a well formed
+ * PNG file, so it's handed to libpng instead.
+ */
+static gboolean
+scan_chunks (FILE    *f,
+             PngInfo *png)
+{
+	static const guchar signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	guchar header[8];
+	gboolean seen_idat = FALSE;
+	guint n_chunks = 0;
+
+	if (fread (header, 1, 8, f) != 8 ||
+	    memcmp (header, signature, 8) != 0)
+		return FALSE;
+
+	while (fread (header, 1, 8, f) == 8) {
+		guint32 length, type;
+		gboolean valid;
+		guchar *data;
+
+		length = read_uint32 (header);
+		type = read_uint32 (header + 4);
+
+		if (length > PNG_UINT_31_MAX)
+			return FALSE;
+
+		/* IHDR must come first, and only there */
+		if ((n_chunks++ == 0) != (type == CHUNK_IHDR))
+			return FALSE;
+
+		switch (type) {
+		case CHUNK_IHDR:
+			if (length != 13)
+				return FALSE;
+
+			data = read_chunk_data (f, header, length, &valid);
+
+			if (!data || !valid) {
+				g_free (data);
+				return FALSE;
+			}
+
+			png->width = read_uint32 (data);
+			png->height = read_uint32 (data + 4);
+			png->bit_depth = data[8];
+			g_free (data);
+
+			if (png->width == 0 || png->height == 0)
+				return FALSE;
+			break;
+		case CHUNK_IDAT:
+			seen_idat = TRUE;
+
+			if (!skip_chunk_data (f, length))
+				return FALSE;
+			break;
+		case CHUNK_IEND:
+			return seen_idat;
+		case CHUNK_tEXt:
+		case CHUNK_zTXt:
+		case CHUNK_iTXt:
+		case CHUNK_eXIf:
+			if (length > MAX_METADATA_SIZE) {
+				if (!skip_chunk_data (f, length))
+					return FALSE;
+				break;
+			}
+
+			data = read_chunk_data (f, header, length, &valid);
+
+			if (!data)
+				return FALSE;
+
+			/* Like libpng, drop ancillary chunks with a bad CRC */
+			if (valid && type == CHUNK_eXIf) {
+				parse_exif_chunk (png, data, length);
+			} else if (valid) {
+				parse_text_chunk (png, type, data, length);
+			}
+
+			g_free (data);
+			break;
+		default:
+			if (!skip_chunk_data (f, length))
+				return FALSE;
+			break;
+		}
+	}
+
+	return FALSE;
+}
+
+static void
+add_libpng_texts (PngInfo     *png,
+                  png_structp  png_ptr,
+                  png_infop    info_ptr)
+{
+	png_textp text_ptr;
+	gint num_text;
+	gint found;
+	gint i;
+
+	if ((found = png_get_text (png_ptr, info_ptr, &text_ptr, &num_text)) < 1) {
+		g_debug ("Calling png_get_text() returned %d (< 1)", found);
+		return;
+	}
+
+	for (i = 0; i < num_text; i++) {
+		gsize length;
+
+		if (!text_ptr[i].key || !text_ptr[i].text)
+			continue;
+
+		length = text_ptr[i].text_length;
+#ifdef PNG_iTXt_SUPPORTED
+		if (length == 0)
+			length = text_ptr[i].itxt_length;
+#endif /* PNG_iTXt_SUPPORTED */
+
+		png_info_add_text (png, text_ptr[i].key,
+		                   g_strndup (text_ptr[i].text, length),
+		                   length);
+	}
+}
+
+/* Fallback for files the chunk walker refuses, libpng is
+ * more lenient, but needs to decode all rows to get to the
+ * chunks after the image data.
+ */
+static gboolean
+read_with_libpng (FILE    *f,
+                  PngInfo *png)
 {
-	TrackerResource *metadata;
-	goffset size;
-	FILE *f;
 	png_structp png_ptr;
 	png_infop info_ptr;
 	png_infop end_ptr;
@@ -634,51 +991,29 @@ tracker_extract_get_metadata (TrackerExtractInfo *info)
 	png_uint_32 width, height;
 	gint bit_depth, color_type;
 	gint interlace_type, compression_type, filter_type;
-	const gchar *dlna_profile, *dlna_mimetype;
-	gchar *filename, *uri;
-	GFile *file;
-
-	file = tracker_extract_info_get_file (info);
-	filename = g_file_get_path (file);
-	size = tracker_file_get_size (filename);
-
-	if (size < 64) {
-		return FALSE;
-	}
-
-	f = tracker_file_open (filename);
-	g_free (filename);
-
-	if (!f) {
-		return FALSE;
-	}
 
 	png_ptr = png_create_read_struct (PNG_LIBPNG_VER_STRING,
 	                                  NULL,
 	                                  NULL,
 	                                  NULL);
 	if (!png_ptr) {
-		tracker_file_close (f, FALSE);
 		return FALSE;
 	}
 
 	info_ptr = png_create_info_struct (png_ptr);
 	if (!info_ptr) {
 		png_destroy_read_struct (&png_ptr, NULL, NULL);
-		tracker_file_close (f, FALSE);
 		return FALSE;
 	}
 
 	end_ptr = png_create_info_struct (png_ptr);
 	if (!end_ptr) {
 		png_destroy_read_struct (&png_ptr, &info_ptr, NULL);
-		tracker_file_close (f, FALSE);
 		return FALSE;
 	}
 
 	if (setjmp (png_jmpbuf (png_ptr))) {
 		png_destroy_read_struct (&png_ptr, &info_ptr, &end_ptr);
-		tracker_file_close (f, FALSE);
 		return FALSE;
 	}
 
@@ -695,13 +1030,9 @@ tracker_extract_get_metadata (TrackerExtractInfo *info)
 	                   &compression_type,
 	                   &filter_type)) {
 		png_destroy_read_struct (&png_ptr, &info_ptr, &end_ptr);
-		tracker_file_close (f, FALSE);
 		return FALSE;
 	}
 
-	/* Read the image. FIXME We should be able to skip this step and
-	 * just get the info from the end. This causes some errors atm.
-	 */
 	row_data = png_malloc (png_ptr, png_get_rowbytes (png_ptr, info_ptr));
 	for (row = 0; row < height; row++)
 		png_read_row (png_ptr, row_data, NULL);
@@ -709,26 +1040,80 @@ tracker_extract_get_metadata (TrackerExtractInfo *info)
 
 	png_read_end (png_ptr, end_ptr);
 
+	png->width = width;
+	png->height = height;
+	png->bit_depth = bit_depth;
+	add_libpng_texts (png, png_ptr, info_ptr);
+	add_libpng_texts (png, png_ptr, end_ptr);
+
+	png_destroy_read_struct (&png_ptr, &info_ptr, &end_ptr);
+
+	return TRUE;
+}
+
+G_MODULE_EXPORT gboolean
+tracker_extract_get_metadata (TrackerExtractInfo *info)
+{
+	TrackerResource *metadata;
+	goffset size;
+	FILE *f;
+	PngInfo png;
+	const gchar *dlna_profile, *dlna_mimetype;
+	gchar *filename, *uri;
+	GFile *file;
+
+	file = tracker_extract_info_get_file (info);
+	filename = g_file_get_path (file);
+	size = tracker_file_get_size (filename);
+
+	if (size < 64) {
+		return FALSE;
+	}
+
+	f = tracker_file_open (filename);
+	g_free (filename);
+
+	if (!f) {
+		return FALSE;
+	}
+
+	uri = g_file_get_uri (file);
+	png_info_init (&png);
+
+	if (!scan_chunks (f, &png)) {
+		g_debug ("Could not walk PNG chunks in '%s', decoding it instead", uri);
+
+		png_info_clear (&png);
+		png_info_init (&png);
+		rewind (f);
+
+		if (!read_with_libpng (f, &png)) {
+			png_info_clear (&png);
+			tracker_file_close (f, FALSE);
+			g_free (uri);
+			return FALSE;
+		}
+	}
+
+	tracker_file_close (f, FALSE);
+
 	metadata = tracker_resource_new (NULL);
 
 	tracker_resource_add_uri (metadata, "rdf:type", "nfo:Image");
 	tracker_resource_add_uri (metadata, "rdf:type", "nmm:Photo");
 
-	uri = g_file_get_uri (file);
-
-	read_metadata (metadata, png_ptr, info_ptr, end_ptr, uri);
+	read_metadata (metadata, png.texts, png.exif, uri);
 	g_free (uri);
 
-	tracker_resource_set_int64 (metadata, "nfo:width", width);
-	tracker_resource_set_int64 (metadata, "nfo:height", height);
+	tracker_resource_set_int64 (metadata, "nfo:width", png.width);
+	tracker_resource_set_int64 (metadata, "nfo:height", png.height);
 
-	if (guess_dlna_profile (bit_depth, width, height, &dlna_profile, &dlna_mimetype)) {
+	if (guess_dlna_profile (png.bit_depth, png.width, png.height, &dlna_profile, &dlna_mimetype)) {
 		tracker_resource_set_string (metadata, "nmm:dlnaProfile", dlna_profile);
 		tracker_resource_set_string (metadata, "nmm:dlnaMime", dlna_mimetype);
 	}
 
-	png_destroy_read_struct (&png_ptr, &info_ptr, &end_ptr);
-	tracker_file_close (f, FALSE);
+	png_info_clear (&png);
 
 	tracker_extract_info_set_resource (info, metadata);
 	g_object_unref (metadata);
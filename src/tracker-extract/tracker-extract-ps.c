@@ -20,6 +20,7 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <fcntl.h>
 #include <string.h>
 #include <sys/types.h>
@@ -29,6 +30,8 @@
 #include <glib.h>
 #include <glib/gstdio.h>
 
+#include <zlib.h>
+
 #include <libtracker-miners-common/tracker-common.h>
 #include <libtracker-extract/tracker-extract.h>
 
@@ -100,213 +103,284 @@ date_to_iso8601 (const gchar *date)
 	return NULL;
 }
 
-static TrackerResource *
-extract_ps_from_filestream (FILE *f)
-{
+/* Size of the blocks read from the (possibly compressed) file */
+#define PS_BUFFER_SIZE 16384 /* bytes */
+/* Values deferred with (atend) are looked up this close to the end */
+#define PS_TRAILER_SIZE (32 << 10) /* bytes */
+
+typedef struct {
 	TrackerResource *metadata;
-	gchar *line;
-	gsize length;
-	gssize read_char;
+	gboolean pageno_atend;
+	gboolean header_finished;
+	gboolean skip_to_trailer;
+} PsParseData;
+
+typedef struct {
+	gzFile gz;
+	gchar *buf;
+	gsize start;
+	gsize end;
 	gsize accum;
 	gsize max_bytes;
+} PsLineReader;
 
-	line = NULL;
-	length = 0;
+static const gchar *
+dsc_comment_value (const gchar *line,
+                   gsize        keyword_len)
+{
+	const gchar *value = line + keyword_len;
 
-	metadata = tracker_resource_new (NULL);
-	tracker_resource_add_uri (metadata, "rdf:type", "nfo:PaginatedTextDocument");
+	while (*value == ' ' || *value == '\t') {
+		value++;
+	}
 
-	/* 20 MiB should be enough! (original safe limit) */
-	accum = 0;
-	max_bytes = 20u << 20;
+	return value;
+}
 
-	/* Reuse the same buffer for all lines. Must be dynamically allocated with
-	 * malloc family methods as getline() may re-size it with realloc() */
-	length = 1024;
-	line = g_malloc (length);
+/* Returns FALSE once there is nothing else to look for */
+static gboolean
+extract_ps_line (PsParseData *data,
+                 const gchar *line)
+{
+	TrackerResource *metadata = data->metadata;
 
-	/* Halt the whole when one of these conditions is met:
-	 *  a) Reached max bytes to read
-	 *  b) No more lines to read
+	/* Only the trailer may hold the values left for later,
+	 * anything else is either the body or embedded documents.
 	 */
-	while ((accum < max_bytes) &&
-	       (read_char = tracker_getline (&line, &length, f)) != -1) {
-		gboolean pageno_atend = FALSE;
-		gboolean header_finished = FALSE;
-
-		/* Update accumulated bytes read */
-		accum += read_char;
-
-		line[read_char - 1] = '\0';  /* overwrite '\n' char */
-
-		if (!header_finished && strncmp (line, "%%Copyright:", 12) == 0) {
-			tracker_resource_set_string (metadata, "nie:copyright", line + 13);
-		} else if (!header_finished && strncmp (line, "%%Title:", 8) == 0) {
-			tracker_resource_set_string (metadata, "nie:title", line + 9);
-		} else if (!header_finished && strncmp (line, "%%Creator:", 10) == 0) {
-			TrackerResource *creator = tracker_extract_new_contact (line + 11);
-			tracker_resource_set_relation (metadata, "nco:creator", creator);
-			g_object_unref (creator);
-		} else if (!header_finished && strncmp (line, "%%CreationDate:", 15) == 0) {
-			gchar *date;
-
-			date = date_to_iso8601 (line + 16);
-			if (date) {
-				tracker_resource_set_string (metadata, "nie:contentCreated", date);
-				g_free (date);
-			}
-		} else if (strncmp (line, "%%Pages:", 8) == 0) {
-			if (strcmp (line + 9, "(atend)") == 0) {
-				pageno_atend = TRUE;
-			} else {
-				gint64 page_count;
-
-				page_count = g_ascii_strtoll (line + 9, NULL, 10);
-				tracker_resource_set_int (metadata, "nfo:pageCount", page_count);
-			}
-		} else if (strncmp (line, "%%EndComments", 14) == 0) {
-			header_finished = TRUE;
+	if (data->skip_to_trailer) {
+		if (strncmp (line, "%%Trailer", 9) == 0) {
+			data->skip_to_trailer = FALSE;
+		}
 
-			if (!pageno_atend) {
-				break;
+		return TRUE;
+	}
+
+	if (!data->header_finished && strncmp (line, "%%Copyright:", 12) == 0) {
+		tracker_resource_set_string (metadata, "nie:copyright",
+		                             dsc_comment_value (line, 12));
+	} else if (!data->header_finished && strncmp (line, "%%Title:", 8) == 0) {
+		tracker_resource_set_string (metadata, "nie:title",
+		                             dsc_comment_value (line, 8));
+	} else if (!data->header_finished && strncmp (line, "%%Creator:", 10) == 0) {
+		TrackerResource *creator;
+
+		creator = tracker_extract_new_contact (dsc_comment_value (line, 10));
+		tracker_resource_set_relation (metadata, "nco:creator", creator);
+		g_object_unref (creator);
+	} else if (!data->header_finished && strncmp (line, "%%CreationDate:", 15) == 0) {
+		gchar *date;
+
+		date = date_to_iso8601 (dsc_comment_value (line, 15));
+		if (date) {
+			tracker_resource_set_string (metadata, "nie:contentCreated", date);
+			g_free (date);
+		}
+	} else if (strncmp (line, "%%Pages:", 8) == 0) {
+		const gchar *value = dsc_comment_value (line, 8);
+
+		if (strcmp (value, "(atend)") == 0) {
+			data->pageno_atend = TRUE;
+		} else {
+			gint64 page_count;
+
+			page_count = g_ascii_strtoll (value, NULL, 10);
+			tracker_resource_set_int (metadata, "nfo:pageCount", page_count);
+
+			/* This is the trailer, the header was read already */
+			if (data->header_finished) {
+				return FALSE;
 			}
 		}
-	}
+	} else if (strncmp (line, "%%EndComments", 14) == 0) {
+		data->header_finished = TRUE;
 
-	/* Deallocate the buffer */
-	if (line) {
-		g_free (line);
+		if (!data->pageno_atend) {
+			return FALSE;
+		}
+
+		data->skip_to_trailer = TRUE;
 	}
 
-	return metadata;
+	return TRUE;
 }
 
-
-
-static TrackerResource *
-extract_ps (const gchar          *uri)
+/* Returns the next line read from @gz, zlib reads uncompressed
+ * files transparently. Lines are split in blocks, and the
+ * returned line is only valid until the next call.
+ */
+static const gchar *
+ps_line_reader_next (PsLineReader *reader)
 {
-	TrackerResource *metadata;
-	FILE *f;
-	gchar *filename;
+	gchar *buf = reader->buf;
+	gchar *line, *nl;
+	gint n_read;
+
+	while (TRUE) {
+		nl = memchr (buf + reader->start, '\n', reader->end - reader->start);
+
+		if (nl) {
+			line = buf + reader->start;
+			*nl = '\0';
+			reader->start = nl - buf + 1;
+			return line;
+		}
 
-	filename = g_filename_from_uri (uri, NULL, NULL);
-	f = tracker_file_open (filename);
-	g_free (filename);
+		if (reader->start == 0 && reader->end == PS_BUFFER_SIZE) {
+			/* No DSC comment is this long, this is data */
+			buf[reader->end] = '\0';
+			reader->start = reader->end;
+			return buf;
+		}
 
-	if (!f) {
-		return NULL;
-	}
+		/* Keep the partial line at the start of the buffer */
+		memmove (buf, buf + reader->start, reader->end - reader->start);
+		reader->end -= reader->start;
+		reader->start = 0;
 
-	/* Extract from filestream! */
-	g_debug ("Extracting PS '%s'...", uri);
-	metadata = extract_ps_from_filestream (f);
+		n_read = -1;
 
-	tracker_file_close (f, FALSE);
+		if (reader->accum < reader->max_bytes) {
+			n_read = gzread (reader->gz, buf + reader->end,
+			                 PS_BUFFER_SIZE - reader->end);
+		}
 
-	return metadata;
-}
+		if (n_read <= 0) {
+			/* Last line, with no line break */
+			if (reader->end > 0) {
+				buf[reader->end] = '\0';
+				reader->start = reader->end;
+				return buf;
+			}
 
-#ifdef USING_UNZIPPSFILES
+			return NULL;
+		}
 
-#include <errno.h>
-#include <sys/time.h>
-#include <sys/resource.h>
+		reader->accum += n_read;
+		reader->end += n_read;
+	}
+}
 
+/* Drops buffered data, after seeking */
 static void
-spawn_child_func (gpointer user_data)
+ps_line_reader_reset (PsLineReader *reader)
+{
+	reader->start = reader->end = 0;
+}
+
+static TrackerResource *
+extract_ps_from_gzfile (gzFile  gz,
+                        goffset size)
 {
-	struct rlimit cpu_limit;
-	gint timeout = GPOINTER_TO_INT (user_data);
+	PsParseData data = { 0 };
+	PsLineReader reader = { 0 };
+	const gchar *line;
+	goffset resume_offset = -1;
+	gboolean jumped = FALSE;
 
-	if (timeout > 0) {
-		/* set cpu limit */
-		getrlimit (RLIMIT_CPU, &cpu_limit);
-		cpu_limit.rlim_cur = timeout;
-		cpu_limit.rlim_max = timeout + 1;
+	data.metadata = tracker_resource_new (NULL);
+	tracker_resource_add_uri (data.metadata, "rdf:type", "nfo:PaginatedTextDocument");
 
-		if (setrlimit (RLIMIT_CPU, &cpu_limit) != 0) {
-			g_critical ("Failed to set resource limit for CPU");
+	reader.gz = gz;
+	reader.buf = g_malloc (PS_BUFFER_SIZE + 1);
+	/* 20 MiB should be enough! (original safe limit) */
+	reader.max_bytes = 20u << 20;
+
+	/* Halt the whole when one of these conditions is met:
+	 *  a) Reached max bytes to read
+	 *  b) No more lines to read
+	 *  c) Everything was found
+	 */
+	while (TRUE) {
+		line = ps_line_reader_next (&reader);
+
+		if (!line) {
+			/* The trailer wasn't that close to the end, read
+			 * the body after all, from where the jump was made.
+			 */
+			if (data.skip_to_trailer && resume_offset >= 0 &&
+			    gzseek (gz, resume_offset, SEEK_SET) != -1) {
+				ps_line_reader_reset (&reader);
+				resume_offset = -1;
+				continue;
+			}
+
+			break;
+		}
+
+		if (!extract_ps_line (&data, line)) {
+			break;
 		}
 
-		/* Have this as a precaution in cases where cpu limit has not
-		 * been reached due to spawned app sleeping.
+		/* After the header, only (atend) values are left to
+		 * look for, in the trailer. Uncompressed files can
+		 * jump there instead of reading the whole body.
 		 */
-		alarm (timeout + 2);
-	}
+		if (data.skip_to_trailer && !jumped && size > 0 && gzdirect (gz) &&
+		    gztell (gz) < size - PS_TRAILER_SIZE) {
+			/* Buffered data wasn't parsed yet */
+			resume_offset = gztell (gz) - (reader.end - reader.start);
+			jumped = TRUE;
+
+			if (gzseek (gz, size - PS_TRAILER_SIZE, SEEK_SET) == -1) {
+				break;
+			}
 
-	/* Set child's niceness to 19 */
-	errno = 0;
+			ps_line_reader_reset (&reader);
 
-	/* nice() uses attribute "warn_unused_result" and so complains
-	 * if we do not check its returned value. But it seems that
-	 * since glibc 2.2.4, nice() can return -1 on a successful call
-	 * so we have to check value of errno too. Stupid...
-	 */
-	if (nice (19) == -1 && errno) {
-		g_warning ("Failed to set nice value");
+			/* Most likely cut in the middle */
+			ps_line_reader_next (&reader);
+		}
 	}
+
+	g_free (reader.buf);
+
+	return data.metadata;
 }
 
 static TrackerResource *
-extract_ps_gz (const gchar          *uri)
+extract_ps (const gchar *uri)
 {
 	TrackerResource *metadata = NULL;
-	FILE *fz;
-	gint fdz;
-	const gchar *argv[4];
 	gchar *filename;
-	GError *error = NULL;
+	struct stat st;
+	gzFile gz;
+	FILE *f;
+	gint fd;
 
 	filename = g_filename_from_uri (uri, NULL, NULL);
+	f = tracker_file_open (filename);
+	g_free (filename);
 
-	/* TODO: we should be using libz for this instead */
-
-	argv[0] = "gunzip";
-	argv[1] = "-c";
-	argv[2] = filename;
-	argv[3] = NULL;
-
-	/* Fork & spawn to gunzip the file */
-	if (!g_spawn_async_with_pipes (g_get_tmp_dir (),
-	                               (gchar **) argv,
-	                               NULL,
-	                               G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL,
-	                               spawn_child_func,
-	                               GINT_TO_POINTER (10),
-	                               NULL,
-	                               NULL,
-	                               &fdz,
-	                               NULL,
-	                               &error)) {
-		g_warning ("Couldn't fork & spawn to gunzip '%s': %s",
-		           uri, error ? error->message : NULL);
-		g_clear_error (&error);
-	}
-	/* Get FILE from FD */
-	else if ((fz = fdopen (fdz, "r")) == NULL) {
-		g_warning ("Couldn't open FILE from FD (%s)...", uri);
-		close (fdz);
+	if (!f) {
+		return NULL;
 	}
-	/* Extract from filestream! */
-	else
-	{
-		g_debug ("Extracting compressed PS '%s'...", uri);
-		metadata = extract_ps_from_filestream (fz);
-#ifdef HAVE_POSIX_FADVISE
-		if (posix_fadvise (fdz, 0, 0, POSIX_FADV_DONTNEED) != 0)
-			g_warning ("posix_fadvise() call failed: %m");
-#endif /* HAVE_POSIX_FADVISE */
-		fclose (fz);
+
+	/* gzclose() closes the descriptor, the FILE keeps its own */
+	fd = dup (fileno (f));
+
+	if (fd == -1 || (gz = gzdopen (fd, "rb")) == NULL) {
+		g_warning ("Couldn't open '%s' for reading: %s",
+		           uri, g_strerror (errno));
+
+		if (fd != -1) {
+			close (fd);
+		}
+	} else {
+		gzbuffer (gz, PS_BUFFER_SIZE);
+
+		/* Extract from filestream! */
+		g_debug ("Extracting PS '%s'...", uri);
+		metadata = extract_ps_from_gzfile (gz,
+		                                   fstat (fd, &st) == 0 ? st.st_size : -1);
+
+		gzclose (gz);
 	}
 
-	g_free (filename);
+	tracker_file_close (f, FALSE);
 
 	return metadata;
 }
 
-#endif /* USING_UNZIPPSFILES */
-
 G_MODULE_EXPORT gboolean
 tracker_extract_get_metadata (TrackerExtractInfo *info)
 {
@@ -317,20 +391,15 @@ tracker_extract_get_metadata (TrackerExtractInfo *info)
 	file = tracker_extract_info_get_file (info);
 	uri = g_file_get_uri (file);
 
-	{
-#ifdef USING_UNZIPPSFILES
-		const char *mimetype;
-
-		mimetype = tracker_extract_info_get_mimetype (info);
-
-		if (strcmp (mimetype, "application/x-gzpostscript") == 0) {
-			metadata = extract_ps_gz (uri);
-		} else
-#endif /* USING_UNZIPPSFILES */
-		{
-			metadata = extract_ps (uri);
-		}
+#ifndef USING_UNZIPPSFILES
+	if (strcmp (tracker_extract_info_get_mimetype (info),
+	            "application/x-gzpostscript") == 0) {
+		g_free (uri);
+		return TRUE;
 	}
+#endif /* USING_UNZIPPSFILES */
+
+	metadata = extract_ps (uri);
 
 	g_free (uri);
 
@@ -21,6 +21,7 @@
 
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 
 #include <gmodule.h>
 #include <glib/gi18n.h>
@@ -47,27 +48,77 @@ G_DEFINE_QUARK (TrackerExtractError, tracker_extract_error)
 
 extern gboolean debug;
 
+/* log2 buckets of microseconds, the last one holds anything above ~4s */
+#define N_LATENCY_BUCKETS 23
+
+/* Fallback hops are accounted separately up to this number */
+#define N_FALLBACK_HOPS 4
+
+/* Bytes read ahead for every file in a batch before dispatching it */
+#define BATCH_PREFETCH_SIZE (256 * 1024)
+
+/* Default minimum of worker threads, so a slow module can't
+ * hold back every other one on single processor machines.
+ */
+#define MIN_WORKERS 2
+
+typedef struct {
+	guint counts[N_LATENCY_BUCKETS];
+	guint total;
+} LatencyHistogram;
+
 typedef struct {
 	gint extracted_count;
 	gint failed_count;
+
+	/* Times the module failed and the task fell back to the next one */
+	guint fallback_count;
+	/* Tasks cancelled while queued for the module */
+	guint cancelled_count;
+	/* Size of the files the module was run on */
+	guint64 bytes_read;
+	/* Time spent inside the module's extract function */
+	LatencyHistogram latency;
 } StatisticsData;
 
+/* Per-module statistics snapshot, also holding the scheduler state */
+typedef struct {
+	const gchar *name;
+	StatisticsData data;
+	guint queue_depth;
+	guint n_running;
+} ModuleStatistics;
+
+typedef struct {
+	GModule *module;
+	GQueue tasks;
+	guint n_running;
+	guint max_threads;
+} ModuleQueue;
+
 typedef struct {
 	GHashTable *statistics_data;
-	GList *running_tasks;
+	GHashTable *running_tasks;
 
 	/* used to maintain the running tasks
 	 * and stats from different threads
 	 */
 	GMutex task_mutex;
 
-	/* Thread pool for multi-threaded extractors */
-	GThreadPool *thread_pool;
-
-	/* module -> async queue hashtable
-	 * for single-threaded extractors
+	/* Scheduler, a fixed number of worker threads
+	 * services the per-module task queues, each
+	 * module being limited to the number of threads
+	 * it declares to be safe on.
 	 */
-	GHashTable *single_thread_extractors;
+	GMutex scheduler_mutex;
+	GCond scheduler_cond;
+	GHashTable *module_queues;
+	GPtrArray *module_queue_list;
+	GPtrArray *workers;
+	guint max_workers;
+	guint n_idle_workers;
+	guint next_queue;
+	gboolean shutting_down;
 
 	gboolean disable_shutdown;
 	gboolean disable_summary_on_finalize;
@@ -75,8 +126,36 @@ typedef struct {
 	gchar *force_module;
 
 	gint unhandled_count;
+
+	/* Time tasks spend between a module failing and
+	 * the next one starting, indexed by hop number.
+	 */
+	LatencyHistogram fallback_latency[N_FALLBACK_HOPS];
 } TrackerExtractPrivate;
 
+typedef struct {
+	TrackerExtract *extract;
+	GTask *task;
+	TrackerExtractBatchFunc item_func;
+	gpointer user_data;
+
+	/* Results are queued from worker threads and
+	 * flushed in batches from the GTask context.
+	 */
+	GMutex mutex;
+	GQueue results;
+	gboolean flush_scheduled;
+
+	/* Only accessed from the GTask context */
+	guint n_pending;
+} TrackerExtractBatch;
+
+typedef struct {
+	guint index;
+	TrackerExtractInfo *info;
+	GError *error;
+} TrackerExtractBatchResult;
+
 typedef struct {
 	TrackerExtract *extract;
 	GCancellable *cancellable;
@@ -92,12 +171,38 @@ typedef struct {
 
 	guint signal_id;
 	guint success : 1;
+
+	/* Kept across fallback hops, so modules share
+	 * the file contents mapped by previous ones.
+	 */
+	TrackerExtractInfo *info;
+
+	/* Module accounting, size is -1 until known */
+	goffset size;
+	gint64 run_time;
+
+	/* Fallback accounting */
+	guint n_hops;
+	gint64 fallback_time;
+
+	/* Set instead of res for tasks coming from a batch */
+	TrackerExtractBatch *batch;
+	guint batch_index;
+
+	/* Queue the task is waiting in for a worker, if any, both
+	 * fields are protected by the scheduler mutex.
+	 */
+	ModuleQueue *queue;
+	GList queue_link;
 } TrackerExtractTask;
 
 static void tracker_extract_finalize (GObject *object);
 static void report_statistics        (GObject *object);
 static gboolean get_metadata         (TrackerExtractTask *task);
-static gboolean dispatch_task_cb     (TrackerExtractTask *task);
+static void     dispatch_task        (TrackerExtractTask *task);
+static void     task_return_error    (TrackerExtractTask *task,
+                                      GError             *error);
+static void     task_account_cancelled (TrackerExtractTask *task);
 
 
 G_DEFINE_TYPE(TrackerExtract, tracker_extract, G_TYPE_OBJECT)
@@ -120,6 +225,14 @@ statistics_data_free (StatisticsData *data)
 	g_slice_free (StatisticsData, data);
 }
 
+static void
+module_queue_free (ModuleQueue *queue)
+{
+	/* Queued tasks are failed on finalize, before this */
+	g_assert (g_queue_is_empty (&queue->tasks));
+	g_slice_free (ModuleQueue, queue);
+}
+
 static void
 tracker_extract_init (TrackerExtract *object)
 {
@@ -128,42 +241,147 @@ tracker_extract_init (TrackerExtract *object)
 	priv = TRACKER_EXTRACT_GET_PRIVATE (object);
 	priv->statistics_data = g_hash_table_new_full (NULL, NULL, NULL,
 	                                               (GDestroyNotify) statistics_data_free);
-	priv->single_thread_extractors = g_hash_table_new (NULL, NULL);
-	priv->thread_pool = g_thread_pool_new ((GFunc) get_metadata,
-	                                       NULL, 10, TRUE, NULL);
+	priv->running_tasks = g_hash_table_new (NULL, NULL);
+	priv->module_queues = g_hash_table_new_full (NULL, NULL, NULL,
+	                                             (GDestroyNotify) module_queue_free);
+	priv->module_queue_list = g_ptr_array_new ();
+	priv->workers = g_ptr_array_new ();
+	priv->max_workers = MAX (g_get_num_processors (), MIN_WORKERS);
 
 	g_mutex_init (&priv->task_mutex);
+	g_mutex_init (&priv->scheduler_mutex);
+	g_cond_init (&priv->scheduler_cond);
 }
 
 static void
 tracker_extract_finalize (GObject *object)
 {
 	TrackerExtractPrivate *priv;
+	GList *pending = NULL, *l;
+	guint i;
 
 	priv = TRACKER_EXTRACT_GET_PRIVATE (object);
 
 	/* FIXME: Shutdown modules? */
 
-	g_hash_table_destroy (priv->single_thread_extractors);
-	g_thread_pool_free (priv->thread_pool, TRUE, FALSE);
+	/* Let idle workers quit, busy ones quit after their current task */
+	g_mutex_lock (&priv->scheduler_mutex);
+	priv->shutting_down = TRUE;
+	g_cond_broadcast (&priv->scheduler_cond);
+	g_mutex_unlock (&priv->scheduler_mutex);
+
+	while (priv->workers->len > 0) {
+		GThread *thread;
+
+		/* g_thread_join() releases our reference */
+		thread = g_ptr_array_remove_index_fast (priv->workers,
+		                                        priv->workers->len - 1);
+		g_thread_join (thread);
+	}
+
+	/* Fail whatever is still waiting for a worker, tasks are
+	 * taken out under the lock, but finished outside of it as
+	 * disconnecting waits for any running cancellation handler.
+	 */
+	g_mutex_lock (&priv->scheduler_mutex);
+
+	for (i = 0; i < priv->module_queue_list->len; i++) {
+		ModuleQueue *queue;
+		GList *link;
+
+		queue = g_ptr_array_index (priv->module_queue_list, i);
+
+		while ((link = g_queue_pop_head_link (&queue->tasks)) != NULL) {
+			TrackerExtractTask *task = link->data;
+
+			task->queue = NULL;
+			pending = g_list_prepend (pending, task);
+		}
+	}
+
+	g_mutex_unlock (&priv->scheduler_mutex);
+
+	pending = g_list_reverse (pending);
+
+	for (l = pending; l; l = l->next) {
+		GError *error = NULL;
+
+		g_set_error_literal (&error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+		                     "Extractor was shut down");
+		task_return_error (l->data, error);
+	}
+
+	g_list_free (pending);
+
+	g_ptr_array_unref (priv->workers);
+	g_ptr_array_unref (priv->module_queue_list);
+	g_hash_table_destroy (priv->module_queues);
+	g_cond_clear (&priv->scheduler_cond);
+	g_mutex_clear (&priv->scheduler_mutex);
 
 	if (!priv->disable_summary_on_finalize) {
 		report_statistics (object);
 	}
 
 	g_hash_table_destroy (priv->statistics_data);
+	g_hash_table_destroy (priv->running_tasks);
 
 	g_mutex_clear (&priv->task_mutex);
 
 	G_OBJECT_CLASS (tracker_extract_parent_class)->finalize (object);
 }
 
+static void
+latency_histogram_add (LatencyHistogram *histogram,
+                       gint64            usec)
+{
+	guint bucket;
+
+	bucket = g_bit_storage (MAX (usec, 0));
+	histogram->counts[MIN (bucket, N_LATENCY_BUCKETS - 1)]++;
+	histogram->total++;
+}
+
+/* Returns the upper bound in microseconds of the bucket
+ * containing the given percentile.
+ */
+static gint64
+latency_histogram_percentile (LatencyHistogram *histogram,
+                              guint             percentile)
+{
+	guint i, accum = 0, threshold;
+
+	threshold = (histogram->total * percentile + 99) / 100;
+
+	for (i = 0; i < N_LATENCY_BUCKETS; i++) {
+		accum += histogram->counts[i];
+
+		if (accum >= threshold) {
+			break;
+		}
+	}
+
+	return (G_GINT64_CONSTANT (1) << MIN (i, N_LATENCY_BUCKETS - 1));
+}
+
+static const gchar *
+module_get_basename (GModule *module)
+{
+	const gchar *name, *basename;
+
+	name = g_module_name (module);
+	basename = strrchr (name, G_DIR_SEPARATOR);
+
+	return basename ? basename + 1 : name;
+}
+
 static void
 report_statistics (GObject *object)
 {
 	TrackerExtractPrivate *priv;
 	GHashTableIter iter;
 	gpointer key, value;
+	guint i;
 
 	priv = TRACKER_EXTRACT_GET_PRIVATE (object);
 
@@ -177,22 +395,49 @@ report_statistics (GObject *object)
 	while (g_hash_table_iter_next (&iter, &key, &value)) {
 		GModule *module = key;
 		StatisticsData *data = value;
+		const gchar *name_without_path;
 
-		if (data->extracted_count > 0 || data->failed_count > 0) {
-			const gchar *name, *name_without_path;
-
-			name = g_module_name (module);
-			name_without_path = strrchr (name, G_DIR_SEPARATOR) + 1;
+		name_without_path = module_get_basename (module);
 
+		if (data->extracted_count > 0 || data->failed_count > 0) {
 			g_message ("    Module:'%s', extracted:%d, failures:%d",
 			           name_without_path,
 			           data->extracted_count,
 			           data->failed_count);
 		}
+
+		if (data->latency.total > 0 || data->cancelled_count > 0) {
+			g_message ("    Module:'%s', fallbacks:%u, cancelled:%u, bytes:%" G_GUINT64_FORMAT ", "
+			           "latency p50 < %" G_GINT64_FORMAT "us, "
+			           "p95 < %" G_GINT64_FORMAT "us, p99 < %" G_GINT64_FORMAT "us",
+			           name_without_path,
+			           data->fallback_count,
+			           data->cancelled_count,
+			           data->bytes_read,
+			           latency_histogram_percentile (&data->latency, 50),
+			           latency_histogram_percentile (&data->latency, 95),
+			           latency_histogram_percentile (&data->latency, 99));
+		}
 	}
 
 	g_message ("Unhandled files: %d", priv->unhandled_count);
 
+	for (i = 0; i < N_FALLBACK_HOPS; i++) {
+		LatencyHistogram *histogram = &priv->fallback_latency[i];
+
+		if (histogram->total == 0) {
+			continue;
+		}
+
+		g_message ("    Fallback hop %u%s: %u tasks, latency p50 < %" G_GINT64_FORMAT "us, "
+		           "p95 < %" G_GINT64_FORMAT "us, p99 < %" G_GINT64_FORMAT "us",
+		           i + 1, i == N_FALLBACK_HOPS - 1 ? "+" : "",
+		           histogram->total,
+		           latency_histogram_percentile (histogram, 50),
+		           latency_histogram_percentile (histogram, 95),
+		           latency_histogram_percentile (histogram, 99));
+	}
+
 	if (priv->unhandled_count == 0 &&
 	    g_hash_table_size (priv->statistics_data) < 1) {
 		g_message ("    No files handled");
@@ -209,6 +454,7 @@ tracker_extract_new (gboolean     disable_shutdown,
 {
 	TrackerExtract *object;
 	TrackerExtractPrivate *priv;
+	TrackerConfig *config;
 
 	if (!tracker_extract_module_manager_init ()) {
 		return NULL;
@@ -222,9 +468,32 @@ tracker_extract_new (gboolean     disable_shutdown,
 	priv->disable_shutdown = disable_shutdown;
 	priv->force_module = g_strdup (force_module);
 
+	config = tracker_main_get_config ();
+
+	if (config && tracker_config_get_max_threads (config) > 0) {
+		priv->max_workers = tracker_config_get_max_threads (config);
+	}
+
 	return object;
 }
 
+/* Called with the task mutex held */
+static StatisticsData *
+statistics_data_lookup (TrackerExtractPrivate *priv,
+                        GModule               *module)
+{
+	StatisticsData *stats_data;
+
+	stats_data = g_hash_table_lookup (priv->statistics_data, module);
+
+	if (!stats_data) {
+		stats_data = g_slice_new0 (StatisticsData);
+		g_hash_table_insert (priv->statistics_data, module, stats_data);
+	}
+
+	return stats_data;
+}
+
 static void
 notify_task_finish (TrackerExtractTask *task,
                     gboolean            success)
@@ -242,16 +511,7 @@ notify_task_finish (TrackerExtractTask *task,
 	g_mutex_lock (&priv->task_mutex);
 
 	if (task->cur_module) {
-		stats_data = g_hash_table_lookup (priv->statistics_data,
-						  task->cur_module);
-
-		if (!stats_data) {
-			stats_data = g_slice_new0 (StatisticsData);
-			g_hash_table_insert (priv->statistics_data,
-					     task->cur_module,
-					     stats_data);
-		}
-
+		stats_data = statistics_data_lookup (priv, task->cur_module);
 		stats_data->extracted_count++;
 
 		if (!success) {
@@ -261,8 +521,6 @@ notify_task_finish (TrackerExtractTask *task,
 		priv->unhandled_count++;
 	}
 
-	priv->running_tasks = g_list_remove (priv->running_tasks, task);
-
 	g_mutex_unlock (&priv->task_mutex);
 }
 
@@ -271,49 +529,102 @@ get_file_metadata (TrackerExtractTask  *task,
                    TrackerExtractInfo **info_out)
 {
 	TrackerExtractInfo *info;
-	GFile *file;
 	gchar *mime_used = NULL;
 
 	*info_out = NULL;
 
-	file = g_file_new_for_uri (task->file);
-	info = tracker_extract_info_new (file, task->mimetype);
-	g_object_unref (file);
-
 	if (task->mimetype && *task->mimetype) {
 		/* We know the mime */
 		mime_used = g_strdup (task->mimetype);
 	} else {
-		tracker_extract_info_unref (info);
 		return FALSE;
 	}
 
+	if (!task->info) {
+		GFile *file;
+
+		file = g_file_new_for_uri (task->file);
+		task->info = tracker_extract_info_new (file, task->mimetype);
+		g_object_unref (file);
+	}
+
+	info = task->info;
+
 	/* Now we have sanity checked everything, actually get the
 	 * data we need from the extractors.
 	 */
 	if (mime_used) {
 		if (task->cur_func) {
+			gint64 start;
+
 			g_debug ("Using %s...",
 				 task->cur_module ?
 				 g_module_name (task->cur_module) :
 				 "Dummy extraction");
 
+			if (task->size < 0) {
+				gchar *path;
+
+				path = g_file_get_path (tracker_extract_info_get_file (info));
+				task->size = path ? tracker_file_get_size (path) : 0;
+				g_free (path);
+			}
+
+			start = g_get_monotonic_time ();
 			task->success = (task->cur_func) (info);
+			task->run_time = g_get_monotonic_time () - start;
 		}
 
 		g_free (mime_used);
 	}
 
-	if (!task->success) {
-		tracker_extract_info_unref (info);
-		info = NULL;
+	if (task->success) {
+		/* The caller takes over the info */
+		*info_out = info;
+		task->info = NULL;
+	} else if (tracker_extract_info_get_resource (info)) {
+		/* Don't hand partial results to the next module */
+		tracker_extract_info_set_resource (info, NULL);
 	}
 
-	*info_out = info;
-
 	return task->success;
 }
 
+/* Tasks are only in the running set while a module is
+ * being run on them, from a worker thread.
+ */
+static void
+task_set_running (TrackerExtractTask *task,
+                  gboolean            running)
+{
+	TrackerExtractPrivate *priv;
+
+	priv = TRACKER_EXTRACT_GET_PRIVATE (task->extract);
+
+	g_mutex_lock (&priv->task_mutex);
+
+	if (running) {
+		g_hash_table_add (priv->running_tasks, task);
+	} else {
+		g_hash_table_remove (priv->running_tasks, task);
+	}
+
+	g_mutex_unlock (&priv->task_mutex);
+}
+
+static gboolean
+task_cancelled_in_queue_cb (TrackerExtractTask *task)
+{
+	GError *error = NULL;
+
+	g_set_error_literal (&error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+	                     "Operation was cancelled");
+	task_account_cancelled (task);
+	task_return_error (task, error);
+
+	return G_SOURCE_REMOVE;
+}
+
 /* This function is called on the thread calling g_cancellable_cancel() */
 static void
 task_cancellable_cancelled_cb (GCancellable       *cancellable,
@@ -321,20 +632,41 @@ task_cancellable_cancelled_cb (GCancellable       *cancellable,
 {
 	TrackerExtractPrivate *priv;
 	TrackerExtract *extract;
+	gboolean unqueued = FALSE;
 
 	extract = task->extract;
 	priv = TRACKER_EXTRACT_GET_PRIVATE (extract);
 
-	g_mutex_lock (&priv->task_mutex);
+	g_mutex_lock (&priv->scheduler_mutex);
+
+	if (task->queue) {
+		/* Still waiting for a worker, just take it out */
+		g_queue_unlink (&task->queue->tasks, &task->queue_link);
+		task->queue = NULL;
+		unqueued = TRUE;
+	} else {
+		g_mutex_lock (&priv->task_mutex);
 
-	if (g_list_find (priv->running_tasks, task)) {
-		g_message ("Cancelled task for '%s' was currently being "
-		           "processed, _exit()ing immediately",
-		           task->file);
-		_exit (0);
+		if (g_hash_table_contains (priv->running_tasks, task)) {
+			g_message ("Cancelled task for '%s' was currently being "
+			           "processed, _exit()ing immediately",
+			           task->file);
+			_exit (0);
+		}
+
+		g_mutex_unlock (&priv->task_mutex);
 	}
 
-	g_mutex_unlock (&priv->task_mutex);
+	g_mutex_unlock (&priv->scheduler_mutex);
+
+	/* Tasks not queued nor running will notice the cancellation
+	 * once they get to a worker. Unqueued ones are finished from
+	 * an idle, disconnecting from the cancellable can't happen
+	 * from within this handler.
+	 */
+	if (unqueued) {
+		g_idle_add ((GSourceFunc) task_cancelled_in_queue_cb, task);
+	}
 }
 
 static TrackerExtractTask *
@@ -381,6 +713,8 @@ extract_task_new (TrackerExtract *extract,
 	task->file = g_strdup (uri);
 	task->mimetype = mimetype_used;
 	task->extract = extract;
+	task->size = -1;
+	task->queue_link.data = task;
 
 	if (task->cancellable) {
 		task->signal_id = g_cancellable_connect (cancellable,
@@ -412,12 +746,123 @@ extract_task_free (TrackerExtractTask *task)
 		tracker_mimetype_info_free (task->mimetype_handlers);
 	}
 
+	if (task->info) {
+		tracker_extract_info_unref (task->info);
+	}
+
 	g_free (task->mimetype);
 	g_free (task->file);
 
 	g_slice_free (TrackerExtractTask, task);
 }
 
+static void
+batch_free (TrackerExtractBatch *batch)
+{
+	g_object_unref (batch->task);
+	g_mutex_clear (&batch->mutex);
+	g_slice_free (TrackerExtractBatch, batch);
+}
+
+/* Runs in the context the batch was started from */
+static gboolean
+batch_flush_results_cb (TrackerExtractBatch *batch)
+{
+	TrackerExtractBatchResult *result;
+	GQueue results = G_QUEUE_INIT;
+
+	g_mutex_lock (&batch->mutex);
+	results = batch->results;
+	g_queue_init (&batch->results);
+	batch->flush_scheduled = FALSE;
+	g_mutex_unlock (&batch->mutex);
+
+	while ((result = g_queue_pop_head (&results)) != NULL) {
+		batch->item_func (batch->extract, result->index,
+		                  result->info, result->error,
+		                  batch->user_data);
+
+		if (result->info) {
+			tracker_extract_info_unref (result->info);
+		}
+
+		g_clear_error (&result->error);
+		g_slice_free (TrackerExtractBatchResult, result);
+		batch->n_pending--;
+	}
+
+	if (batch->n_pending == 0) {
+		g_task_return_boolean (batch->task, TRUE);
+		batch_free (batch);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+/* This function can be called in any thread, results are
+ * coalesced so a single idle handles all of those that
+ * finished meanwhile.
+ */
+static void
+batch_add_result (TrackerExtractBatch *batch,
+                  guint                index,
+                  TrackerExtractInfo  *info,
+                  GError              *error)
+{
+	TrackerExtractBatchResult *result;
+
+	result = g_slice_new0 (TrackerExtractBatchResult);
+	result->index = index;
+	result->info = info;
+	result->error = error;
+
+	g_mutex_lock (&batch->mutex);
+	g_queue_push_tail (&batch->results, result);
+
+	if (!batch->flush_scheduled) {
+		GSource *source;
+
+		batch->flush_scheduled = TRUE;
+
+		source = g_idle_source_new ();
+		g_source_set_callback (source,
+		                       (GSourceFunc) batch_flush_results_cb,
+		                       batch, NULL);
+		g_source_attach (source, g_task_get_context (batch->task));
+		g_source_unref (source);
+	}
+
+	g_mutex_unlock (&batch->mutex);
+}
+
+/* Both take ownership of the passed info/error, and free the task */
+static void
+task_return_info (TrackerExtractTask *task,
+                  TrackerExtractInfo *info)
+{
+	if (task->batch) {
+		batch_add_result (task->batch, task->batch_index, info, NULL);
+	} else {
+		g_task_return_pointer (G_TASK (task->res), info,
+		                       (GDestroyNotify) tracker_extract_info_unref);
+	}
+
+	extract_task_free (task);
+}
+
+static void
+task_return_error (TrackerExtractTask *task,
+                   GError             *error)
+{
+	if (task->batch) {
+		batch_add_result (task->batch, task->batch_index, NULL, error);
+	} else {
+		g_task_return_error (G_TASK (task->res), error);
+	}
+
+	extract_task_free (task);
+}
+
 static gboolean
 filter_module (TrackerExtract *extract,
                GModule        *module)
@@ -465,151 +910,383 @@ filter_module (TrackerExtract *extract,
 	return filter;
 }
 
-static gboolean
-get_metadata (TrackerExtractTask *task)
+static void
+task_account_fallback (TrackerExtractTask *task)
 {
-	TrackerExtractInfo *info;
+	TrackerExtractPrivate *priv;
+	guint hop;
 
-#ifdef THREAD_ENABLE_TRACE
-	g_debug ("Thread:%p --> '%s': Collected metadata",
-	         g_thread_self (),
-	         task->file);
-#endif /* THREAD_ENABLE_TRACE */
+	priv = TRACKER_EXTRACT_GET_PRIVATE (task->extract);
+	hop = MIN (task->n_hops, N_FALLBACK_HOPS) - 1;
 
-	if (g_task_return_error_if_cancelled (G_TASK (task->res))) {
-		extract_task_free (task);
-		return FALSE;
+	g_mutex_lock (&priv->task_mutex);
+	latency_histogram_add (&priv->fallback_latency[hop],
+	                       g_get_monotonic_time () - task->fallback_time);
+	g_mutex_unlock (&priv->task_mutex);
+}
+
+static void
+task_account_module (TrackerExtractTask *task,
+                     gboolean            success)
+{
+	TrackerExtractPrivate *priv;
+	StatisticsData *stats_data;
+
+	if (!task->cur_module) {
+		return;
 	}
 
-	if (!filter_module (task->extract, task->cur_module) &&
-	    get_file_metadata (task, &info)) {
-		g_task_return_pointer (G_TASK (task->res), info,
-		                       (GDestroyNotify) tracker_extract_info_unref);
-		extract_task_free (task);
-	} else {
-		/* Reinject the task into the main thread
-		 * queue, so the next module kicks in.
-		 */
-		g_idle_add ((GSourceFunc) dispatch_task_cb, task);
+	priv = TRACKER_EXTRACT_GET_PRIVATE (task->extract);
+
+	g_mutex_lock (&priv->task_mutex);
+
+	stats_data = statistics_data_lookup (priv, task->cur_module);
+	latency_histogram_add (&stats_data->latency, task->run_time);
+	stats_data->bytes_read += MAX (task->size, 0);
+
+	if (!success) {
+		stats_data->fallback_count++;
 	}
 
-	return FALSE;
+	g_mutex_unlock (&priv->task_mutex);
 }
 
-static gpointer
-single_thread_get_metadata (GAsyncQueue *queue)
+static void
+task_account_cancelled (TrackerExtractTask *task)
 {
-	if (!tracker_seccomp_init ())
-		g_assert_not_reached ();
-
-	while (TRUE) {
-		TrackerExtractTask *task;
+	TrackerExtractPrivate *priv;
 
-		task = g_async_queue_pop (queue);
-#ifdef THREAD_ENABLE_TRACE
-		g_debug ("Thread:%p --> '%s': Dispatching in dedicated thread",
-		         g_thread_self(), task->file);
-#endif /* THREAD_ENABLE_TRACE */
-		get_metadata (task);
+	if (!task->cur_module) {
+		return;
 	}
 
-	return NULL;
+	priv = TRACKER_EXTRACT_GET_PRIVATE (task->extract);
+
+	g_mutex_lock (&priv->task_mutex);
+	statistics_data_lookup (priv, task->cur_module)->cancelled_count++;
+	g_mutex_unlock (&priv->task_mutex);
 }
 
-/* This function is executed in the main thread, decides the
- * module that's going to be run for a given task, and dispatches
- * the task according to the threading strategy of that module.
- */
 static gboolean
-dispatch_task_cb (TrackerExtractTask *task)
+get_metadata (TrackerExtractTask *task)
 {
-	TrackerExtractPrivate *priv;
+	TrackerExtractInfo *info;
 	GError *error = NULL;
-	GAsyncQueue *async_queue;
-	GModule *module;
 
 #ifdef THREAD_ENABLE_TRACE
-	g_debug ("Thread:%p (Main) <-- '%s': Handling task...\n",
+	g_debug ("Thread:%p --> '%s': Collected metadata",
 	         g_thread_self (),
 	         task->file);
 #endif /* THREAD_ENABLE_TRACE */
 
-	priv = TRACKER_EXTRACT_GET_PRIVATE (task->extract);
+	if (task->n_hops > 0) {
+		task_account_fallback (task);
+	}
 
-	if (!task->mimetype) {
-		error = g_error_new (tracker_extract_error_quark (),
-		                     TRACKER_EXTRACT_ERROR_NO_MIMETYPE,
-		                     "No mimetype for '%s'", task->file);
+	/* Marked running before checking for cancellation, so
+	 * cancelling either exits or is noticed right here.
+	 */
+	task_set_running (task, TRUE);
+
+	if (g_cancellable_set_error_if_cancelled (task->cancellable, &error)) {
+		task_set_running (task, FALSE);
+		task_account_cancelled (task);
+		task_return_error (task, error);
+		return FALSE;
+	}
+
+	if (!filter_module (task->extract, task->cur_module)) {
+		gboolean success;
+
+		success = get_file_metadata (task, &info);
+		task_set_running (task, FALSE);
+
+		task_account_module (task, success);
+
+		if (success) {
+			task_return_info (task, info);
+			return FALSE;
+		}
 	} else {
-		if (!task->mimetype_handlers) {
-			/* First iteration for task, get the mimetype handlers */
-			task->mimetype_handlers = tracker_extract_module_manager_get_mimetype_handlers (task->mimetype);
-
-			if (!task->mimetype_handlers) {
-				error = g_error_new (tracker_extract_error_quark (),
-				                     TRACKER_EXTRACT_ERROR_NO_EXTRACTOR,
-				                     "No mimetype extractor handlers for uri:'%s' and mime:'%s'",
-				                     task->file, task->mimetype);
-			}
-		} else {
-			/* Any further iteration, should happen rarely if
-			 * most specific handlers know nothing about the file
-			 */
-			if (!tracker_mimetype_info_iter_next (task->mimetype_handlers)) {
-				g_message ("There's no next extractor");
+		task_set_running (task, FALSE);
+	}
 
-				error = g_error_new (tracker_extract_error_quark (),
-				                     TRACKER_EXTRACT_ERROR_NO_EXTRACTOR,
-				                     "Could not get any metadata for uri:'%s' and mime:'%s'",
-				                     task->file, task->mimetype);
-			} else {
-				g_message ("Trying next extractor for '%s'", task->file);
-			}
+	/* Dispatch the task to the next module
+	 * right away, from this thread.
+	 */
+	task->n_hops++;
+	task->fallback_time = g_get_monotonic_time ();
+	dispatch_task (task);
+
+	return FALSE;
+}
+
+static gboolean
+module_queue_is_runnable (ModuleQueue *queue)
+{
+	return (!g_queue_is_empty (&queue->tasks) &&
+	        queue->n_running < queue->max_threads);
+}
+
+/* Called with the scheduler mutex held. Queues are visited
+ * round-robin, so idle workers pick up tasks from whichever
+ * module has some pending, and one busy module can't starve
+ * the others.
+ */
+static ModuleQueue *
+scheduler_pick_queue (TrackerExtractPrivate *priv)
+{
+	guint i, n_queues;
+
+	n_queues = priv->module_queue_list->len;
+
+	for (i = 0; i < n_queues; i++) {
+		ModuleQueue *queue;
+		guint idx;
+
+		idx = (priv->next_queue + i) % n_queues;
+		queue = g_ptr_array_index (priv->module_queue_list, idx);
+
+		if (module_queue_is_runnable (queue)) {
+			priv->next_queue = (idx + 1) % n_queues;
+			return queue;
 		}
 	}
 
-	if (error) {
-		g_task_return_error (G_TASK (task->res), error);
-		extract_task_free (task);
+	return NULL;
+}
+
+static gpointer
+scheduler_worker_func (TrackerExtract *extract)
+{
+	TrackerExtractPrivate *priv;
+
+	if (!tracker_seccomp_init ())
+		g_assert_not_reached ();
+
+	priv = TRACKER_EXTRACT_GET_PRIVATE (extract);
+
+	g_mutex_lock (&priv->scheduler_mutex);
+
+	while (!priv->shutting_down) {
+		TrackerExtractTask *task;
+		ModuleQueue *queue;
+
+		queue = scheduler_pick_queue (priv);
+
+		if (!queue) {
+			priv->n_idle_workers++;
+			g_cond_wait (&priv->scheduler_cond, &priv->scheduler_mutex);
+			priv->n_idle_workers--;
+			continue;
+		}
+
+		task = g_queue_pop_head_link (&queue->tasks)->data;
+		task->queue = NULL;
+		queue->n_running++;
+		g_mutex_unlock (&priv->scheduler_mutex);
+
+#ifdef THREAD_ENABLE_TRACE
+		g_debug ("Thread:%p --> '%s': Dispatching in worker thread",
+		         g_thread_self(), task->file);
+#endif /* THREAD_ENABLE_TRACE */
+		get_metadata (task);
+
+		g_mutex_lock (&priv->scheduler_mutex);
+		queue->n_running--;
+
+		/* Tasks for this module might have been waiting on
+		 * the slot we just released, while we may go on with
+		 * another module's queue.
+		 */
+		if (priv->n_idle_workers > 0 &&
+		    module_queue_is_runnable (queue)) {
+			g_cond_signal (&priv->scheduler_cond);
+		}
+	}
+
+	g_mutex_unlock (&priv->scheduler_mutex);
+
+	return NULL;
+}
+
+/* Called with the scheduler mutex held */
+static gboolean
+scheduler_push_task (TrackerExtractPrivate  *priv,
+                     GModule                *module,
+                     TrackerExtractTask     *task,
+                     GError                **error)
+{
+	ModuleQueue *queue;
+
+	queue = g_hash_table_lookup (priv->module_queues, module);
+
+	if (!queue) {
+		queue = g_slice_new0 (ModuleQueue);
+		queue->module = module;
+		queue->max_threads = tracker_mimetype_info_get_max_threads (task->mimetype_handlers);
+		g_queue_init (&queue->tasks);
+
+		g_hash_table_insert (priv->module_queues, module, queue);
+		g_ptr_array_add (priv->module_queue_list, queue);
+	}
+
+	/* Spawn a new worker if all existing ones are busy
+	 * and we are below the global limit.
+	 */
+	if (priv->n_idle_workers == 0 &&
+	    priv->workers->len < priv->max_workers) {
+		GThread *thread;
+		GError *inner_error = NULL;
+
+		thread = g_thread_try_new ("extract-worker",
+		                           (GThreadFunc) scheduler_worker_func,
+		                           task->extract,
+		                           &inner_error);
+		if (thread) {
+			g_ptr_array_add (priv->workers, thread);
+		} else if (priv->workers->len == 0) {
+			g_propagate_error (error, inner_error);
+			return FALSE;
+		} else {
+			g_warning ("Could not create additional worker thread: %s",
+			           inner_error->message);
+			g_error_free (inner_error);
+		}
+	}
+
+	g_queue_push_tail_link (&queue->tasks, &task->queue_link);
+	task->queue = queue;
+
+	if (priv->n_idle_workers > 0 &&
+	    module_queue_is_runnable (queue)) {
+		g_cond_signal (&priv->scheduler_cond);
+	}
 
+	return TRUE;
+}
+
+/* Picks the next module able to handle the task. Returns %FALSE
+ * if there is none, @error is left unset if the task should just
+ * be discarded.
+ */
+static gboolean
+task_select_next_module (TrackerExtractTask  *task,
+                         GError             **error)
+{
+	if (!task->mimetype) {
+		g_set_error (error, tracker_extract_error_quark (),
+		             TRACKER_EXTRACT_ERROR_NO_MIMETYPE,
+		             "No mimetype for '%s'", task->file);
 		return FALSE;
 	}
 
-	task->cur_module = module = tracker_mimetype_info_get_module (task->mimetype_handlers, &task->cur_func);
+	if (!task->mimetype_handlers) {
+		/* First iteration for task, get the mimetype handlers */
+		task->mimetype_handlers = tracker_extract_module_manager_get_mimetype_handlers (task->mimetype);
+
+		if (!task->mimetype_handlers) {
+			g_set_error (error, tracker_extract_error_quark (),
+			             TRACKER_EXTRACT_ERROR_NO_EXTRACTOR,
+			             "No mimetype extractor handlers for uri:'%s' and mime:'%s'",
+			             task->file, task->mimetype);
+			return FALSE;
+		}
+	} else {
+		/* Any further iteration, should happen rarely if
+		 * most specific handlers know nothing about the file
+		 */
+		if (!tracker_mimetype_info_iter_next (task->mimetype_handlers)) {
+			g_message ("There's no next extractor");
+
+			g_set_error (error, tracker_extract_error_quark (),
+			             TRACKER_EXTRACT_ERROR_NO_EXTRACTOR,
+			             "Could not get any metadata for uri:'%s' and mime:'%s'",
+			             task->file, task->mimetype);
+			return FALSE;
+		}
+
+		g_message ("Trying next extractor for '%s'", task->file);
+	}
+
+	task->cur_module = tracker_mimetype_info_get_module (task->mimetype_handlers, &task->cur_func);
 
 	if (!task->cur_func) {
 		g_warning ("Discarding task, no module able to handle '%s'", task->file);
-		priv->unhandled_count++;
-		extract_task_free (task);
 		return FALSE;
 	}
 
-	async_queue = g_hash_table_lookup (priv->single_thread_extractors, module);
+	return TRUE;
+}
+
+static void
+task_discard (TrackerExtractTask *task,
+              GError             *error)
+{
+	TrackerExtractPrivate *priv;
+
+	if (error) {
+		task_return_error (task, error);
+		return;
+	}
+
+	priv = TRACKER_EXTRACT_GET_PRIVATE (task->extract);
 
-	if (!async_queue) {
-		GThread *thread;
+	g_mutex_lock (&priv->task_mutex);
+	priv->unhandled_count++;
+	g_mutex_unlock (&priv->task_mutex);
 
-		/* No thread created yet for this module, create it
-		 * together with the async queue used to pass data to it
-		 */
-		async_queue = g_async_queue_new ();
-		thread = g_thread_try_new ("single",
-		                           (GThreadFunc) single_thread_get_metadata,
-		                           g_async_queue_ref (async_queue),
-		                           &error);
-		if (!thread) {
-			g_task_return_error (G_TASK (task->res), error);
-			extract_task_free (task);
-			return FALSE;
-		}
+	if (task->batch) {
+		/* The batch still expects a result for every item */
+		task_return_error (task,
+		                   g_error_new (tracker_extract_error_quark (),
+		                                TRACKER_EXTRACT_ERROR_NO_EXTRACTOR,
+		                                "No module able to handle '%s'",
+		                                task->file));
+	} else {
+		extract_task_free (task);
+	}
+}
+
+/* This function can be called from the main thread for new tasks,
+ * or from worker threads when falling back to the next module. It
+ * decides the module that's going to be run for a given task, and
+ * queues the task in the scheduler.
+ */
+static void
+dispatch_task (TrackerExtractTask *task)
+{
+	TrackerExtractPrivate *priv;
+	GError *error = NULL;
 
-		/* We won't join the thread, so just unref it here */
-		g_thread_unref (thread);
+#ifdef THREAD_ENABLE_TRACE
+	g_debug ("Thread:%p <-- '%s': Handling task...\n",
+	         g_thread_self (),
+	         task->file);
+#endif /* THREAD_ENABLE_TRACE */
+
+	priv = TRACKER_EXTRACT_GET_PRIVATE (task->extract);
 
-		g_hash_table_insert (priv->single_thread_extractors, module, async_queue);
+	if (!task_select_next_module (task, &error)) {
+		task_discard (task, error);
+		return;
+	}
+
+	g_mutex_lock (&priv->scheduler_mutex);
+
+	if (!scheduler_push_task (priv, task->cur_module, task, &error)) {
+		g_mutex_unlock (&priv->scheduler_mutex);
+		task_return_error (task, error);
+		return;
 	}
 
-	g_async_queue_push (async_queue, task);
+	g_mutex_unlock (&priv->scheduler_mutex);
+}
+
+static gboolean
+dispatch_task_cb (TrackerExtractTask *task)
+{
+	dispatch_task (task);
 
 	return FALSE;
 }
@@ -646,19 +1323,268 @@ tracker_extract_file (TrackerExtract      *extract,
 		g_warning ("Could not get mimetype, %s", error->message);
 		g_task_return_error (async_task, error);
 	} else {
-		TrackerExtractPrivate *priv;
+		g_idle_add ((GSourceFunc) dispatch_task_cb, task);
+	}
+
+	/* Task takes a ref and if this fails, we want to unref anyway */
+	g_object_unref (async_task);
+}
+
+static gint
+compare_task_module (gconstpointer a,
+                     gconstpointer b)
+{
+	const TrackerExtractTask *task_a = *((TrackerExtractTask **) a);
+	const TrackerExtractTask *task_b = *((TrackerExtractTask **) b);
+
+	if (task_a->cur_module == task_b->cur_module)
+		return task_a->batch_index - task_b->batch_index;
+
+	return (task_a->cur_module < task_b->cur_module) ? -1 : 1;
+}
+
+/* Hints the kernel to start reading the first bytes of the file,
+ * so they are hopefully in the page cache by the time the task is
+ * picked up by a worker.
+ */
+static void
+prefetch_file (const gchar *uri)
+{
+#ifdef HAVE_POSIX_FADVISE
+	gchar *path;
+	int fd;
+
+	path = g_filename_from_uri (uri, NULL, NULL);
+
+	if (!path) {
+		return;
+	}
+
+	fd = tracker_file_open_fd (path);
+	g_free (path);
+
+	if (fd == -1) {
+		return;
+	}
+
+	if (posix_fadvise (fd, 0, BATCH_PREFETCH_SIZE, POSIX_FADV_WILLNEED) != 0)
+		g_debug ("posix_fadvise() call failed: %m");
+
+	close (fd);
+#endif /* HAVE_POSIX_FADVISE */
+}
+
+static void
+prefetch_files_thread (GTask        *task,
+                       gpointer      source_object,
+                       gpointer      task_data,
+                       GCancellable *cancellable)
+{
+	gchar **files = task_data;
+	guint i;
+
+	for (i = 0; files[i] != NULL; i++) {
+		prefetch_file (files[i]);
+	}
+
+	g_task_return_boolean (task, TRUE);
+}
+
+/* Opening the files may block, so it's done in a thread, in the
+ * same order the tasks are queued. Tasks are dispatched right
+ * away, readahead is merely a hint.
+ */
+static void
+prefetch_files (GPtrArray *tasks)
+{
+	GTask *prefetch;
+	gchar **files;
+	guint i;
+
+	files = g_new0 (gchar *, tasks->len + 1);
+
+	for (i = 0; i < tasks->len; i++) {
+		TrackerExtractTask *task = g_ptr_array_index (tasks, i);
+
+		files[i] = g_strdup (task->file);
+	}
+
+	prefetch = g_task_new (NULL, NULL, NULL, NULL);
+	g_task_set_task_data (prefetch, files, (GDestroyNotify) g_strfreev);
+	g_task_run_in_thread (prefetch, prefetch_files_thread);
+	g_object_unref (prefetch);
+}
+
+static void
+dispatch_task_group (TrackerExtractPrivate *priv,
+                     GPtrArray             *tasks,
+                     guint                  start,
+                     guint                  end)
+{
+	guint i;
+
+	g_mutex_lock (&priv->scheduler_mutex);
+
+	for (i = start; i < end; i++) {
+		TrackerExtractTask *task = g_ptr_array_index (tasks, i);
+		GError *error = NULL;
+
+		if (!scheduler_push_task (priv, task->cur_module, task, &error)) {
+			task_return_error (task, error);
+		}
+	}
+
+	g_mutex_unlock (&priv->scheduler_mutex);
+}
+
+/* This function is executed in the main thread, it resolves the
+ * modules for all tasks in the batch, and queues them grouped
+ * by module.
+ */
+static gboolean
+dispatch_batch_cb (GPtrArray *tasks)
+{
+	TrackerExtractPrivate *priv = NULL;
+	GPtrArray *dispatched;
+	guint i, start;
+
+	dispatched = g_ptr_array_sized_new (tasks->len);
+
+	for (i = 0; i < tasks->len; i++) {
+		TrackerExtractTask *task = g_ptr_array_index (tasks, i);
+		GError *error = NULL;
 
 		priv = TRACKER_EXTRACT_GET_PRIVATE (task->extract);
 
-		g_mutex_lock (&priv->task_mutex);
-		priv->running_tasks = g_list_prepend (priv->running_tasks, task);
-		g_mutex_unlock (&priv->task_mutex);
+		if (!task_select_next_module (task, &error)) {
+			task_discard (task, error);
+			continue;
+		}
 
-		g_idle_add ((GSourceFunc) dispatch_task_cb, task);
+		g_ptr_array_add (dispatched, task);
 	}
 
-	/* Task takes a ref and if this fails, we want to unref anyway */
-	g_object_unref (async_task);
+	g_ptr_array_sort (dispatched, compare_task_module);
+
+	if (dispatched->len > 0) {
+		prefetch_files (dispatched);
+	}
+
+	for (i = 0, start = 0; i <= dispatched->len; i++) {
+		TrackerExtractTask *task, *first;
+
+		if (i < dispatched->len) {
+			task = g_ptr_array_index (dispatched, i);
+			first = g_ptr_array_index (dispatched, start);
+
+			if (task->cur_module == first->cur_module) {
+				continue;
+			}
+		}
+
+		if (i > start) {
+			dispatch_task_group (priv, dispatched, start, i);
+		}
+
+		start = i;
+	}
+
+	g_ptr_array_unref (dispatched);
+	g_ptr_array_unref (tasks);
+
+	return FALSE;
+}
+
+/**
+ * tracker_extract_file_batch:
+ * @extract: a #TrackerExtract
+ * @files: (array length=n_files): URIs of the files to extract
+ * @mimetypes: (array length=n_files) (allow-none): mimetypes of @files,
+ *   or %NULL to have them guessed
+ * @cancellables: (array length=n_files) (allow-none): a #GCancellable
+ *   for each of @files, or %NULL
+ * @n_files: number of elements in @files
+ * @item_func: function called as every file is extracted
+ * @cb: callback for when all files have been handled
+ * @user_data: user data for @item_func and @cb
+ *
+ * Extracts metadata for several files at once. Files are dispatched
+ * grouped by the module handling them, and @item_func is called in the
+ * thread-default main context of the caller for each of them as soon
+ * as they are done, in no particular order. Once @item_func has been
+ * called for every file, @cb is called.
+ *
+ * This function can be called in any thread.
+ **/
+void
+tracker_extract_file_batch (TrackerExtract          *extract,
+                            const gchar * const     *files,
+                            const gchar * const     *mimetypes,
+                            GCancellable * const    *cancellables,
+                            guint                    n_files,
+                            TrackerExtractBatchFunc  item_func,
+                            GAsyncReadyCallback      cb,
+                            gpointer                 user_data)
+{
+	TrackerExtractBatch *batch;
+	GPtrArray *tasks;
+	guint i;
+
+	g_return_if_fail (TRACKER_IS_EXTRACT (extract));
+	g_return_if_fail (files != NULL || n_files == 0);
+	g_return_if_fail (item_func != NULL);
+	g_return_if_fail (cb != NULL);
+
+	batch = g_slice_new0 (TrackerExtractBatch);
+	batch->extract = extract;
+	batch->task = g_task_new (extract, NULL, cb, user_data);
+	batch->item_func = item_func;
+	batch->user_data = user_data;
+	batch->n_pending = n_files;
+	g_mutex_init (&batch->mutex);
+	g_queue_init (&batch->results);
+
+	if (n_files == 0) {
+		g_task_return_boolean (batch->task, TRUE);
+		batch_free (batch);
+		return;
+	}
+
+	tasks = g_ptr_array_sized_new (n_files);
+
+	for (i = 0; i < n_files; i++) {
+		TrackerExtractTask *task;
+		GError *error = NULL;
+
+		task = extract_task_new (extract, files[i],
+		                         mimetypes ? mimetypes[i] : NULL,
+		                         cancellables ? cancellables[i] : NULL,
+		                         NULL, &error);
+
+		if (error) {
+			g_warning ("Could not get mimetype, %s", error->message);
+			batch_add_result (batch, i, NULL, error);
+			continue;
+		}
+
+		task->batch = batch;
+		task->batch_index = i;
+		g_ptr_array_add (tasks, task);
+	}
+
+	g_idle_add ((GSourceFunc) dispatch_batch_cb, tasks);
+}
+
+gboolean
+tracker_extract_file_batch_finish (TrackerExtract  *extract,
+                                   GAsyncResult    *res,
+                                   GError         **error)
+{
+	g_return_val_if_fail (TRACKER_IS_EXTRACT (extract), FALSE);
+	g_return_val_if_fail (G_IS_TASK (res), FALSE);
+	g_return_val_if_fail (!error || !*error, FALSE);
+
+	return g_task_propagate_boolean (G_TASK (res), error);
 }
 
 void
@@ -765,3 +1691,226 @@ tracker_extract_file_finish (TrackerExtract  *extract,
 
 	return g_task_propagate_pointer (G_TASK (res), error);
 }
+
+static gint
+compare_module_statistics (gconstpointer a,
+                           gconstpointer b)
+{
+	const ModuleStatistics *stats_a = a, *stats_b = b;
+
+	return strcmp (stats_a->name, stats_b->name);
+}
+
+/* Copies the per-module statistics along with the state of the
+ * module queues, sorted by module name. Locks are taken in turn,
+ * so the queue state might be slightly newer than the counters.
+ */
+static GArray *
+statistics_snapshot (TrackerExtract *extract)
+{
+	TrackerExtractPrivate *priv;
+	GHashTable *positions;
+	GHashTableIter iter;
+	gpointer key, value;
+	GArray *modules;
+	guint i;
+
+	priv = TRACKER_EXTRACT_GET_PRIVATE (extract);
+	modules = g_array_new (FALSE, TRUE, sizeof (ModuleStatistics));
+	/* GModule -> position + 1 in the array */
+	positions = g_hash_table_new (NULL, NULL);
+
+	g_mutex_lock (&priv->task_mutex);
+
+	g_hash_table_iter_init (&iter, priv->statistics_data);
+
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		ModuleStatistics stats = { 0 };
+
+		stats.name = module_get_basename (key);
+		stats.data = *((StatisticsData *) value);
+		g_array_append_val (modules, stats);
+		g_hash_table_insert (positions, key, GUINT_TO_POINTER (modules->len));
+	}
+
+	g_mutex_unlock (&priv->task_mutex);
+
+	g_mutex_lock (&priv->scheduler_mutex);
+
+	for (i = 0; i < priv->module_queue_list->len; i++) {
+		ModuleQueue *queue = g_ptr_array_index (priv->module_queue_list, i);
+		ModuleStatistics *stats;
+		guint pos;
+
+		if (!queue->module) {
+			continue;
+		}
+
+		pos = GPOINTER_TO_UINT (g_hash_table_lookup (positions, queue->module));
+
+		if (pos == 0) {
+			ModuleStatistics new_stats = { 0 };
+
+			new_stats.name = module_get_basename (queue->module);
+			g_array_append_val (modules, new_stats);
+			pos = modules->len;
+		}
+
+		stats = &g_array_index (modules, ModuleStatistics, pos - 1);
+		stats->queue_depth = g_queue_get_length (&queue->tasks);
+		stats->n_running = queue->n_running;
+	}
+
+	g_mutex_unlock (&priv->scheduler_mutex);
+
+	g_hash_table_unref (positions);
+	g_array_sort (modules, compare_module_statistics);
+
+	return modules;
+}
+
+/* Returns a floating a{sa{sv}} variant, holding the counters, queue
+ * state and latency percentiles (in microseconds) of every extractor
+ * module used so far, keyed by module file name.
+ */
+GVariant *
+tracker_extract_get_statistics (TrackerExtract *extract)
+{
+	GVariantBuilder builder;
+	GArray *modules;
+	guint i;
+
+	g_return_val_if_fail (TRACKER_IS_EXTRACT (extract), NULL);
+
+	modules = statistics_snapshot (extract);
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sa{sv}}"));
+
+	for (i = 0; i < modules->len; i++) {
+		ModuleStatistics *stats = &g_array_index (modules, ModuleStatistics, i);
+		LatencyHistogram *latency = &stats->data.latency;
+		GVariantBuilder dict;
+
+		g_variant_builder_init (&dict, G_VARIANT_TYPE_VARDICT);
+		g_variant_builder_add (&dict, "{sv}", "extracted",
+		                       g_variant_new_uint32 (stats->data.extracted_count));
+		g_variant_builder_add (&dict, "{sv}", "failed",
+		                       g_variant_new_uint32 (stats->data.failed_count));
+		g_variant_builder_add (&dict, "{sv}", "fallbacks",
+		                       g_variant_new_uint32 (stats->data.fallback_count));
+		g_variant_builder_add (&dict, "{sv}", "cancelled",
+		                       g_variant_new_uint32 (stats->data.cancelled_count));
+		g_variant_builder_add (&dict, "{sv}", "bytes-read",
+		                       g_variant_new_uint64 (stats->data.bytes_read));
+		g_variant_builder_add (&dict, "{sv}", "queue-depth",
+		                       g_variant_new_uint32 (stats->queue_depth));
+		g_variant_builder_add (&dict, "{sv}", "running",
+		                       g_variant_new_uint32 (stats->n_running));
+		g_variant_builder_add (&dict, "{sv}", "latency-samples",
+		                       g_variant_new_uint32 (latency->total));
+
+		if (latency->total > 0) {
+			g_variant_builder_add (&dict, "{sv}", "latency-p50",
+			                       g_variant_new_int64 (latency_histogram_percentile (latency, 50)));
+			g_variant_builder_add (&dict, "{sv}", "latency-p95",
+			                       g_variant_new_int64 (latency_histogram_percentile (latency, 95)));
+			g_variant_builder_add (&dict, "{sv}", "latency-p99",
+			                       g_variant_new_int64 (latency_histogram_percentile (latency, 99)));
+		}
+
+		g_variant_builder_add (&builder, "{sa{sv}}", stats->name, &dict);
+	}
+
+	g_array_unref (modules);
+
+	return g_variant_builder_end (&builder);
+}
+
+static void
+append_json_string (GString     *str,
+                    const gchar *value)
+{
+	g_string_append_c (str, '"');
+
+	for (; *value; value++) {
+		if (*value == '"' || *value == '\\') {
+			g_string_append_c (str, '\\');
+			g_string_append_c (str, *value);
+		} else if ((guchar) *value < 0x20) {
+			g_string_append_printf (str, "\\u%04x", (guchar) *value);
+		} else {
+			g_string_append_c (str, *value);
+		}
+	}
+
+	g_string_append_c (str, '"');
+}
+
+/* Same data as tracker_extract_get_statistics(), along with
+ * the number of unhandled files, as a JSON object.
+ */
+gchar *
+tracker_extract_get_statistics_json (TrackerExtract *extract)
+{
+	TrackerExtractPrivate *priv;
+	GVariant *statistics, *fields;
+	GVariantIter iter;
+	const gchar *name;
+	GString *str;
+	gboolean first = TRUE;
+	gint unhandled_count;
+
+	g_return_val_if_fail (TRACKER_IS_EXTRACT (extract), NULL);
+
+	priv = TRACKER_EXTRACT_GET_PRIVATE (extract);
+
+	g_mutex_lock (&priv->task_mutex);
+	unhandled_count = priv->unhandled_count;
+	g_mutex_unlock (&priv->task_mutex);
+
+	statistics = g_variant_ref_sink (tracker_extract_get_statistics (extract));
+
+	str = g_string_new ("{\n  \"unhandled\": ");
+	g_string_append_printf (str, "%d,\n  \"modules\": {", unhandled_count);
+
+	g_variant_iter_init (&iter, statistics);
+
+	while (g_variant_iter_next (&iter, "{&s@a{sv}}", &name, &fields)) {
+		GVariantIter field_iter;
+		const gchar *field;
+		GVariant *value;
+		gboolean first_field = TRUE;
+
+		g_string_append (str, first ? "\n    " : ",\n    ");
+		append_json_string (str, name);
+		g_string_append (str, ": {");
+		first = FALSE;
+
+		g_variant_iter_init (&field_iter, fields);
+
+		while (g_variant_iter_next (&field_iter, "{&sv}", &field, &value)) {
+			g_string_append (str, first_field ? " " : ", ");
+			append_json_string (str, field);
+
+			if (g_variant_is_of_type (value, G_VARIANT_TYPE_UINT32)) {
+				g_string_append_printf (str, ": %u", g_variant_get_uint32 (value));
+			} else if (g_variant_is_of_type (value, G_VARIANT_TYPE_UINT64)) {
+				g_string_append_printf (str, ": %" G_GUINT64_FORMAT,
+				                        g_variant_get_uint64 (value));
+			} else {
+				g_string_append_printf (str, ": %" G_GINT64_FORMAT,
+				                        g_variant_get_int64 (value));
+			}
+
+			first_field = FALSE;
+			g_variant_unref (value);
+		}
+
+		g_string_append (str, " }");
+		g_variant_unref (fields);
+	}
+
+	g_string_append (str, first ? "}\n}\n" : "\n  }\n}\n");
+	g_variant_unref (statistics);
+
+	return g_string_free (str, FALSE);
+}
@@ -46,6 +46,12 @@ typedef enum {
 	TRACKER_EXTRACT_ERROR_NO_EXTRACTOR
 } TrackerExtractError;
 
+typedef void (* TrackerExtractBatchFunc) (TrackerExtract     *extract,
+                                          guint               index,
+                                          TrackerExtractInfo *info,
+                                          const GError       *error,
+                                          gpointer            user_data);
+
 struct TrackerExtract {
 	GObject parent;
 };
@@ -70,6 +76,21 @@ TrackerExtractInfo *
                                                          GAsyncResult           *res,
                                                          GError                **error);
 
+void            tracker_extract_file_batch              (TrackerExtract         *extract,
+                                                         const gchar * const    *files,
+                                                         const gchar * const    *mimetypes,
+                                                         GCancellable * const   *cancellables,
+                                                         guint                   n_files,
+                                                         TrackerExtractBatchFunc item_func,
+                                                         GAsyncReadyCallback     cb,
+                                                         gpointer                user_data);
+gboolean        tracker_extract_file_batch_finish       (TrackerExtract         *extract,
+                                                         GAsyncResult           *res,
+                                                         GError                **error);
+
+GVariant *      tracker_extract_get_statistics          (TrackerExtract         *extract);
+gchar *         tracker_extract_get_statistics_json     (TrackerExtract         *extract);
+
 void            tracker_extract_dbus_start              (TrackerExtract         *extract);
 void            tracker_extract_dbus_stop               (TrackerExtract         *extract);
 
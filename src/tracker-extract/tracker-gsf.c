@@ -36,141 +36,242 @@
 /* Note: 20 MBytes of max size is really assumed to be a safe limit. */
 #define XML_MAX_BYTES_READ         (20u << 20)  /* bytes */
 
+struct _TrackerGsfArchive {
+	gchar *uri;
+	FILE *file;
+	GsfInput *src;
+	GsfInfile *infile;
+
+	/* Directories already looked up, by path in the archive */
+	GHashTable *dirs;
+};
+
 /**
  * based on find_member() from vsd_utils.c:
  * http://vsdump.sourcearchive.com/documentation/0.0.44/vsd__utils_8c-source.html
+ *
+ * Directories are cached in the archive, so members sharing
+ * a directory only resolve it once.
  */
 static GsfInput *
-find_member (GsfInfile *arch,
-             gchar const *name)
+find_member (TrackerGsfArchive *archive,
+             gchar const       *name)
 {
+	GsfInfile *dir = archive->infile;
+	gchar const *cur = name;
 	gchar const *slash;
 
-	slash = strchr (name, '/');
-
-	if (slash) {
-		gchar *dirname;
+	while ((slash = strchr (cur, '/')) != NULL) {
 		GsfInput *member;
-
-		dirname = g_strndup (name, slash - name);
+		gchar *path;
 
 		/**
 		 * Ignore if the directory is the current one that is ".".
 		 * Go to next direcotry if exists
 		 */
+		if (slash - cur == 1 && cur[0] == '.') {
+			cur = slash + 1;
+			continue;
+		}
+
+		path = g_strndup (name, slash - name);
+		member = g_hash_table_lookup (archive->dirs, path);
+
+		if (!member) {
+			gchar *dirname;
 
-		if (strcmp (dirname, ".") == 0) {
-			member = find_member (arch, slash + 1);
-		} else if ((member = gsf_infile_child_by_name (arch, dirname)) != NULL) {
-			GsfInfile *dir;
+			dirname = g_strndup (cur, slash - cur);
+			member = gsf_infile_child_by_name (dir, dirname);
+			g_free (dirname);
 
-			dir = GSF_INFILE (member);
-			member = find_member (dir, slash + 1);
-			g_object_unref (dir);
+			if (!member || !GSF_IS_INFILE (member)) {
+				g_clear_object (&member);
+				g_free (path);
+				return NULL;
+			}
+
+			g_hash_table_insert (archive->dirs, path, member);
+		} else {
+			g_free (path);
 		}
 
-		g_free (dirname);
-		return member;
-	} else {
-		return gsf_infile_child_by_name (arch, name);
+		dir = GSF_INFILE (member);
+		cur = slash + 1;
 	}
+
+	return gsf_infile_child_by_name (dir, cur);
 }
 
 /**
- * tracker_gsf_parse_xml_in_zip:
+ * tracker_gsf_archive_open:
  * @zip_file_uri: URI of the ZIP archive
+ *
+ * Opens a ZIP compressed archive and reads its central directory,
+ *  so several XML files can be parsed out of it with
+ *  tracker_gsf_archive_parse_xml().
+ *
+ * Returns: a new #TrackerGsfArchive, or %NULL if the file could not be
+ *  opened or is not a ZIP archive.
+ */
+TrackerGsfArchive *
+tracker_gsf_archive_open (const gchar *zip_file_uri)
+{
+	TrackerGsfArchive *archive;
+	GError *error = NULL;
+	gchar *filename;
+
+	/* Get filename from the given URI */
+	if ((filename = g_filename_from_uri (zip_file_uri,
+	                                     NULL, &error)) == NULL) {
+		g_warning ("Can't get filename from uri '%s': %s",
+		           zip_file_uri, error ? error->message : "no error given");
+		g_clear_error (&error);
+		return NULL;
+	}
+
+	archive = g_slice_new0 (TrackerGsfArchive);
+	archive->uri = g_strdup (zip_file_uri);
+	archive->dirs = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                       g_free, g_object_unref);
+
+	/* Create a new Input GSF object for the given file */
+	archive->file = tracker_file_open (filename);
+	if (!archive->file) {
+		g_warning ("Can't open file from uri '%s': %s",
+		           zip_file_uri, g_strerror (errno));
+	} else if ((archive->src = gsf_input_stdio_new_FILE (filename, archive->file, TRUE)) == NULL) {
+		g_warning ("Failed creating a GSF Input object for '%s': %s",
+		           zip_file_uri, error ? error->message : "no error given");
+	}
+	/* Input object is a Zip file */
+	else if ((archive->infile = gsf_infile_zip_new (archive->src, &error)) == NULL) {
+		g_warning ("'%s' Not a zip file: %s",
+		           zip_file_uri, error ? error->message : "no error given");
+	}
+
+	g_clear_error (&error);
+	g_free (filename);
+
+	if (!archive->infile) {
+		tracker_gsf_archive_free (archive);
+		return NULL;
+	}
+
+	return archive;
+}
+
+/**
+ * tracker_gsf_archive_free:
+ * @archive: a #TrackerGsfArchive
+ *
+ * Closes the archive and frees all associated resources.
+ */
+void
+tracker_gsf_archive_free (TrackerGsfArchive *archive)
+{
+	g_return_if_fail (archive != NULL);
+
+	/* Members hold references on the source, drop them first */
+	g_hash_table_unref (archive->dirs);
+
+	if (archive->infile)
+		g_object_unref (archive->infile);
+	if (archive->src)
+		g_object_unref (archive->src);
+	if (archive->file)
+		tracker_file_close (archive->file, FALSE);
+
+	g_free (archive->uri);
+	g_slice_free (TrackerGsfArchive, archive);
+}
+
+/**
+ * tracker_gsf_archive_parse_xml:
+ * @archive: a #TrackerGsfArchive
  * @xml_filename: Name of the XML file stored inside the ZIP archive
  * @context: Markup context to be used when parsing the XML
  *
  * This function reads and parses the contents of an XML file stored
- *  inside a ZIP compressed archive. Reading and parsing is done buffered, and
+ *  inside the archive. Reading and parsing is done buffered, and
  *  maximum size of the uncompressed XML file is limited to be to 20MBytes.
  */
 void
-tracker_gsf_parse_xml_in_zip (const gchar          *zip_file_uri,
-                              const gchar          *xml_filename,
-                              GMarkupParseContext  *context,
-                              GError              **err)
+tracker_gsf_archive_parse_xml (TrackerGsfArchive    *archive,
+                               const gchar          *xml_filename,
+                               GMarkupParseContext  *context,
+                               GError              **err)
 {
-	gchar *filename;
 	GError *error = NULL;
-	GsfInfile *infile = NULL;
-	GsfInput *src = NULL;
-	GsfInput *member = NULL;
-	FILE *file;
+	GsfInput *member;
+
+	g_return_if_fail (archive != NULL);
 
 	g_debug ("Parsing '%s' XML file contained inside zip archive...",
 	         xml_filename);
 
-	/* Get filename from the given URI */
-	if ((filename = g_filename_from_uri (zip_file_uri,
-	                                     NULL, &error)) == NULL) {
-		g_warning ("Can't get filename from uri '%s': %s",
-		           zip_file_uri, error ? error->message : "no error given");
-	} else { /* Create a new Input GSF object for the given file */
-
-		file = tracker_file_open (filename);
-		if (!file) {
-			g_warning ("Can't open file from uri '%s': %s",
-			           zip_file_uri, g_strerror (errno));
-		} else if ((src = gsf_input_stdio_new_FILE (filename, file, TRUE)) == NULL) {
-			g_warning ("Failed creating a GSF Input object for '%s': %s",
-			           zip_file_uri, error ? error->message : "no error given");
-		}
-		/* Input object is a Zip file */
-		else if ((infile = gsf_infile_zip_new (src, &error)) == NULL) {
-			g_warning ("'%s' Not a zip file: %s",
-			           zip_file_uri, error ? error->message : "no error given");
-		}
-		/* Look for requested filename inside the ZIP file */
-		else if ((member = find_member (infile, xml_filename)) == NULL) {
-			g_warning ("No member '%s' in zip file '%s'",
-			           xml_filename, zip_file_uri);
-		}
-		/* Load whole contents of the internal file in the xml buffer */
-		else {
-			guint8 buf[XML_BUFFER_SIZE];
-			size_t remaining_size, chunk_size, accum;
+	/* Look for requested filename inside the ZIP file */
+	if ((member = find_member (archive, xml_filename)) == NULL) {
+		g_warning ("No member '%s' in zip file '%s'",
+		           xml_filename, archive->uri);
+	}
+	/* Load whole contents of the internal file in the xml buffer */
+	else {
+		guint8 buf[XML_BUFFER_SIZE];
+		size_t remaining_size, chunk_size, accum;
 
-			/* Get whole size of the contents to read */
-			remaining_size = (size_t) gsf_input_size (GSF_INPUT (member));
+		/* Get whole size of the contents to read */
+		remaining_size = (size_t) gsf_input_size (GSF_INPUT (member));
 
-			/* Note that gsf_input_read() needs to be able to read ALL specified
-			 *  number of bytes, or it will fail */
-			chunk_size = MIN (remaining_size, XML_BUFFER_SIZE);
+		/* Note that gsf_input_read() needs to be able to read ALL specified
+		 *  number of bytes, or it will fail */
+		chunk_size = MIN (remaining_size, XML_BUFFER_SIZE);
 
-			accum = 0;
-			while (!error &&
-			       accum  <= XML_MAX_BYTES_READ &&
-			       chunk_size > 0 &&
-			       gsf_input_read (GSF_INPUT (member), chunk_size, buf) != NULL) {
+		accum = 0;
+		while (!error &&
+		       accum  <= XML_MAX_BYTES_READ &&
+		       chunk_size > 0 &&
+		       gsf_input_read (GSF_INPUT (member), chunk_size, buf) != NULL) {
 
-				/* update accumulated count */
-				accum += chunk_size;
+			/* update accumulated count */
+			accum += chunk_size;
 
-				/* Pass the read stream to the context parser... */
-				g_markup_parse_context_parse (context, buf, chunk_size, &error);
+			/* Pass the read stream to the context parser... */
+			g_markup_parse_context_parse (context, buf, chunk_size, &error);
 
-				/* update bytes to be read */
-				remaining_size -= chunk_size;
-				chunk_size = MIN (remaining_size, XML_BUFFER_SIZE);
-			}
+			/* update bytes to be read */
+			remaining_size -= chunk_size;
+			chunk_size = MIN (remaining_size, XML_BUFFER_SIZE);
 		}
 
-		if (file) {
-			tracker_file_close (file, FALSE);
-		}
+		g_object_unref (member);
 	}
 
-	g_free (filename);
-
 	if (error)
 		g_propagate_error (err, error);
-	if (infile)
-		g_object_unref (infile);
-	if (src)
-		g_object_unref (src);
-	if (member)
-		g_object_unref (member);
 }
 
+/**
+ * tracker_gsf_parse_xml_in_zip:
+ * @zip_file_uri: URI of the ZIP archive
+ * @xml_filename: Name of the XML file stored inside the ZIP archive
+ * @context: Markup context to be used when parsing the XML
+ *
+ * Convenience function to parse a single XML file out of a ZIP
+ *  archive, see tracker_gsf_archive_parse_xml(). Use a
+ *  #TrackerGsfArchive when parsing several files from the same archive.
+ */
+void
+tracker_gsf_parse_xml_in_zip (const gchar          *zip_file_uri,
+                              const gchar          *xml_filename,
+                              GMarkupParseContext  *context,
+                              GError              **err)
+{
+	TrackerGsfArchive *archive;
+
+	archive = tracker_gsf_archive_open (zip_file_uri);
+
+	if (archive) {
+		tracker_gsf_archive_parse_xml (archive, xml_filename, context, err);
+		tracker_gsf_archive_free (archive);
+	}
+}
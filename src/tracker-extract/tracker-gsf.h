@@ -25,6 +25,15 @@
 
 G_BEGIN_DECLS
 
+typedef struct _TrackerGsfArchive TrackerGsfArchive;
+
+TrackerGsfArchive * tracker_gsf_archive_open      (const gchar          *zip_file_uri);
+void                tracker_gsf_archive_free      (TrackerGsfArchive    *archive);
+void                tracker_gsf_archive_parse_xml (TrackerGsfArchive    *archive,
+                                                   const gchar          *xml_filename,
+                                                   GMarkupParseContext  *context,
+                                                   GError              **error);
+
 void tracker_gsf_parse_xml_in_zip (const gchar          *zip_file_uri,
                                    const gchar          *xml_filename,
                                    GMarkupParseContext  *context,
@@ -188,6 +188,35 @@ signal_handler (gpointer user_data)
 	return G_SOURCE_CONTINUE;
 }
 
+/* SIGUSR1 dumps the per-module statistics, so they can be
+ * inspected on a live process without going through DBus.
+ */
+static gboolean
+dump_statistics_cb (gpointer user_data)
+{
+	TrackerExtract *extract = user_data;
+	GError *error = NULL;
+	gchar *json, *path;
+
+	json = tracker_extract_get_statistics_json (extract);
+	path = g_build_filename (g_get_user_data_dir (),
+	                         "tracker",
+	                         "extract-statistics.json",
+	                         NULL);
+
+	if (g_file_set_contents (path, json, -1, &error)) {
+		g_message ("Statistics written to '%s'", path);
+	} else {
+		g_warning ("Could not write statistics: %s", error->message);
+		g_error_free (error);
+	}
+
+	g_free (path);
+	g_free (json);
+
+	return G_SOURCE_CONTINUE;
+}
+
 static void
 initialize_signal_handler (void)
 {
@@ -233,6 +262,10 @@ sanity_check_option_values (TrackerConfig *config)
 	           tracker_config_get_sched_idle (config));
 	g_message ("  Max bytes (per file)  .................  %d",
 	           tracker_config_get_max_bytes (config));
+	g_message ("  Max threads  ..........................  %d",
+	           tracker_config_get_max_threads (config));
+	g_message ("  Max extracting files  .................  %d",
+	           tracker_config_get_max_extracting_files (config));
 }
 
 TrackerConfig *
@@ -321,6 +354,7 @@ main (int argc, char *argv[])
 	TrackerMinerProxy *proxy;
 	TrackerDomainOntology *domain_ontology;
 	gchar *dbus_name;
+	guint statistics_signal_id = 0;
 
 	bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
 	bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
@@ -466,8 +500,16 @@ main (int argc, char *argv[])
 
 	initialize_signal_handler ();
 
+#ifndef G_OS_WIN32
+	statistics_signal_id = g_unix_signal_add (SIGUSR1, dump_statistics_cb, extract);
+#endif /* G_OS_WIN32 */
+
 	g_main_loop_run (main_loop);
 
+	if (statistics_signal_id != 0) {
+		g_source_remove (statistics_signal_id);
+	}
+
 	my_main_loop = main_loop;
 	main_loop = NULL;
 	g_main_loop_unref (my_main_loop);
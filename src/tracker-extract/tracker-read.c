@@ -20,8 +20,10 @@
 #include "config.h"
 
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 
 #include <glib.h>
 #include <gio/gio.h>
@@ -160,8 +162,11 @@ process_chunk (const gchar  *read_bytes,
 	return TRUE;
 }
 
+/* Validates @text as UTF-8, converting it if needed. Plain UTF-8 input
+ * is copied only once, into the returned string. */
 static gchar *
-process_whole_string (GString  *s)
+process_text (const gchar *text,
+              gsize        text_len)
 {
 	gchar *utf8 = NULL;
 	gsize  utf8_len = 0;
@@ -170,23 +175,23 @@ process_whole_string (GString  *s)
 	/* Support also UTF-16 encoded text files, as the ones generated in
 	 * Windows OS. We will only accept text files in UTF-16 which come
 	 * with a proper BOM. */
-	if (s->len > 2) {
+	if (text_len > 2) {
 		GError *error = NULL;
 
-		if (memcmp (s->str, "\xFF\xFE", 2) == 0) {
+		if (memcmp (text, "\xFF\xFE", 2) == 0) {
 			g_debug ("String comes in UTF-16LE, converting");
-			utf8 = g_convert (&(s->str[2]),
-			                  s->len - 2,
+			utf8 = g_convert (&text[2],
+			                  text_len - 2,
 			                  "UTF-8",
 			                  "UTF-16LE",
 			                  NULL,
 			                  &utf8_len,
 			                  &error);
 
-		} else if (memcmp (s->str, "\xFE\xFF", 2) == 0) {
+		} else if (memcmp (text, "\xFE\xFF", 2) == 0) {
 			g_debug ("String comes in UTF-16BE, converting");
-			utf8 = g_convert (&(s->str[2]),
-			                  s->len - 2,
+			utf8 = g_convert (&text[2],
+			                  text_len - 2,
 			                  "UTF-8",
 			                  "UTF-16BE",
 			                  NULL,
@@ -198,49 +203,42 @@ process_whole_string (GString  *s)
 			g_warning ("Couldn't convert string from UTF-16 to UTF-8...: %s",
 			           error->message);
 			g_error_free (error);
-			g_string_free (s, TRUE);
 			return NULL;
 		}
 	}
 
-	if (utf8) {
-		n_valid_utf8_bytes = utf8_len;
-		g_string_free (s, TRUE);
-	} else {
-		utf8_len = s->len;
-		utf8 = g_string_free (s, FALSE);
-
+	if (!utf8) {
 		/* Get number of valid UTF-8 bytes found */
-		tracker_text_validate_utf8 (utf8,
-					    utf8_len,
-					    NULL,
-					    &n_valid_utf8_bytes);
-	}
+		tracker_text_validate_utf8 (text,
+		                            text_len,
+		                            NULL,
+		                            &n_valid_utf8_bytes);
+
+		/* A valid UTF-8 file will be that where all read bytes are valid,
+		 *  with a margin of 3 bytes for the last UTF-8 character which might
+		 *  have been cut. */
+		if (text_len - n_valid_utf8_bytes > 3) {
+			/* If not UTF-8, try to get contents in guessed encoding
+			 *  (returns valid UTF-8) */
+			utf8 = get_string_from_guessed_encoding (text,
+			                                         text_len,
+			                                         &utf8_len);
+			if (!utf8)
+				return NULL;
+		} else {
+			if (n_valid_utf8_bytes < text_len) {
+				g_debug ("  Truncating to last valid UTF-8 character "
+				         "(%" G_GSSIZE_FORMAT "/%" G_GSSIZE_FORMAT " bytes)",
+				         n_valid_utf8_bytes,
+				         text_len);
+			}
 
-	/* A valid UTF-8 file will be that where all read bytes are valid,
-	 *  with a margin of 3 bytes for the last UTF-8 character which might
-	 *  have been cut. */
-	if (utf8_len - n_valid_utf8_bytes > 3) {
-		gchar *from_guessed_str;
-		gsize  from_guessed_str_len;
-
-		/* If not UTF-8, try to get contents in guessed encoding
-		 *  (returns valid UTF-8) */
-		from_guessed_str = get_string_from_guessed_encoding (utf8,
-		                                                     utf8_len,
-		                                                     &from_guessed_str_len);
-		g_free (utf8);
-		if (!from_guessed_str)
-			return NULL;
-		utf8 = from_guessed_str;
-		utf8_len = from_guessed_str_len;
-	} else if (n_valid_utf8_bytes < utf8_len) {
-		g_debug ("  Truncating to last valid UTF-8 character "
-		         "(%" G_GSSIZE_FORMAT "/%" G_GSSIZE_FORMAT " bytes)",
-		         n_valid_utf8_bytes,
-		         utf8_len);
-		utf8[n_valid_utf8_bytes] = '\0';
-		utf8_len = n_valid_utf8_bytes;
+			if (n_valid_utf8_bytes < 1)
+				return NULL;
+
+			utf8 = g_strndup (text, n_valid_utf8_bytes);
+			utf8_len = n_valid_utf8_bytes;
+		}
 	}
 
 	if (utf8_len < 1) {
@@ -251,6 +249,17 @@ process_whole_string (GString  *s)
 	return utf8;
 }
 
+static gchar *
+process_whole_string (GString  *s)
+{
+	gchar *utf8;
+
+	utf8 = process_text (s->str, s->len);
+	g_string_free (s, TRUE);
+
+	return utf8;
+}
+
 /**
  * tracker_read_text_from_stream:
  * @stream: input stream to read from
@@ -315,29 +324,14 @@ tracker_read_text_from_stream (GInputStream *stream,
 }
 
 
-/**
- * tracker_read_text_from_fd:
- * @fd: input fd to read from
- * @max_bytes: max number of bytes to read from @fd
- *
- * Reads up to @max_bytes from @fd, and validates the read text as proper
- *  UTF-8. Will also properly close the FD when finishes.
- *
- * If the input text is not UTF-8 it will also try to decode it based on the
- * current locale, or windows-1252, or UTF-16.
- *
- * Returns: newly-allocated NUL-terminated UTF-8 string with the read text.
- **/
-gchar *
-tracker_read_text_from_fd (gint  fd,
-                           gsize max_bytes)
+static gchar *
+read_text_from_fd_buffered (gint  fd,
+                            gsize max_bytes)
 {
 	FILE *fz;
 	GString *s = NULL;
 	gsize n_bytes_remaining = max_bytes;
 
-	g_return_val_if_fail (max_bytes > 0, NULL);
-
 	if ((fz = fdopen (fd, "r")) == NULL) {
 		g_warning ("Cannot read from FD... could not extract text");
 		close (fd);
@@ -382,3 +376,104 @@ tracker_read_text_from_fd (gint  fd,
 	/* Validate UTF-8 if something was read, and return it */
 	return s ? process_whole_string (s) : NULL;
 }
+
+/* Reads the first @max_bytes of the regular file behind @fd in one
+ * go and validates them in place, so the only copy made besides the
+ * read is the returned string. The file is read rather than mapped,
+ * as it could be truncated underneath us. Returns %FALSE if @fd is
+ * not a regular file, in which case @fd is left untouched.
+ */
+static gboolean
+read_text_from_fd_direct (gint    fd,
+                          gsize   max_bytes,
+                          gchar **text)
+{
+	struct stat st;
+	gchar *contents;
+	gsize len, n_read = 0;
+
+	if (fstat (fd, &st) == -1 ||
+	    !S_ISREG (st.st_mode) ||
+	    st.st_size <= 0) {
+		return FALSE;
+	}
+
+	len = MIN ((guint64) st.st_size, max_bytes);
+	contents = g_malloc (len);
+
+	while (n_read < len) {
+		gssize n;
+
+		n = pread (fd, contents + n_read, len - n_read, n_read);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+
+		if (n < 0) {
+			g_debug ("Could not read text file: %m");
+			break;
+		}
+
+		if (n == 0) {
+			/* Truncated since we checked its size */
+			break;
+		}
+
+		n_read += n;
+	}
+
+	/* Same checks process_chunk() does on the first buffer */
+	if (n_read <= 3) {
+		g_debug ("  File has less than 3 characters in it, "
+		         "not indexing file");
+		*text = NULL;
+	} else if (n_read >= BUFFER_SIZE &&
+	           !memchr (contents, '\n', BUFFER_SIZE - 1)) {
+		g_debug ("  No '\\n' in the first %d bytes, "
+		         "not indexing file",
+		         BUFFER_SIZE);
+		*text = NULL;
+	} else {
+		g_debug ("  Read %" G_GSIZE_FORMAT " bytes from file", n_read);
+		*text = process_text (contents, n_read);
+	}
+
+	g_free (contents);
+
+#ifdef HAVE_POSIX_FADVISE
+	if (posix_fadvise (fd, 0, 0, POSIX_FADV_DONTNEED) != 0)
+		g_warning ("posix_fadvise() call failed: %m");
+#endif /* HAVE_POSIX_FADVISE */
+	close (fd);
+
+	return TRUE;
+}
+
+/**
+ * tracker_read_text_from_fd:
+ * @fd: input fd to read from
+ * @max_bytes: max number of bytes to read from @fd
+ *
+ * Reads up to @max_bytes from @fd, and validates the read text as proper
+ *  UTF-8. Will also properly close the FD when finishes.
+ *
+ * If the input text is not UTF-8 it will also try to decode it based on the
+ * current locale, or windows-1252, or UTF-16.
+ *
+ * Returns: newly-allocated NUL-terminated UTF-8 string with the read text.
+ **/
+gchar *
+tracker_read_text_from_fd (gint  fd,
+                           gsize max_bytes)
+{
+	gchar *text;
+
+	g_return_val_if_fail (max_bytes > 0, NULL);
+
+	/* Regular files are read at once, anything else (pipes,
+	 * sockets...) goes through stdio. */
+	if (read_text_from_fd_direct (fd, max_bytes, &text))
+		return text;
+
+	return read_text_from_fd_buffered (fd, max_bytes);
+}
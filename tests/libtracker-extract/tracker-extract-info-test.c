@@ -17,7 +17,11 @@
  * Boston, MA  02110-1301, USA.
  */
 
+#include <string.h>
+#include <unistd.h>
+
 #include <glib.h>
+#include <glib/gstdio.h>
 
 #include <libtracker-extract/tracker-extract.h>
 
@@ -59,6 +63,63 @@ test_extract_info_empty_objects (void)
         g_object_unref (file);
 }
 
+static void
+test_extract_info_contents (void)
+{
+        TrackerExtractInfo *info;
+        GBytes *contents, *shared;
+        GError *error = NULL;
+        GFile *file;
+        gchar *path;
+        gint fd;
+
+        fd = g_file_open_tmp ("tracker-extract-info-test-XXXXXX", &path, &error);
+        g_assert_no_error (error);
+        g_assert_cmpint (write (fd, "contents", 8), ==, 8);
+        close (fd);
+
+        file = g_file_new_for_path (path);
+        info = tracker_extract_info_new (file, "text/plain");
+
+        contents = tracker_extract_info_get_contents (info, &error);
+        g_assert_no_error (error);
+        g_assert_cmpuint (g_bytes_get_size (contents), ==, 8);
+        g_assert (memcmp (g_bytes_get_data (contents, NULL), "contents", 8) == 0);
+
+        /* Further callers get the same mapping */
+        shared = tracker_extract_info_get_contents (info, &error);
+        g_assert_no_error (error);
+        g_assert (g_bytes_get_data (shared, NULL) == g_bytes_get_data (contents, NULL));
+        g_bytes_unref (shared);
+
+        /* Contents stay valid after the info is gone */
+        tracker_extract_info_unref (info);
+        g_assert (memcmp (g_bytes_get_data (contents, NULL), "contents", 8) == 0);
+        g_bytes_unref (contents);
+
+        g_object_unref (file);
+        g_unlink (path);
+        g_free (path);
+}
+
+static void
+test_extract_info_contents_missing (void)
+{
+        TrackerExtractInfo *info;
+        GError *error = NULL;
+        GFile *file;
+
+        file = g_file_new_for_path ("./imaginary-file");
+        info = tracker_extract_info_new (file, "imaginary/mime");
+
+        g_assert (tracker_extract_info_get_contents (info, &error) == NULL);
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+        g_error_free (error);
+
+        tracker_extract_info_unref (info);
+        g_object_unref (file);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -68,6 +129,10 @@ main (int argc, char **argv)
                          test_extract_info_empty_objects);
         g_test_add_func ("/libtracker-extract/extract-info/setters",
                          test_extract_info_setters);
+        g_test_add_func ("/libtracker-extract/extract-info/contents",
+                         test_extract_info_contents);
+        g_test_add_func ("/libtracker-extract/extract-info/contents-missing",
+                         test_extract_info_contents_missing);
 
         return g_test_run ();
 }
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2017, The Tracker developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include <glib.h>
+
+#include <libtracker-extract/tracker-extract.h>
+
+static gboolean
+strv_contains (GStrv        strv,
+               const gchar *str)
+{
+        guint i;
+
+        for (i = 0; strv[i]; i++) {
+                if (g_strcmp0 (strv[i], str) == 0)
+                        return TRUE;
+        }
+
+        return FALSE;
+}
+
+static void
+test_module_manager_literal (void)
+{
+        GStrv types;
+
+        types = tracker_extract_module_manager_get_fallback_rdf_types ("image/png");
+        g_assert (types != NULL);
+        g_assert (strv_contains (types, "nfo:Image"));
+        g_strfreev (types);
+}
+
+static void
+test_module_manager_media_type (void)
+{
+        GStrv types;
+
+        /* Only matched by the generic text rule */
+        types = tracker_extract_module_manager_get_fallback_rdf_types ("text/plain");
+        g_assert (types != NULL);
+        g_assert (strv_contains (types, "nfo:PlainTextDocument"));
+        g_assert (!strv_contains (types, "nfo:SourceCode"));
+        g_strfreev (types);
+}
+
+static void
+test_module_manager_rule_order (void)
+{
+        GStrv types;
+
+        /* Matched by both the source code rule and the
+         * generic text one, the former must take precedence.
+         */
+        types = tracker_extract_module_manager_get_fallback_rdf_types ("text/x-csrc");
+        g_assert (types != NULL);
+        g_assert (strv_contains (types, "nfo:SourceCode"));
+        g_strfreev (types);
+}
+
+static void
+test_module_manager_no_match (void)
+{
+        TrackerMimetypeInfo *info;
+        GStrv types;
+        guint i;
+
+        /* Do it twice, so the cached miss is checked too */
+        for (i = 0; i < 2; i++) {
+                info = tracker_extract_module_manager_get_mimetype_handlers ("imaginary/mime");
+                g_assert (info == NULL);
+
+                types = tracker_extract_module_manager_get_fallback_rdf_types ("imaginary/mime");
+                g_assert (types != NULL);
+                g_assert_cmpint (g_strv_length (types), ==, 0);
+                g_strfreev (types);
+        }
+}
+
+static void
+test_module_manager_peek (void)
+{
+        const gchar * const *types;
+        GStrv copy;
+        guint i;
+
+        types = tracker_extract_module_manager_peek_fallback_rdf_types ("image/png");
+        g_assert (types != NULL);
+        g_assert (strv_contains ((GStrv) types, "nfo:Image"));
+
+        /* Cached per mimetype, and matching the copying variant */
+        g_assert (tracker_extract_module_manager_peek_fallback_rdf_types ("image/png") == types);
+
+        copy = tracker_extract_module_manager_get_fallback_rdf_types ("image/png");
+        g_assert_cmpuint (g_strv_length (copy), ==, g_strv_length ((GStrv) types));
+
+        for (i = 0; types[i]; i++)
+                g_assert_cmpstr (copy[i], ==, types[i]);
+
+        g_strfreev (copy);
+
+        types = tracker_extract_module_manager_peek_fallback_rdf_types ("imaginary/mime");
+        g_assert (types != NULL);
+        g_assert (types[0] == NULL);
+}
+
+int
+main (int argc, char **argv)
+{
+        gchar *rules_dir;
+        gint result;
+
+        g_test_init (&argc, &argv, NULL);
+
+        rules_dir = g_build_filename (TOP_SRCDIR, "src", "tracker-extract", NULL);
+        g_setenv ("TRACKER_EXTRACTOR_RULES_DIR", rules_dir, TRUE);
+        g_unsetenv ("TRACKER_EXTRACTOR_RULES_CACHE");
+
+        g_assert (tracker_extract_module_manager_init ());
+
+        g_test_add_func ("/libtracker-extract/module-manager/literal",
+                         test_module_manager_literal);
+        g_test_add_func ("/libtracker-extract/module-manager/media-type",
+                         test_module_manager_media_type);
+        g_test_add_func ("/libtracker-extract/module-manager/rule-order",
+                         test_module_manager_rule_order);
+        g_test_add_func ("/libtracker-extract/module-manager/no-match",
+                         test_module_manager_no_match);
+        g_test_add_func ("/libtracker-extract/module-manager/peek",
+                         test_module_manager_peek);
+
+        result = g_test_run ();
+        g_free (rules_dir);
+
+        return result;
+}
@@ -202,6 +202,89 @@ test_text_validate_utf8 ()
 	g_assert_cmpuint (s->len, ==, strlen ("abcdefghijk"));
 	g_assert_cmpstr (s->str, ==, "abcdefghijk");
 	g_string_free (s, TRUE);
+
+	/* Long ASCII runs mixed with multi-byte characters are fully valid */
+	utf8_len = 0;
+	result = tracker_text_validate_utf8 ("0123456789abcdef" "\xCE\xA9"
+	                                     "0123456789abcdef" "\xE8\xAA\x9E" "xyz",
+	                                     -1,
+	                                     NULL,
+	                                     &utf8_len);
+	g_assert_cmpuint (result, ==, 1);
+	g_assert_cmpuint (utf8_len, ==, 16 + 2 + 16 + 3 + 3);
+
+	/* Embedded NULs stop validation, even within ASCII runs */
+	utf8_len = 0;
+	result = tracker_text_validate_utf8 ("0123456789abcdef" "\0" "0123456789abcdef",
+	                                     33,
+	                                     NULL,
+	                                     &utf8_len);
+	g_assert_cmpuint (result, ==, 1);
+	g_assert_cmpuint (utf8_len, ==, 16);
+
+	/* A multi-byte character cut by the length limit is not valid */
+	utf8_len = 0;
+	result = tracker_text_validate_utf8 ("0123456789abcdef" "\xE8\xAA\x9E",
+	                                     18,
+	                                     NULL,
+	                                     &utf8_len);
+	g_assert_cmpuint (result, ==, 1);
+	g_assert_cmpuint (utf8_len, ==, 16);
+}
+
+static void
+test_text_normalizer ()
+{
+	TrackerTextNormalizer *normalizer;
+	gchar *text;
+	gsize len;
+
+	/* Whitespace runs are collapsed, and chunks may split words
+	 *  and multi-byte characters */
+	normalizer = tracker_text_normalizer_new (100, 0);
+	g_assert (tracker_text_normalizer_feed (normalizer, "  GNU's\n\tnot Un", -1));
+	g_assert (tracker_text_normalizer_feed (normalizer, "ix \xCE", -1));
+	g_assert (tracker_text_normalizer_feed (normalizer, "\xA9\xE8\xAA", -1));
+	g_assert (tracker_text_normalizer_feed (normalizer, "\x9E  ", -1));
+	text = tracker_text_normalizer_finish (normalizer, &len);
+	g_assert_cmpstr (text, ==, "GNU's not Unix \xCE\xA9\xE8\xAA\x9E");
+	g_assert_cmpuint (len, ==, strlen (text));
+	g_free (text);
+
+	/* Invalid UTF-8 is treated as a word break */
+	normalizer = tracker_text_normalizer_new (100, 0);
+	g_assert (tracker_text_normalizer_feed (normalizer, "abc\xFF" "def", -1));
+	text = tracker_text_normalizer_finish (normalizer, NULL);
+	g_assert_cmpstr (text, ==, "abc def");
+	g_free (text);
+
+	/* The byte budget is never exceeded, nor characters cut */
+	normalizer = tracker_text_normalizer_new (9, 0);
+	g_assert (!tracker_text_normalizer_feed (normalizer, "hello w\xCE\xA9rld", -1));
+	g_assert (!tracker_text_normalizer_feed (normalizer, "more", -1));
+	text = tracker_text_normalizer_finish (normalizer, NULL);
+	g_assert_cmpstr (text, ==, "hello w\xCE\xA9");
+	g_free (text);
+
+	normalizer = tracker_text_normalizer_new (8, 0);
+	g_assert (!tracker_text_normalizer_feed (normalizer, "hello w\xCE\xA9rld", -1));
+	text = tracker_text_normalizer_finish (normalizer, NULL);
+	g_assert_cmpstr (text, ==, "hello w");
+	g_free (text);
+
+	/* The word budget stops at whole words */
+	normalizer = tracker_text_normalizer_new (100, 2);
+	g_assert (!tracker_text_normalizer_feed (normalizer, "one two three", -1));
+	text = tracker_text_normalizer_finish (normalizer, NULL);
+	g_assert_cmpstr (text, ==, "one two");
+	g_free (text);
+
+	/* No words, no text */
+	normalizer = tracker_text_normalizer_new (100, 0);
+	g_assert (tracker_text_normalizer_feed (normalizer, " \n\t ", -1));
+	text = tracker_text_normalizer_finish (normalizer, &len);
+	g_assert (text == NULL);
+	g_assert_cmpuint (len, ==, 0);
 }
 
 static void
@@ -291,6 +374,8 @@ main (int argc, char **argv)
 	                 test_guess_date_failures_subprocess);
         g_test_add_func ("/libtracker-extract/tracker-utils/text-validate-utf8",
                          test_text_validate_utf8);
+        g_test_add_func ("/libtracker-extract/tracker-utils/text-normalizer",
+                         test_text_normalizer);
         g_test_add_func ("/libtracker-extract/tracker-utils/date_to_iso8601",
                          test_date_to_iso8601);
         g_test_add_func ("/libtracker-extract/tracker-utils/coalesce_strip",
@@ -415,6 +415,28 @@ test_file_utils_is_hidden ()
         remove_file ("./non-hidden-test-file");
 }
 
+static void
+test_file_utils_is_hidden_with_info ()
+{
+        GFileInfo *info;
+        GFile *f;
+
+        /* Without info, only the basename is looked at */
+        f = g_file_new_for_path ("/non-existing/.hidden-file");
+        g_assert (tracker_file_is_hidden_with_info (f, NULL));
+        g_object_unref (f);
+
+        f = g_file_new_for_path ("/non-existing/visible-file");
+        g_assert (!tracker_file_is_hidden_with_info (f, NULL));
+
+        /* The info takes precedence, e.g. for files listed in .hidden */
+        info = g_file_info_new ();
+        g_file_info_set_is_hidden (info, TRUE);
+        g_assert (tracker_file_is_hidden_with_info (f, info));
+        g_object_unref (info);
+        g_object_unref (f);
+}
+
 static void
 test_file_utils_cmp ()
 {
@@ -428,6 +450,46 @@ test_file_utils_cmp ()
         g_assert (tracker_file_cmp (two, three));
 }
 
+static void
+test_file_matcher ()
+{
+        TrackerFileMatcher *matcher;
+        GSList *patterns = NULL;
+
+        patterns = g_slist_prepend (patterns, "*~");
+        patterns = g_slist_prepend (patterns, "*.o");
+        patterns = g_slist_prepend (patterns, "#*");
+        patterns = g_slist_prepend (patterns, "core");
+        patterns = g_slist_prepend (patterns, "lost+found*");
+        patterns = g_slist_prepend (patterns, "*.t?p");
+        patterns = g_slist_prepend (patterns, "/ignored/path");
+
+        matcher = tracker_file_matcher_new (patterns);
+        g_slist_free (patterns);
+
+        /* Literal names, suffixes and prefixes */
+        g_assert (tracker_file_matcher_match (matcher, "/home/user/core"));
+        g_assert (tracker_file_matcher_match (matcher, "/home/user/main.o"));
+        g_assert (tracker_file_matcher_match (matcher, "/home/user/notes.txt~"));
+        g_assert (tracker_file_matcher_match (matcher, "/home/user/#notes.txt#"));
+        g_assert (tracker_file_matcher_match (matcher, "/mnt/lost+found"));
+        g_assert (!tracker_file_matcher_match (matcher, "/home/user/core.txt"));
+        g_assert (!tracker_file_matcher_match (matcher, "/home/user/main.oo"));
+        g_assert (!tracker_file_matcher_match (matcher, "/home/user/core/file"));
+
+        /* Glob patterns */
+        g_assert (tracker_file_matcher_match (matcher, "/home/user/file.tmp"));
+        g_assert (tracker_file_matcher_match (matcher, "/home/user/file.tap"));
+        g_assert (!tracker_file_matcher_match (matcher, "/home/user/file.tp"));
+
+        /* Full paths */
+        g_assert (tracker_file_matcher_match (matcher, "/ignored/path"));
+        g_assert (!tracker_file_matcher_match (matcher, "/ignored/path/file"));
+        g_assert (!tracker_file_matcher_match (matcher, "/other/ignored/path"));
+
+        tracker_file_matcher_free (matcher);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -467,8 +529,12 @@ main (int argc, char **argv)
                          test_file_exists_and_writable);
         g_test_add_func ("/libtracker-common/file-utils/is_hidden",
                          test_file_utils_is_hidden);
+        g_test_add_func ("/libtracker-common/file-utils/is_hidden_with_info",
+                         test_file_utils_is_hidden_with_info);
         g_test_add_func ("/libtracker-common/file-utils/cmp",
                          test_file_utils_cmp);
+        g_test_add_func ("/libtracker-common/file-utils/file_matcher",
+                         test_file_matcher);
 
 	result = g_test_run ();
 
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2017, The Tracker developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <libtracker-extract/tracker-extract.h>
+
+/* Extractor module used by tracker-extract-batch-test, it
+ * stores the name of the file it was handed as its title.
+ */
+G_MODULE_EXPORT gboolean
+tracker_extract_get_metadata (TrackerExtractInfo *info)
+{
+	TrackerResource *metadata;
+	gchar *basename;
+
+	basename = g_file_get_basename (tracker_extract_info_get_file (info));
+
+	metadata = tracker_resource_new (NULL);
+	tracker_resource_add_uri (metadata, "rdf:type", "nfo:Document");
+	tracker_resource_set_string (metadata, "nie:title", basename);
+
+	tracker_extract_info_set_resource (info, metadata);
+	g_object_unref (metadata);
+	g_free (basename);
+
+	return TRUE;
+}
@@ -0,0 +1,358 @@
+/*
+ * Copyright (C) 2017, The Tracker developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <tracker-extract/tracker-extract.h>
+#include <tracker-extract/tracker-main.h>
+
+#define UNHANDLED_MIMETYPE "application/x-tracker-extract-batch-test"
+#define MODULE_MIMETYPE "application/x-tracker-extract-batch-test-module"
+#define DUMMY_MIMETYPE "application/x-tracker-extract-batch-test-dummy"
+
+#define N_FILES 100
+
+typedef struct {
+	GMainLoop *loop;
+	guint *n_results;
+	guint n_files;
+	guint n_errors;
+	guint n_missing;
+	guint n_extracted;
+	const gchar **mimetypes;
+	gboolean finished;
+} BatchData;
+
+/* tracker-extract.c is built into this test, with no configuration */
+TrackerConfig *
+tracker_main_get_config (void)
+{
+	return NULL;
+}
+
+static void
+batch_item_cb (TrackerExtract     *extract,
+               guint               index,
+               TrackerExtractInfo *info,
+               const GError       *error,
+               gpointer            user_data)
+{
+	BatchData *data = user_data;
+
+	g_assert_cmpuint (index, <, data->n_files);
+	g_assert_false (data->finished);
+	g_assert_null (info);
+	g_assert_nonnull (error);
+
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND)) {
+		data->n_missing++;
+	} else {
+		g_assert_error ((GError *) error, tracker_extract_error_quark (),
+		                TRACKER_EXTRACT_ERROR_NO_EXTRACTOR);
+		data->n_errors++;
+	}
+
+	data->n_results[index]++;
+}
+
+static void
+batch_extracted_item_cb (TrackerExtract     *extract,
+                         guint               index,
+                         TrackerExtractInfo *info,
+                         const GError       *error,
+                         gpointer            user_data)
+{
+	BatchData *data = user_data;
+	TrackerResource *resource;
+
+	g_assert_cmpuint (index, <, data->n_files);
+	g_assert_false (data->finished);
+	g_assert_no_error ((GError *) error);
+	g_assert_nonnull (info);
+
+	resource = tracker_extract_info_get_resource (info);
+
+	if (g_strcmp0 (data->mimetypes[index], MODULE_MIMETYPE) == 0) {
+		gchar *basename;
+
+		/* The test module titles resources after the file */
+		basename = g_file_get_basename (tracker_extract_info_get_file (info));
+		g_assert_nonnull (resource);
+		g_assert_cmpstr (tracker_resource_get_first_string (resource, "nie:title"),
+		                 ==, basename);
+		g_free (basename);
+	} else {
+		/* Rules with no module extract nothing, successfully */
+		g_assert_null (resource);
+	}
+
+	data->n_extracted++;
+	data->n_results[index]++;
+}
+
+static void
+batch_finished_cb (TrackerExtract *extract,
+                   GAsyncResult   *result,
+                   gpointer        user_data)
+{
+	BatchData *data = user_data;
+	GError *error = NULL;
+
+	g_assert_true (tracker_extract_file_batch_finish (extract, result, &error));
+	g_assert_no_error (error);
+
+	data->finished = TRUE;
+	g_main_loop_quit (data->loop);
+}
+
+static void
+run_batch_full (TrackerExtract          *extract,
+                const gchar            **files,
+                const gchar            **mimetypes,
+                guint                    n_files,
+                TrackerExtractBatchFunc  item_func,
+                BatchData               *data)
+{
+	data->loop = g_main_loop_new (NULL, FALSE);
+	data->n_results = g_new0 (guint, MAX (n_files, 1));
+	data->n_files = n_files;
+	data->mimetypes = mimetypes;
+
+	tracker_extract_file_batch (extract, files, mimetypes, NULL, n_files,
+	                            item_func, batch_finished_cb, data);
+	g_main_loop_run (data->loop);
+}
+
+static void
+run_batch (TrackerExtract *extract,
+           const gchar   **files,
+           const gchar   **mimetypes,
+           guint           n_files,
+           BatchData      *data)
+{
+	run_batch_full (extract, files, mimetypes, n_files,
+	                batch_item_cb, data);
+}
+
+static void
+batch_data_clear (BatchData *data)
+{
+	g_main_loop_unref (data->loop);
+	g_free (data->n_results);
+}
+
+static void
+test_batch_empty (void)
+{
+	TrackerExtract *extract;
+	BatchData data = { 0 };
+
+	extract = tracker_extract_new (TRUE, NULL);
+	run_batch (extract, NULL, NULL, 0, &data);
+
+	g_assert_true (data.finished);
+	g_assert_cmpuint (data.n_errors, ==, 0);
+
+	batch_data_clear (&data);
+	g_object_unref (extract);
+}
+
+static void
+test_batch_unhandled (void)
+{
+	TrackerExtract *extract;
+	BatchData data = { 0 };
+	const gchar *files[N_FILES];
+	const gchar *mimetypes[N_FILES];
+	gchar *uris[N_FILES];
+	guint i;
+
+	for (i = 0; i < N_FILES; i++) {
+		uris[i] = g_strdup_printf ("file:///batch-test/file-%u", i);
+		files[i] = uris[i];
+		mimetypes[i] = UNHANDLED_MIMETYPE;
+	}
+
+	extract = tracker_extract_new (TRUE, NULL);
+	run_batch (extract, files, mimetypes, N_FILES, &data);
+
+	/* Every file must be reported exactly once */
+	g_assert_true (data.finished);
+	g_assert_cmpuint (data.n_errors, ==, N_FILES);
+
+	for (i = 0; i < N_FILES; i++) {
+		g_assert_cmpuint (data.n_results[i], ==, 1);
+		g_free (uris[i]);
+	}
+
+	batch_data_clear (&data);
+	g_object_unref (extract);
+}
+
+static void
+test_batch_missing_files (void)
+{
+	TrackerExtract *extract;
+	BatchData data = { 0 };
+	const gchar *files[N_FILES];
+	const gchar *mimetypes[N_FILES];
+	gchar *uris[N_FILES];
+	guint i;
+
+	/* Files with no mimetype are queried, and fail to be found */
+	for (i = 0; i < N_FILES; i++) {
+		uris[i] = g_strdup_printf ("file:///batch-test/missing-%u", i);
+		files[i] = uris[i];
+		mimetypes[i] = (i % 2 == 0) ? NULL : UNHANDLED_MIMETYPE;
+	}
+
+	extract = tracker_extract_new (TRUE, NULL);
+	run_batch (extract, files, mimetypes, N_FILES, &data);
+
+	g_assert_true (data.finished);
+	g_assert_cmpuint (data.n_missing, ==, N_FILES / 2);
+	g_assert_cmpuint (data.n_errors, ==, N_FILES / 2);
+
+	for (i = 0; i < N_FILES; i++) {
+		g_assert_cmpuint (data.n_results[i], ==, 1);
+		g_free (uris[i]);
+	}
+
+	batch_data_clear (&data);
+	g_object_unref (extract);
+}
+
+static void
+test_batch_extracted (void)
+{
+	TrackerExtract *extract;
+	BatchData data = { 0 };
+	const gchar *files[N_FILES];
+	const gchar *mimetypes[N_FILES];
+	gchar *paths[N_FILES];
+	gchar *uris[N_FILES];
+	gchar *dir;
+	guint i;
+
+	dir = g_dir_make_tmp ("tracker-extract-batch-test-XXXXXX", NULL);
+	g_assert_nonnull (dir);
+
+	/* Interleave both handlers, so the batch has to group them */
+	for (i = 0; i < N_FILES; i++) {
+		gchar *name;
+		GFile *file;
+
+		name = g_strdup_printf ("file-%u", i);
+		paths[i] = g_build_filename (dir, name, NULL);
+		g_assert_true (g_file_set_contents (paths[i], name, -1, NULL));
+		g_free (name);
+
+		file = g_file_new_for_path (paths[i]);
+		uris[i] = g_file_get_uri (file);
+		g_object_unref (file);
+
+		files[i] = uris[i];
+		mimetypes[i] = (i % 3 == 0) ? DUMMY_MIMETYPE : MODULE_MIMETYPE;
+	}
+
+	extract = tracker_extract_new (TRUE, NULL);
+	run_batch_full (extract, files, mimetypes, N_FILES,
+	                batch_extracted_item_cb, &data);
+
+	g_assert_true (data.finished);
+	g_assert_cmpuint (data.n_extracted, ==, N_FILES);
+
+	for (i = 0; i < N_FILES; i++) {
+		g_assert_cmpuint (data.n_results[i], ==, 1);
+		g_unlink (paths[i]);
+		g_free (paths[i]);
+		g_free (uris[i]);
+	}
+
+	g_rmdir (dir);
+	g_free (dir);
+
+	batch_data_clear (&data);
+	g_object_unref (extract);
+}
+
+static gchar *
+write_rule (const gchar *rules_dir,
+            const gchar *name,
+            const gchar *contents)
+{
+	gchar *path;
+
+	path = g_build_filename (rules_dir, name, NULL);
+	g_assert_true (g_file_set_contents (path, contents, -1, NULL));
+
+	return path;
+}
+
+int
+main (int argc, char **argv)
+{
+	gchar *rules_dir, *module_rule, *dummy_rule;
+	gint result;
+
+	g_test_init (&argc, &argv, NULL);
+
+	/* Files with no mimetype that can't be queried are warned about */
+	g_log_set_always_fatal (G_LOG_FATAL_MASK | G_LOG_LEVEL_CRITICAL);
+
+	/* Only the test mimetypes have rules, one of them
+	 * handled by the test module built along this test.
+	 */
+	rules_dir = g_dir_make_tmp ("tracker-extract-batch-test-XXXXXX", NULL);
+	g_assert_nonnull (rules_dir);
+	g_setenv ("TRACKER_EXTRACTOR_RULES_DIR", rules_dir, TRUE);
+	g_setenv ("TRACKER_EXTRACTORS_DIR", TEST_EXTRACTORS_DIR, TRUE);
+
+	module_rule = write_rule (rules_dir, "10-batch-test-module.rule",
+	                          "[ExtractorRule]\n"
+	                          "ModulePath=libextract-batch-test.so\n"
+	                          "MimeTypes=" MODULE_MIMETYPE "\n");
+	dummy_rule = write_rule (rules_dir, "10-batch-test-dummy.rule",
+	                         "[ExtractorRule]\n"
+	                         "MimeTypes=" DUMMY_MIMETYPE "\n");
+
+	g_test_add_func ("/tracker-extract/batch/empty",
+	                 test_batch_empty);
+	g_test_add_func ("/tracker-extract/batch/unhandled",
+	                 test_batch_unhandled);
+	g_test_add_func ("/tracker-extract/batch/missing-files",
+	                 test_batch_missing_files);
+	g_test_add_func ("/tracker-extract/batch/extracted",
+	                 test_batch_extracted);
+
+	result = g_test_run ();
+
+	g_unlink (module_rule);
+	g_unlink (dummy_rule);
+	g_rmdir (rules_dir);
+	g_free (module_rule);
+	g_free (dummy_rule);
+	g_free (rules_dir);
+
+	return result;
+}
@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2017, The Tracker developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <libtracker-extract/tracker-extract.h>
+
+#define COMMENT "A comment spanning a single block"
+
+#define BENCHMARK_WIDTH 1000
+#define BENCHMARK_HEIGHT 1000
+#define BENCHMARK_N_FRAMES 40
+
+/* Provided by the GIF extractor module, built into this test */
+G_MODULE_EXPORT gboolean tracker_extract_get_metadata (TrackerExtractInfo *info);
+
+typedef struct {
+	GByteArray *data;
+	guint32 bits;
+	guint n_bits;
+	guint8 block[256];
+} GifWriter;
+
+static void
+put_u16 (GByteArray *data,
+         guint16     value)
+{
+	guint8 bytes[2] = { value & 0xff, value >> 8 };
+
+	g_byte_array_append (data, bytes, 2);
+}
+
+static void
+put_byte (GByteArray *data,
+          guint8      value)
+{
+	g_byte_array_append (data, &value, 1);
+}
+
+static void
+flush_block (GifWriter *writer)
+{
+	if (writer->block[0] == 0)
+		return;
+
+	g_byte_array_append (writer->data, writer->block, writer->block[0] + 1);
+	writer->block[0] = 0;
+}
+
+static void
+put_code (GifWriter *writer,
+          guint      code)
+{
+	writer->bits |= code << writer->n_bits;
+	writer->n_bits += 9;
+
+	while (writer->n_bits >= 8) {
+		writer->block[++writer->block[0]] = writer->bits & 0xff;
+		writer->bits >>= 8;
+		writer->n_bits -= 8;
+
+		if (writer->block[0] == 255)
+			flush_block (writer);
+	}
+}
+
+/* Writes frame pixels as 9 bit literal codes, clearing the code
+ * table before it would grow into 10 bit codes. Not compressed at
+ * all, but valid LZW data.
+ */
+static void
+put_frame (GByteArray *data,
+           guint       width,
+           guint       height,
+           guint       seed)
+{
+	GifWriter writer = { data, 0, 0, { 0 } };
+	guint i, n_pixels = width * height;
+
+	put_byte (data, 0x2c);
+	put_u16 (data, 0);
+	put_u16 (data, 0);
+	put_u16 (data, width);
+	put_u16 (data, height);
+	put_byte (data, 0);
+
+	/* LZW minimum code size */
+	put_byte (data, 8);
+
+	for (i = 0; i < n_pixels; i++) {
+		if (i % 254 == 0)
+			put_code (&writer, 256);
+
+		put_code (&writer, (i * 7 + seed) & 0xff);
+	}
+
+	put_code (&writer, 257);
+
+	if (writer.n_bits > 0)
+		writer.block[++writer.block[0]] = writer.bits & 0xff;
+
+	flush_block (&writer);
+	put_byte (data, 0);
+}
+
+static gchar *
+create_gif (guint        width,
+            guint        height,
+            guint        n_frames,
+            const gchar *comment)
+{
+	GByteArray *data;
+	GError *error = NULL;
+	gchar *path;
+	guint i;
+	gint fd;
+
+	data = g_byte_array_new ();
+	g_byte_array_append (data, (const guint8 *) "GIF89a", 6);
+
+	/* Logical screen, with a 256 color global table */
+	put_u16 (data, width);
+	put_u16 (data, height);
+	put_byte (data, 0xf7);
+	put_byte (data, 0);
+	put_byte (data, 0);
+
+	for (i = 0; i < 256; i++) {
+		guint8 rgb[3] = { i, i, i };
+
+		g_byte_array_append (data, rgb, 3);
+	}
+
+	if (comment) {
+		put_byte (data, 0x21);
+		put_byte (data, 0xfe);
+		put_byte (data, strlen (comment));
+		g_byte_array_append (data, (const guint8 *) comment, strlen (comment));
+		put_byte (data, 0);
+	}
+
+	for (i = 0; i < n_frames; i++)
+		put_frame (data, width, height, i);
+
+	put_byte (data, 0x3b);
+
+	fd = g_file_open_tmp ("tracker-extract-gif-test-XXXXXX.gif", &path, &error);
+	g_assert_no_error (error);
+	close (fd);
+
+	g_file_set_contents (path, (const gchar *) data->data, data->len, &error);
+	g_assert_no_error (error);
+	g_byte_array_unref (data);
+
+	return path;
+}
+
+static TrackerResource *
+extract_gif (const gchar *path)
+{
+	TrackerExtractInfo *info;
+	TrackerResource *resource;
+	GFile *file;
+
+	file = g_file_new_for_path (path);
+	info = tracker_extract_info_new (file, "image/gif");
+	g_object_unref (file);
+
+	g_assert (tracker_extract_get_metadata (info));
+
+	resource = tracker_extract_info_get_resource (info);
+	g_assert (resource != NULL);
+	g_object_ref (resource);
+	tracker_extract_info_unref (info);
+
+	return resource;
+}
+
+static void
+test_gif_metadata (void)
+{
+	TrackerResource *resource;
+	gchar *path;
+
+	path = create_gif (64, 48, 3, COMMENT);
+	resource = extract_gif (path);
+
+	g_assert_cmpstr (tracker_resource_get_first_string (resource, "nfo:width"), ==, "64");
+	g_assert_cmpstr (tracker_resource_get_first_string (resource, "nfo:height"), ==, "48");
+	g_assert_cmpstr (tracker_resource_get_first_string (resource, "nie:comment"), ==, COMMENT);
+
+	g_object_unref (resource);
+	g_unlink (path);
+	g_free (path);
+}
+
+static void
+test_gif_benchmark (void)
+{
+	TrackerResource *resource;
+	GTimer *timer;
+	gdouble elapsed;
+	gchar *path;
+	GStatBuf st;
+
+	if (!g_test_perf ()) {
+		g_test_skip ("Only run in performance mode (-m perf)");
+		return;
+	}
+
+	path = create_gif (BENCHMARK_WIDTH, BENCHMARK_HEIGHT,
+	                   BENCHMARK_N_FRAMES, NULL);
+	g_assert_cmpint (g_stat (path, &st), ==, 0);
+
+	timer = g_timer_new ();
+	resource = extract_gif (path);
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_timer_destroy (timer);
+
+	g_assert_cmpstr (tracker_resource_get_first_string (resource, "nfo:width"), ==,
+	                 G_STRINGIFY (BENCHMARK_WIDTH));
+
+	g_test_minimized_result (elapsed,
+	                         "Extracted %d frames of %dx%d (%.1f MB) in %.3f s",
+	                         BENCHMARK_N_FRAMES, BENCHMARK_WIDTH, BENCHMARK_HEIGHT,
+	                         st.st_size / (1024.0 * 1024.0), elapsed);
+
+	g_object_unref (resource);
+	g_unlink (path);
+	g_free (path);
+}
+
+int
+main (int argc, char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/tracker-extract/gif/metadata",
+	                 test_gif_metadata);
+	g_test_add_func ("/tracker-extract/gif/benchmark",
+	                 test_gif_benchmark);
+
+	return g_test_run ();
+}
@@ -0,0 +1,441 @@
+/*
+ * Copyright (C) 2017, The Tracker developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <tracker-extract/tracker-extract-persistence.h>
+
+#define TMPDIR_ENV "TRACKER_PERSISTENCE_TEST_TMPDIR"
+
+#define CRASHING_FILE "/persistence-test/crashing-file"
+#define GOOD_FILE "/persistence-test/good-file"
+
+/* Same as MAX_RETRIES in tracker-extract-persistence.c */
+#define MAX_RETRIES 3
+
+#define BENCHMARK_N_FILES 10000
+
+typedef struct {
+	GPtrArray *retried;
+	GPtrArray *ignored;
+} RecoveryData;
+
+static void
+recovery_data_init (RecoveryData *data)
+{
+	data->retried = g_ptr_array_new_with_free_func (g_object_unref);
+	data->ignored = g_ptr_array_new_with_free_func (g_object_unref);
+}
+
+static void
+recovery_data_clear (RecoveryData *data)
+{
+	g_ptr_array_unref (data->retried);
+	g_ptr_array_unref (data->ignored);
+}
+
+static void
+retry_cb (GFile    *file,
+          gpointer  user_data)
+{
+	RecoveryData *data = user_data;
+
+	g_ptr_array_add (data->retried, g_object_ref (file));
+}
+
+static void
+ignore_cb (GFile    *file,
+           gpointer  user_data)
+{
+	RecoveryData *data = user_data;
+
+	g_ptr_array_add (data->ignored, g_object_ref (file));
+}
+
+static void
+assert_file_path (GFile       *file,
+                  const gchar *expected)
+{
+	gchar *path;
+
+	path = g_file_get_path (file);
+	g_assert_cmpstr (path, ==, expected);
+	g_free (path);
+}
+
+/* Runs in a subprocess, which exits with files in flight as if an
+ * extractor module had crashed on them.
+ */
+static void
+test_persistence_recovery_subprocess (void)
+{
+	TrackerExtractPersistence *persistence;
+	RecoveryData data;
+	GFile *good, *crashing;
+
+	if (!g_test_subprocess ())
+		return;
+
+	recovery_data_init (&data);
+	persistence = tracker_extract_persistence_initialize (retry_cb,
+	                                                      ignore_cb,
+	                                                      &data);
+	g_assert_cmpuint (data.ignored->len, ==, 0);
+
+	if (data.retried->len == 0) {
+		crashing = g_file_new_for_path (CRASHING_FILE);
+	} else {
+		g_assert_cmpuint (data.retried->len, ==, 1);
+		crashing = g_object_ref (g_ptr_array_index (data.retried, 0));
+		assert_file_path (crashing, CRASHING_FILE);
+	}
+
+	/* Files that finish extraction are not recovered */
+	good = g_file_new_for_path (GOOD_FILE);
+	tracker_extract_persistence_add_file (persistence, good);
+	tracker_extract_persistence_remove_file (persistence, good);
+	g_object_unref (good);
+
+	tracker_extract_persistence_add_file (persistence, crashing);
+	g_object_unref (crashing);
+
+	recovery_data_clear (&data);
+}
+
+static void
+test_persistence_recovery (void)
+{
+	TrackerExtractPersistence *persistence;
+	RecoveryData data;
+	guint i;
+
+	for (i = 0; i < MAX_RETRIES; i++) {
+		g_test_trap_subprocess ("/tracker-extract/persistence/recovery/subprocess", 0, 0);
+		g_test_trap_assert_passed ();
+	}
+
+	/* The file was attempted too many times, it gets ignored */
+	recovery_data_init (&data);
+	persistence = tracker_extract_persistence_initialize (retry_cb,
+	                                                      ignore_cb,
+	                                                      &data);
+	g_assert (persistence != NULL);
+	g_assert_cmpuint (data.retried->len, ==, 0);
+	g_assert_cmpuint (data.ignored->len, ==, 1);
+	assert_file_path (g_ptr_array_index (data.ignored, 0), CRASHING_FILE);
+	recovery_data_clear (&data);
+}
+
+static gboolean
+files_contain_path (GPtrArray   *files,
+                    const gchar *path)
+{
+	guint i;
+
+	for (i = 0; i < files->len; i++) {
+		gchar *file_path;
+		gboolean found;
+
+		file_path = g_file_get_path (g_ptr_array_index (files, i));
+		found = g_strcmp0 (file_path, path) == 0;
+		g_free (file_path);
+
+		if (found)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Exits right after a file finished, before any sync happens */
+static void
+test_persistence_removed_subprocess (void)
+{
+	TrackerExtractPersistence *persistence;
+	RecoveryData data;
+	GFile *good;
+
+	if (!g_test_subprocess ())
+		return;
+
+	recovery_data_init (&data);
+	persistence = tracker_extract_persistence_initialize (retry_cb,
+	                                                      ignore_cb,
+	                                                      &data);
+	g_assert (persistence != NULL);
+	g_assert_false (files_contain_path (data.retried, GOOD_FILE));
+	g_assert_false (files_contain_path (data.ignored, GOOD_FILE));
+
+	good = g_file_new_for_path (GOOD_FILE);
+	tracker_extract_persistence_add_file (persistence, good);
+	tracker_extract_persistence_remove_file (persistence, good);
+	g_object_unref (good);
+
+	recovery_data_clear (&data);
+}
+
+/* Finished files are recorded as such before the process goes
+ * away, the second run must not be handed the file again.
+ */
+static void
+test_persistence_removed (void)
+{
+	guint i;
+
+	for (i = 0; i < 2; i++) {
+		g_test_trap_subprocess ("/tracker-extract/persistence/removed/subprocess", 0, 0);
+		g_test_trap_assert_passed ();
+	}
+}
+
+static void
+test_persistence_stale_symlinks_subprocess (void)
+{
+	TrackerExtractPersistence *persistence;
+	RecoveryData data;
+
+	if (!g_test_subprocess ())
+		return;
+
+	recovery_data_init (&data);
+	persistence = tracker_extract_persistence_initialize (retry_cb,
+	                                                      ignore_cb,
+	                                                      &data);
+	g_assert (persistence != NULL);
+	g_assert_cmpuint (data.retried->len, ==, 0);
+	g_assert_cmpuint (data.ignored->len, ==, 0);
+	recovery_data_clear (&data);
+}
+
+/* Symlinks left behind by older versions are removed, not recovered */
+static void
+test_persistence_stale_symlinks (void)
+{
+	gchar *dirname, *dir, *md5, *link_name, *link_path;
+
+	dirname = g_strdup_printf ("tracker-extract-files.%d", getuid ());
+	dir = g_build_filename (g_get_tmp_dir (), dirname, NULL);
+	g_assert_cmpint (g_mkdir_with_parents (dir, 0700), ==, 0);
+
+	md5 = g_compute_checksum_for_string (G_CHECKSUM_MD5, CRASHING_FILE, -1);
+	link_name = g_strdup_printf ("1-%s", md5);
+	link_path = g_build_filename (dir, link_name, NULL);
+	g_assert_cmpint (symlink (CRASHING_FILE, link_path), ==, 0);
+
+	g_test_trap_subprocess ("/tracker-extract/persistence/stale-symlinks/subprocess", 0, 0);
+	g_test_trap_assert_passed ();
+
+	g_assert_false (g_file_test (link_path, G_FILE_TEST_IS_SYMLINK));
+
+	g_free (link_path);
+	g_free (link_name);
+	g_free (md5);
+	g_free (dir);
+	g_free (dirname);
+}
+
+static void
+ignore_file (GFile    *file,
+             gpointer  user_data)
+{
+}
+
+static GPtrArray *
+create_benchmark_files (void)
+{
+	GPtrArray *files;
+	guint i;
+
+	files = g_ptr_array_new_with_free_func (g_object_unref);
+
+	for (i = 0; i < BENCHMARK_N_FILES; i++) {
+		gchar *path;
+
+		path = g_strdup_printf ("/persistence-test/documents/file-%u.txt", i);
+		g_ptr_array_add (files, g_file_new_for_path (path));
+		g_free (path);
+	}
+
+	return files;
+}
+
+/* The scheme used before the journal: one symlink per file in flight */
+static gdouble
+benchmark_symlinks (GPtrArray *files)
+{
+	GTimer *timer;
+	gchar *dir;
+	gdouble elapsed;
+	guint i;
+
+	dir = g_build_filename (g_get_tmp_dir (), "symlinks", NULL);
+	g_assert_cmpint (g_mkdir_with_parents (dir, 0700), ==, 0);
+
+	timer = g_timer_new ();
+
+	for (i = 0; i < files->len; i++) {
+		gchar *path, *md5, *link_path;
+
+		path = g_file_get_path (g_ptr_array_index (files, i));
+		md5 = g_compute_checksum_for_string (G_CHECKSUM_MD5, path, -1);
+		link_path = g_strdup_printf ("%s/1-%s", dir, md5);
+
+		g_assert_cmpint (symlink (path, link_path), ==, 0);
+		g_assert_cmpint (g_unlink (link_path), ==, 0);
+
+		g_free (link_path);
+		g_free (md5);
+		g_free (path);
+	}
+
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_timer_destroy (timer);
+
+	g_rmdir (dir);
+	g_free (dir);
+
+	return elapsed;
+}
+
+static gdouble
+benchmark_journal (GPtrArray *files)
+{
+	TrackerExtractPersistence *persistence;
+	GTimer *timer;
+	gdouble elapsed;
+	guint i;
+
+	persistence = tracker_extract_persistence_initialize (ignore_file,
+	                                                      ignore_file,
+	                                                      NULL);
+	timer = g_timer_new ();
+
+	for (i = 0; i < files->len; i++) {
+		tracker_extract_persistence_add_file (persistence,
+		                                      g_ptr_array_index (files, i));
+		tracker_extract_persistence_remove_file (persistence,
+		                                         g_ptr_array_index (files, i));
+	}
+
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_timer_destroy (timer);
+
+	return elapsed;
+}
+
+static void
+test_persistence_benchmark (void)
+{
+	GPtrArray *files;
+	gdouble symlinks, journal;
+
+	if (!g_test_perf ()) {
+		g_test_skip ("Only run in performance mode (-m perf)");
+		return;
+	}
+
+	files = create_benchmark_files ();
+
+	symlinks = benchmark_symlinks (files);
+	journal = benchmark_journal (files);
+
+	g_test_message ("Symlinks: %.0f files/s", files->len / symlinks);
+	g_test_message ("Journal: %.0f files/s", files->len / journal);
+	g_test_maximized_result (files->len / journal,
+	                         "Journal: %.0f files/s, %.1fx the symlink rate",
+	                         files->len / journal,
+	                         symlinks / journal);
+
+	g_ptr_array_unref (files);
+}
+
+static void
+remove_tmpdir (const gchar *tmpdir)
+{
+	const gchar *name;
+	GDir *dir;
+
+	dir = g_dir_open (tmpdir, 0, NULL);
+
+	if (dir) {
+		while ((name = g_dir_read_name (dir)) != NULL) {
+			gchar *path;
+
+			path = g_build_filename (tmpdir, name, NULL);
+
+			if (g_file_test (path, G_FILE_TEST_IS_DIR))
+				remove_tmpdir (path);
+			else
+				g_unlink (path);
+
+			g_free (path);
+		}
+
+		g_dir_close (dir);
+	}
+
+	g_rmdir (tmpdir);
+}
+
+int
+main (int argc, char **argv)
+{
+	gchar *tmpdir = NULL;
+	gint result;
+
+	/* Subprocesses share the temporary dir with the parent */
+	if (!g_getenv (TMPDIR_ENV)) {
+		tmpdir = g_dir_make_tmp ("tracker-persistence-test-XXXXXX", NULL);
+		g_assert (tmpdir != NULL);
+		g_setenv (TMPDIR_ENV, tmpdir, TRUE);
+	}
+
+	g_setenv ("TMPDIR", g_getenv (TMPDIR_ENV), TRUE);
+
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/tracker-extract/persistence/recovery",
+	                 test_persistence_recovery);
+	g_test_add_func ("/tracker-extract/persistence/recovery/subprocess",
+	                 test_persistence_recovery_subprocess);
+	g_test_add_func ("/tracker-extract/persistence/removed",
+	                 test_persistence_removed);
+	g_test_add_func ("/tracker-extract/persistence/removed/subprocess",
+	                 test_persistence_removed_subprocess);
+	g_test_add_func ("/tracker-extract/persistence/stale-symlinks",
+	                 test_persistence_stale_symlinks);
+	g_test_add_func ("/tracker-extract/persistence/stale-symlinks/subprocess",
+	                 test_persistence_stale_symlinks_subprocess);
+	g_test_add_func ("/tracker-extract/persistence/benchmark",
+	                 test_persistence_benchmark);
+
+	result = g_test_run ();
+
+	if (tmpdir) {
+		remove_tmpdir (tmpdir);
+		g_free (tmpdir);
+	}
+
+	return result;
+}
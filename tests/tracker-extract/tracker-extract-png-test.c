@@ -0,0 +1,520 @@
+/*
+ * Copyright (C) 2017, The Tracker developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+/* The PNG extractor module is built into this test, its chunk
+ * walker and libpng fallback are tested apart from each other.
+ */
+#include "tracker-extract/tracker-extract-png.c"
+
+#define WIDTH 16
+#define HEIGHT 16
+
+#define DESCRIPTION "Descripci\xc3\xb3n"
+#define COPYRIGHT "Compressed international copyright"
+
+typedef struct {
+	GByteArray *data;
+} PngWriter;
+
+static void
+put_uint32 (GByteArray *data,
+            guint32     value)
+{
+	guint8 bytes[4] = { value >> 24, value >> 16, value >> 8, value };
+
+	g_byte_array_append (data, bytes, 4);
+}
+
+static void
+put_chunk (PngWriter    *writer,
+           const gchar  *type,
+           const guint8 *data,
+           gsize         length,
+           gboolean      bad_crc)
+{
+	uLong crc;
+
+	crc = crc32 (0, (const Bytef *) type, 4);
+	crc = crc32 (crc, data, length);
+
+	if (bad_crc)
+		crc ^= 1;
+
+	put_uint32 (writer->data, length);
+	g_byte_array_append (writer->data, (const guint8 *) type, 4);
+	g_byte_array_append (writer->data, data, length);
+	put_uint32 (writer->data, crc);
+}
+
+static GByteArray *
+deflate_data (const guint8 *data,
+              gsize         length,
+              gint          level)
+{
+	GByteArray *output;
+	uLongf output_len;
+
+	output_len = compressBound (length);
+	output = g_byte_array_sized_new (output_len);
+	g_byte_array_set_size (output, output_len);
+
+	g_assert_cmpint (compress2 (output->data, &output_len,
+	                            data, length, level), ==, Z_OK);
+	g_byte_array_set_size (output, output_len);
+
+	return output;
+}
+
+/* Signature and header of a 8 bit grayscale image */
+static void
+png_writer_init (PngWriter *writer)
+{
+	static const guint8 signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	GByteArray *ihdr;
+
+	writer->data = g_byte_array_new ();
+	g_byte_array_append (writer->data, signature, 8);
+
+	ihdr = g_byte_array_new ();
+	put_uint32 (ihdr, WIDTH);
+	put_uint32 (ihdr, HEIGHT);
+	g_byte_array_append (ihdr, (const guint8 *) "\x08\x00\x00\x00\x00", 5);
+	put_chunk (writer, "IHDR", ihdr->data, ihdr->len, FALSE);
+	g_byte_array_unref (ihdr);
+}
+
+/* Stored, not compressed, so files don't fall under the
+ * minimum size the module accepts.
+ */
+static void
+put_image_data (PngWriter *writer)
+{
+	guint8 rows[HEIGHT * (WIDTH + 1)];
+	GByteArray *idat;
+	guint i;
+
+	for (i = 0; i < sizeof (rows); i++)
+		rows[i] = (i % (WIDTH + 1) == 0) ? 0 : i & 0xff;
+
+	idat = deflate_data (rows, sizeof (rows), Z_NO_COMPRESSION);
+	put_chunk (writer, "IDAT", idat->data, idat->len, FALSE);
+	g_byte_array_unref (idat);
+}
+
+static void
+put_text (PngWriter   *writer,
+          const gchar *key,
+          const gchar *text,
+          gboolean     bad_crc)
+{
+	GByteArray *data;
+
+	data = g_byte_array_new ();
+	g_byte_array_append (data, (const guint8 *) key, strlen (key) + 1);
+	g_byte_array_append (data, (const guint8 *) text, strlen (text));
+	put_chunk (writer, "tEXt", data->data, data->len, bad_crc);
+	g_byte_array_unref (data);
+}
+
+static void
+put_ztxt (PngWriter    *writer,
+          const gchar  *key,
+          const guint8 *text,
+          gsize         length)
+{
+	GByteArray *data, *compressed;
+
+	compressed = deflate_data (text, length, Z_BEST_COMPRESSION);
+
+	data = g_byte_array_new ();
+	g_byte_array_append (data, (const guint8 *) key, strlen (key) + 1);
+	g_byte_array_append (data, (const guint8 *) "", 1);
+	g_byte_array_append (data, compressed->data, compressed->len);
+	put_chunk (writer, "zTXt", data->data, data->len, FALSE);
+
+	g_byte_array_unref (compressed);
+	g_byte_array_unref (data);
+}
+
+static void
+put_itxt (PngWriter    *writer,
+          const gchar  *key,
+          const guint8 *text,
+          gsize         length,
+          gboolean      compress)
+{
+	GByteArray *data, *compressed = NULL;
+	guint8 flags[2] = { compress ? 1 : 0, 0 };
+
+	data = g_byte_array_new ();
+	g_byte_array_append (data, (const guint8 *) key, strlen (key) + 1);
+	g_byte_array_append (data, flags, 2);
+
+	/* Language tag and translated keyword */
+	g_byte_array_append (data, (const guint8 *) "es\0", 3);
+	g_byte_array_append (data, (const guint8 *) "", 1);
+
+	if (compress) {
+		compressed = deflate_data (text, length, Z_BEST_COMPRESSION);
+		g_byte_array_append (data, compressed->data, compressed->len);
+		g_byte_array_unref (compressed);
+	} else {
+		g_byte_array_append (data, text, length);
+	}
+
+	put_chunk (writer, "iTXt", data->data, data->len, FALSE);
+	g_byte_array_unref (data);
+}
+
+static void
+put_end (PngWriter *writer)
+{
+	put_chunk (writer, "IEND", (const guint8 *) "", 0, FALSE);
+}
+
+static gchar *
+png_writer_finish (PngWriter *writer)
+{
+	GError *error = NULL;
+	gchar *path;
+	gint fd;
+
+	fd = g_file_open_tmp ("tracker-extract-png-test-XXXXXX.png", &path, &error);
+	g_assert_no_error (error);
+	close (fd);
+
+	g_file_set_contents (path, (const gchar *) writer->data->data,
+	                     writer->data->len, &error);
+	g_assert_no_error (error);
+	g_byte_array_unref (writer->data);
+
+	return path;
+}
+
+static gboolean
+read_png (const gchar *path,
+          gboolean     use_libpng,
+          PngInfo     *png)
+{
+	gboolean retval;
+	FILE *f;
+
+	f = g_fopen (path, "rb");
+	g_assert (f != NULL);
+
+	png_info_init (png);
+	retval = use_libpng ? read_with_libpng (f, png) : scan_chunks (f, png);
+	fclose (f);
+
+	return retval;
+}
+
+static const gchar *
+lookup_text (PngInfo     *png,
+             const gchar *key)
+{
+	guint i;
+
+	for (i = 0; i < png->texts->len; i++) {
+		PngText *text = &g_array_index (png->texts, PngText, i);
+
+		if (g_strcmp0 (text->key, key) == 0)
+			return text->text;
+	}
+
+	return NULL;
+}
+
+static TrackerResource *
+extract_png (const gchar *path)
+{
+	TrackerExtractInfo *info;
+	TrackerResource *resource;
+	GFile *file;
+
+	file = g_file_new_for_path (path);
+	info = tracker_extract_info_new (file, "image/png");
+	g_object_unref (file);
+
+	g_assert (tracker_extract_get_metadata (info));
+
+	resource = tracker_extract_info_get_resource (info);
+	g_assert (resource != NULL);
+	g_object_ref (resource);
+	tracker_extract_info_unref (info);
+
+	return resource;
+}
+
+static gchar *
+create_text_png (void)
+{
+	PngWriter writer;
+	const gchar *comment = "A compressed comment";
+
+	png_writer_init (&writer);
+	put_text (&writer, "Title", "Caf\xe9", FALSE);
+	put_image_data (&writer);
+
+	/* Text chunks may also come after the image data */
+	put_ztxt (&writer, "Comment", (const guint8 *) comment, strlen (comment));
+	put_itxt (&writer, "Description",
+	          (const guint8 *) DESCRIPTION, strlen (DESCRIPTION), FALSE);
+	put_itxt (&writer, "Copyright",
+	          (const guint8 *) COPYRIGHT, strlen (COPYRIGHT), TRUE);
+	put_end (&writer);
+
+	return png_writer_finish (&writer);
+}
+
+static void
+test_png_text (void)
+{
+	TrackerResource *resource;
+	PngInfo png;
+	gchar *path;
+
+	path = create_text_png ();
+
+	g_assert_true (read_png (path, FALSE, &png));
+	g_assert_cmpuint (png.width, ==, WIDTH);
+	g_assert_cmpuint (png.height, ==, HEIGHT);
+	g_assert_cmpint (png.bit_depth, ==, 8);
+	g_assert_cmpuint (png.texts->len, ==, 4);
+
+	/* tEXt and zTXt are Latin-1, iTXt is UTF-8 already */
+	g_assert_cmpstr (lookup_text (&png, "Title"), ==, "Caf\xc3\xa9");
+	g_assert_cmpstr (lookup_text (&png, "Comment"), ==, "A compressed comment");
+	g_assert_cmpstr (lookup_text (&png, "Description"), ==, DESCRIPTION);
+	g_assert_cmpstr (lookup_text (&png, "Copyright"), ==, COPYRIGHT);
+	png_info_clear (&png);
+
+	resource = extract_png (path);
+	g_assert_cmpstr (tracker_resource_get_first_string (resource, "nie:title"), ==, "Caf\xc3\xa9");
+	g_assert_cmpstr (tracker_resource_get_first_string (resource, "nie:comment"), ==, "A compressed comment");
+	g_assert_cmpstr (tracker_resource_get_first_string (resource, "nie:description"), ==, DESCRIPTION);
+	g_assert_cmpstr (tracker_resource_get_first_string (resource, "nie:copyright"), ==, COPYRIGHT);
+	g_object_unref (resource);
+
+	g_unlink (path);
+	g_free (path);
+}
+
+static void
+test_png_exif (void)
+{
+	static const gchar description[] = "Described in EXIF";
+	GByteArray *tiff;
+	PngWriter writer;
+	PngInfo png;
+	gchar *path;
+	gsize size;
+
+	/* Big endian TIFF header, with one IFD holding ImageDescription */
+	tiff = g_byte_array_new ();
+	g_byte_array_append (tiff, (const guint8 *) "MM\0*", 4);
+	put_uint32 (tiff, 8);
+	g_byte_array_append (tiff, (const guint8 *) "\x00\x01", 2);
+	g_byte_array_append (tiff, (const guint8 *) "\x01\x0e\x00\x02", 4);
+	put_uint32 (tiff, sizeof (description));
+	put_uint32 (tiff, 8 + 2 + 12 + 4);
+	put_uint32 (tiff, 0);
+	g_byte_array_append (tiff, (const guint8 *) description, sizeof (description));
+
+	png_writer_init (&writer);
+	put_chunk (&writer, "eXIf", tiff->data, tiff->len, FALSE);
+	put_image_data (&writer);
+	put_end (&writer);
+	path = png_writer_finish (&writer);
+
+	/* libexif expects the same header as in JPEG APP1 */
+	g_assert_true (read_png (path, FALSE, &png));
+	g_assert (png.exif != NULL);
+	size = g_bytes_get_size (png.exif);
+	g_assert_cmpuint (size, ==, tiff->len + 6);
+	g_assert (memcmp (g_bytes_get_data (png.exif, NULL), "Exif\0\0", 6) == 0);
+	g_assert (memcmp ((const guchar *) g_bytes_get_data (png.exif, NULL) + 6,
+	                  tiff->data, tiff->len) == 0);
+	png_info_clear (&png);
+
+#ifdef HAVE_LIBEXIF
+	{
+		TrackerResource *resource;
+
+		resource = extract_png (path);
+		g_assert_cmpstr (tracker_resource_get_first_string (resource, "nie:description"), ==, description);
+		g_object_unref (resource);
+	}
+#endif /* HAVE_LIBEXIF */
+
+	g_byte_array_unref (tiff);
+	g_unlink (path);
+	g_free (path);
+}
+
+static void
+test_png_bad_crc (void)
+{
+	TrackerResource *resource;
+	PngWriter writer;
+	PngInfo png;
+	gchar *path;
+
+	png_writer_init (&writer);
+	put_text (&writer, "Comment", "Corrupted comment", TRUE);
+	put_image_data (&writer);
+	put_text (&writer, "Copyright", "Intact copyright", FALSE);
+	put_end (&writer);
+	path = png_writer_finish (&writer);
+
+	/* Like libpng, only the corrupted chunk is dropped */
+	g_assert_true (read_png (path, FALSE, &png));
+	g_assert_cmpuint (png.texts->len, ==, 1);
+	g_assert_null (lookup_text (&png, "Comment"));
+	g_assert_cmpstr (lookup_text (&png, "Copyright"), ==, "Intact copyright");
+	png_info_clear (&png);
+
+	resource = extract_png (path);
+	g_assert_null (tracker_resource_get_first_string (resource, "nie:comment"));
+	g_assert_cmpstr (tracker_resource_get_first_string (resource, "nie:copyright"), ==, "Intact copyright");
+	g_object_unref (resource);
+
+	g_unlink (path);
+	g_free (path);
+}
+
+static void
+test_png_inflate_limit (void)
+{
+	PngWriter writer;
+	PngInfo png;
+	guint8 *text;
+	gsize length;
+	gchar *path;
+
+	/* Compresses to a few KB, but goes past the limit once inflated */
+	length = MAX_METADATA_SIZE + 1024 * 1024;
+	text = g_malloc (length);
+	memset (text, 'a', length);
+
+	png_writer_init (&writer);
+	put_ztxt (&writer, "Comment", text, length);
+	put_itxt (&writer, "Description", text, length, TRUE);
+	put_image_data (&writer);
+	put_text (&writer, "Title", "Small title", FALSE);
+	put_end (&writer);
+	path = png_writer_finish (&writer);
+	g_free (text);
+
+	g_assert_true (read_png (path, FALSE, &png));
+	g_assert_cmpuint (png.texts->len, ==, 1);
+	g_assert_null (lookup_text (&png, "Comment"));
+	g_assert_null (lookup_text (&png, "Description"));
+	g_assert_cmpstr (lookup_text (&png, "Title"), ==, "Small title");
+	png_info_clear (&png);
+
+	g_unlink (path);
+	g_free (path);
+}
+
+static void
+test_png_libpng_fallback (void)
+{
+	PngWriter writer;
+	PngInfo png, fallback;
+	gchar *path;
+	guint i;
+
+	/* The fallback finds the same, before and after the image data */
+	path = create_text_png ();
+
+	g_assert_true (read_png (path, FALSE, &png));
+	g_assert_true (read_png (path, TRUE, &fallback));
+	g_assert_cmpuint (fallback.width, ==, png.width);
+	g_assert_cmpuint (fallback.height, ==, png.height);
+	g_assert_cmpint (fallback.bit_depth, ==, png.bit_depth);
+	g_assert_cmpuint (fallback.texts->len, ==, png.texts->len);
+
+	for (i = 0; i < png.texts->len; i++) {
+		PngText *text = &g_array_index (png.texts, PngText, i);
+
+		/* libpng hands Latin-1 text over untouched */
+		if (g_strcmp0 (text->key, "Title") == 0)
+			continue;
+
+		g_assert_cmpstr (lookup_text (&fallback, text->key), ==, text->text);
+	}
+
+	png_info_clear (&png);
+	png_info_clear (&fallback);
+	g_unlink (path);
+	g_free (path);
+
+	/* Files the chunk walker refuses go to libpng, which
+	 * refuses truncated files as well.
+	 */
+	png_writer_init (&writer);
+	put_image_data (&writer);
+	path = png_writer_finish (&writer);
+
+	g_assert_false (read_png (path, FALSE, &png));
+	png_info_clear (&png);
+
+	{
+		TrackerExtractInfo *info;
+		GFile *file;
+
+		file = g_file_new_for_path (path);
+		info = tracker_extract_info_new (file, "image/png");
+		g_object_unref (file);
+
+		g_assert_false (tracker_extract_get_metadata (info));
+		g_assert_null (tracker_extract_info_get_resource (info));
+		tracker_extract_info_unref (info);
+	}
+
+	g_unlink (path);
+	g_free (path);
+}
+
+int
+main (int argc, char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/tracker-extract/png/text",
+	                 test_png_text);
+	g_test_add_func ("/tracker-extract/png/exif",
+	                 test_png_exif);
+	g_test_add_func ("/tracker-extract/png/bad-crc",
+	                 test_png_bad_crc);
+	g_test_add_func ("/tracker-extract/png/inflate-limit",
+	                 test_png_inflate_limit);
+	g_test_add_func ("/tracker-extract/png/libpng-fallback",
+	                 test_png_libpng_fallback);
+
+	return g_test_run ();
+}